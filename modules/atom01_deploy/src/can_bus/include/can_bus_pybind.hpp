@@ -0,0 +1,93 @@
+/**
+ * @file
+ * Python bindings of the bus statistics, included by the pybind modules of the packages that use
+ * SocketCAN. The types are module local, so the modules can be imported together.
+ */
+
+#pragma once
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include "socket_can.hpp"
+
+inline void bind_can_bus(pybind11::module_ &m) {
+    namespace py = pybind11;
+
+    py::enum_<CanBusState>(m, "CanBusState", py::module_local())
+        .value("ERROR_ACTIVE", CanBusState::ERROR_ACTIVE)
+        .value("ERROR_WARNING", CanBusState::ERROR_WARNING)
+        .value("ERROR_PASSIVE", CanBusState::ERROR_PASSIVE)
+        .value("BUS_OFF", CanBusState::BUS_OFF)
+        .value("DOWN", CanBusState::DOWN);
+
+    py::class_<CanRttStats>(m, "CanRttStats", py::module_local())
+        .def_readonly("command_id", &CanRttStats::command_id)
+        .def_readonly("reply_id", &CanRttStats::reply_id)
+        .def_readonly("replies", &CanRttStats::replies)
+        .def_readonly("lost", &CanRttStats::lost)
+        .def_readonly("max_ns", &CanRttStats::max_ns)
+        .def_readonly("histogram", &CanRttStats::histogram)
+        .def("mean_ns", &CanRttStats::mean_ns)
+        .def("percentile_ns", &CanRttStats::percentile_ns, py::arg("q"))
+        .def_static("bucket_lower_ns", &can_rtt_bucket_lower_ns, py::arg("bucket"));
+
+    py::class_<CanBusStats>(m, "CanBusStats", py::module_local())
+        .def_readonly("interface", &CanBusStats::interface)
+        .def_readonly("bitrate", &CanBusStats::bitrate)
+        .def_readonly("stamp_ns", &CanBusStats::stamp_ns)
+        .def_readonly("tx_frames", &CanBusStats::tx_frames)
+        .def_readonly("rx_frames", &CanBusStats::rx_frames)
+        .def_readonly("tx_fps", &CanBusStats::tx_fps)
+        .def_readonly("rx_fps", &CanBusStats::rx_fps)
+        .def_readonly("load", &CanBusStats::load)
+        .def_readonly("tx_queue_depth", &CanBusStats::tx_queue_depth)
+        .def_readonly("tx_queue_high_water", &CanBusStats::tx_queue_high_water)
+        .def_readonly("rtt", &CanBusStats::rtt);
+
+    py::class_<SocketCAN::TxStats>(m, "CanTxStats", py::module_local())
+        .def_readonly("frames", &SocketCAN::TxStats::frames)
+        .def_readonly("queue_full", &SocketCAN::TxStats::queue_full)
+        .def_readonly("enobufs", &SocketCAN::TxStats::enobufs)
+        .def_readonly("dropped", &SocketCAN::TxStats::dropped)
+        .def_readonly("coalesced", &SocketCAN::TxStats::coalesced);
+
+    py::class_<SocketCAN::BusErrorStats>(m, "CanBusErrorStats", py::module_local())
+        .def_readonly("state", &SocketCAN::BusErrorStats::state)
+        .def_readonly("tx_error_count", &SocketCAN::BusErrorStats::tx_error_count)
+        .def_readonly("rx_error_count", &SocketCAN::BusErrorStats::rx_error_count)
+        .def_readonly("error_frames", &SocketCAN::BusErrorStats::error_frames)
+        .def_readonly("warning", &SocketCAN::BusErrorStats::warning)
+        .def_readonly("passive", &SocketCAN::BusErrorStats::passive)
+        .def_readonly("bus_off", &SocketCAN::BusErrorStats::bus_off)
+        .def_readonly("tx_timeout", &SocketCAN::BusErrorStats::tx_timeout)
+        .def_readonly("lost_arbitration", &SocketCAN::BusErrorStats::lost_arbitration)
+        .def_readonly("bus_error", &SocketCAN::BusErrorStats::bus_error)
+        .def_readonly("no_ack", &SocketCAN::BusErrorStats::no_ack)
+        .def_readonly("overflow", &SocketCAN::BusErrorStats::overflow)
+        .def_readonly("restarts", &SocketCAN::BusErrorStats::restarts)
+        .def_readonly("restart_failures", &SocketCAN::BusErrorStats::restart_failures);
+
+    py::class_<SocketCAN::WatchdogStats>(m, "CanWatchdogStats", py::module_local())
+        .def_readonly("armed", &SocketCAN::WatchdogStats::armed)
+        .def_readonly("tripped", &SocketCAN::WatchdogStats::tripped)
+        .def_readonly("trips", &SocketCAN::WatchdogStats::trips)
+        .def_readonly("frames", &SocketCAN::WatchdogStats::frames);
+
+    // statistics only exist for interfaces opened by the motors or the IMU, querying must not open one
+    auto find = [](const std::string &interface) {
+        std::shared_ptr<SocketCAN> can = SocketCAN::find(interface);
+        if (!can) {
+            throw py::value_error("CAN interface " + interface + " is not used by this process");
+        }
+        return can;
+    };
+    m.def("get_can_bus_stats", [find](const std::string &interface) { return find(interface)->get_bus_stats(); },
+          py::arg("interface"));
+    m.def("get_can_tx_stats", [find](const std::string &interface) { return find(interface)->get_tx_stats(); },
+          py::arg("interface"));
+    m.def("get_can_watchdog_stats", [find](const std::string &interface) { return find(interface)->get_watchdog_stats(); },
+          py::arg("interface"));
+    m.def("get_can_bus_error_stats", [find](const std::string &interface) { return find(interface)->get_bus_error_stats(); },
+          py::arg("interface"));
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <linux/can.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+using CanCbkFunc = std::function<void(const can_frame &)>;
+// Standard IDs as is, extended IDs with CAN_EFF_FLAG set
+using CanCbkId = uint32_t;
+
+// Dispatch key of a received frame; remote and error frames have none (CAN_ERR_FLAG).
+inline CanCbkId can_dispatch_key(canid_t can_id) {
+    if (can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG)) {
+        return CAN_ERR_FLAG;
+    }
+    return (can_id & CAN_EFF_FLAG) ? (can_id & (CAN_EFF_FLAG | CAN_EFF_MASK)) : (can_id & CAN_SFF_MASK);
+}
+
+// Subscription to every frame with (can_id & mask) == id. can_id includes the CAN_EFF_FLAG /
+// CAN_RTR_FLAG bits, so a mask containing CAN_EFF_FLAG also selects the frame format.
+struct CanFilter {
+    canid_t id;
+    canid_t mask;
+
+    bool matches(canid_t can_id) const { return (can_id & mask) == id; }
+    bool operator==(const CanFilter &other) const { return id == other.id && mask == other.mask; }
+};
+
+// Immutable subscriber table of one interface. Exact IDs are placed with a multiplicative perfect
+// hash searched when the table is built, so a lookup is one multiply, one shift and one compare.
+// SocketCAN builds a new table on every (un)registration and swaps it in, the RX path never locks.
+class CanDispatchTable {
+   public:
+    struct Exact {
+        CanCbkId id;
+        CanCbkFunc callback;
+    };
+    struct Masked {
+        CanFilter filter;
+        CanCbkFunc callback;
+    };
+
+    // Throws on duplicate IDs / filters or IDs outside the 11 / 29 bit range.
+    CanDispatchTable(std::vector<Exact> exact, std::vector<Masked> masked);
+
+    // key from can_dispatch_key(), frames without a key (CAN_ERR_FLAG) must not be looked up
+    const CanCbkFunc *find(CanCbkId key) const {
+        const Slot &slot = slots_[(key * multiplier_) >> shift_];
+        return slot.key == key ? &exact_[slot.index].callback : nullptr;
+    }
+
+    const std::vector<Exact> &exact() const { return exact_; }
+    const std::vector<Masked> &masked() const { return masked_; }
+    size_t slot_count() const { return slots_.size(); }
+
+   private:
+    struct Slot {
+        CanCbkId key = CAN_ERR_FLAG;    // never a valid key
+        uint32_t index = 0;
+    };
+
+    bool place(uint32_t multiplier, uint32_t bits);
+
+    std::vector<Exact> exact_;
+    std::vector<Masked> masked_;
+    std::vector<Slot> slots_;
+    uint32_t multiplier_ = 0;
+    uint32_t shift_ = 31;
+};
@@ -0,0 +1,24 @@
+/**
+ * @file
+ * rtnetlink requests on a SocketCAN interface, used to recover a bus that went bus-off or down.
+ * The requests that change the link need CAP_NET_ADMIN. All return 0 on success or a positive
+ * errno value.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Restarts a controller that is bus-off (ip link set <if> type can restart).
+// EBUSY: the controller is not bus-off, or the kernel restarts it itself (restart-ms != 0).
+// EOPNOTSUPP: the driver has no restart support.
+int can_link_restart(int ifindex);
+
+// Sets the interface administratively up or down (ip link set <if> up / down).
+int can_link_set_up(int ifindex, bool up);
+
+// Nominal bitrate of a CAN interface (ip -details link show <if>). ENODATA: none configured (vcan).
+int can_link_get_bitrate(int ifindex, uint32_t &bitrate);
+
+// Controller state as enum can_state (linux/can/netlink.h). ENODATA: none reported (vcan).
+int can_link_get_state(int ifindex, uint32_t &state);
@@ -0,0 +1,67 @@
+/**
+ * @file
+ * Bus load and command / reply latency statistics of a SocketCAN interface.
+ */
+
+#pragma once
+
+#include <linux/can.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+constexpr const uint32_t CAN_DEFAULT_BITRATE = 1000000;   // used when the interface reports none (vcan)
+constexpr const uint64_t CAN_STATS_WINDOW_NS = 1000000000ull;
+constexpr const int CAN_RTT_BUCKETS = 48;        // quarter-octave buckets, 1 us .. 8 ms
+constexpr const int CAN_MAX_RTT_TRACKERS = 64;
+
+// Bits the frame occupies on the bus: SOF to CRC with its actual stuff bits, plus CRC delimiter,
+// ACK, EOF and the interframe space.
+int can_frame_bits(const can_frame &frame);
+
+int can_rtt_bucket(uint64_t rtt_ns);
+uint64_t can_rtt_bucket_lower_ns(int bucket);
+
+// Round trip of one device: from the command frame handed to the kernel to the reply received.
+// A command that is followed by the next one without a reply in between counts as lost.
+struct CanRttTracker {
+    std::atomic<uint32_t> command_id{0};    // first command ID registered for the reply
+    std::atomic<uint32_t> reply_id{0};
+    std::atomic<uint64_t> sent_ns{0};       // 0: no command outstanding
+    std::atomic<uint64_t> replies{0}, lost{0}, sum_ns{0}, max_ns{0};
+    std::array<std::atomic<uint64_t>, CAN_RTT_BUCKETS> histogram{};
+
+    void on_sent(uint64_t now_ns);          // TX thread
+    void on_reply(uint64_t now_ns);         // RX thread
+};
+
+struct CanRttStats {
+    uint32_t command_id;
+    uint32_t reply_id;
+    uint64_t replies;
+    uint64_t lost;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    std::array<uint64_t, CAN_RTT_BUCKETS> histogram;
+
+    uint64_t mean_ns() const { return replies ? sum_ns / replies : 0; }
+    // upper bound of the bucket holding the q quantile (0..1), 0 without replies
+    uint64_t percentile_ns(double q) const;
+};
+
+struct CanBusStats {
+    std::string interface;
+    uint32_t bitrate;               // nominal bitrate of the interface
+    uint64_t stamp_ns;              // CLOCK_MONOTONIC of the last completed window
+    uint64_t tx_frames;
+    uint64_t rx_frames;
+    float tx_fps;                   // rates over the last window of CAN_STATS_WINDOW_NS
+    float rx_fps;
+    float load;                     // fraction of the bus time occupied by frames in both directions
+    uint64_t tx_queue_depth;        // frames waiting in the FIFO and the control mailboxes
+    uint64_t tx_queue_high_water;
+    std::vector<CanRttStats> rtt;
+};
@@ -0,0 +1,246 @@
+/**
+ * @file
+ * This file declares an interface to SocketCAN,
+ * to facilitates frame transmission and reception.
+ * One instance (socket, RX and TX thread) exists per interface and is shared by every
+ * device driver on that bus.
+ */
+
+#pragma once
+
+#include <linux/can.h>
+#include <linux/can/error.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <pthread.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <boost/lockfree/queue.hpp>
+#include <cstdbool>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "can_dispatch_table.hpp"
+#include "can_stats.hpp"
+#include "thread_topology.hpp"
+
+constexpr const int INIT_FD = -1;
+constexpr const int TIMEOUT_SEC = 0;
+constexpr const int TIMEOUT_USEC = 1000;
+constexpr const int TX_QUEUE_SIZE = 4096;
+constexpr const int TX_BUDGET_FRAMES = 32;        // frames the socket may have queued in the kernel
+constexpr const int TX_FRAME_TRUESIZE = 1024;     // approximate kernel memory per queued CAN skb
+constexpr const int TX_TIMEOUT_US = 5000;         // a frame that cannot be queued for this long is dropped
+constexpr const int TX_ENOBUFS_BACKOFF_US = 100;  // qdisc full, POLLOUT is not signalled for it
+constexpr const int LINK_PROBE_MS = 100;          // period of re-reading the state of a faulted link
+#ifndef CAN_ERR_CNT
+#define CAN_ERR_CNT 0x00000200U  // data[6] / data[7] carry the error counters (linux >= 6.0)
+#endif
+
+using LFQueue = boost::lockfree::queue<can_frame, boost::lockfree::fixed_sized<true>>;
+using LFIdQueue = boost::lockfree::queue<uint16_t, boost::lockfree::fixed_sized<true>>;
+
+// Latest-value TX mailbox of one standard ID. The payload and the pending flag are separate
+// atomics, so neither the producer nor the TX thread ever waits on the other.
+struct CanControlSlot {
+    std::atomic<uint64_t> data{0};
+    std::atomic<uint32_t> state{0};    // CONTROL_PENDING | dlc
+};
+constexpr const uint32_t CONTROL_PENDING = 0x80000000u;
+
+// Fault confinement state of the controller, ordered by severity. DOWN: the interface is not up.
+enum class CanBusState : uint8_t { ERROR_ACTIVE = 0, ERROR_WARNING, ERROR_PASSIVE, BUS_OFF, DOWN };
+const char *can_bus_state_name(CanBusState state);
+
+// Automatic recovery of a bus that went bus-off or down: the first restart is attempted
+// backoff_min_ms after the fault, each further fault or failed attempt doubles the delay up to
+// backoff_max_ms. The delay starts over once the bus stayed up for backoff_max_ms.
+struct CanRestartCfg {
+    bool enabled = true;
+    int backoff_min_ms = 10;
+    int backoff_max_ms = 1000;
+};
+
+class SocketCAN {
+   private:
+    std::string interface_;  // The network interface name
+    int sockfd_ = -1;        // The file descriptor for the CAN socket
+    std::atomic<bool> receiving_;
+    LFQueue tx_queue_;                              // config / register frames, FIFO
+    std::unique_ptr<CanControlSlot[]> control_slots_;  // control frames by standard ID
+    LFIdQueue control_ready_;                       // IDs with a pending control frame, each queued once
+    std::atomic<uint64_t> control_coalesced_{0};
+    int tx_event_fd_ = -1;                          // wakes the TX thread when it sleeps
+    std::atomic<bool> tx_sleeping_{false};
+
+    sockaddr_can addr_;      // The address of the CAN socket
+    ifreq if_request_;       // The network interface request
+
+    /// Receiving
+    std::thread receiver_thread_;
+    std::atomic<const CanDispatchTable *> dispatch_table_{nullptr};  // read by the RX thread without locks
+    std::vector<std::unique_ptr<CanDispatchTable>> dispatch_tables_;  // current and retired tables
+    std::atomic<uint32_t> rx_dispatch_seq_{0};                        // odd while the RX thread dispatches a frame
+    std::mutex can_callback_mutex_;                                   // serializes (un)registration
+
+    /// Transmitting
+    std::thread sender_thread_;
+    int tx_budget_frames_ = TX_BUDGET_FRAMES;
+    std::atomic<uint64_t> tx_frames_{0}, tx_queue_full_{0}, tx_enobufs_{0}, tx_dropped_{0};
+
+    /// Load and latency statistics, written by the RX / TX threads only
+    uint32_t bitrate_ = CAN_DEFAULT_BITRATE;
+    std::atomic<uint64_t> rx_frames_{0}, rx_bits_{0}, tx_bits_{0};
+    std::atomic<uint64_t> tx_pending_{0}, tx_pending_high_water_{0};
+    std::atomic<uint64_t> stats_stamp_ns_{0};
+    uint64_t window_start_ns_ = 0, window_tx_frames_ = 0, window_rx_frames_ = 0, window_bits_ = 0;  // RX thread
+    std::atomic<float> tx_fps_{0.f}, rx_fps_{0.f}, bus_load_{0.f};
+    std::unique_ptr<CanRttTracker[]> rtt_trackers_;
+    std::unique_ptr<std::atomic<uint8_t>[]> rtt_by_command_, rtt_by_reply_;  // tracker index + 1 by standard ID
+    int rtt_tracker_count_ = 0;                                             // guarded by can_callback_mutex_
+
+    /// Bus errors and recovery
+    std::thread recovery_thread_;                  // not real-time, only does netlink requests
+    int recovery_event_fd_ = -1;
+    std::atomic<uint8_t> bus_state_{static_cast<uint8_t>(CanBusState::ERROR_ACTIVE)};
+    std::atomic<uint8_t> tx_error_count_{0}, rx_error_count_{0};
+    std::atomic<uint64_t> err_frames_{0}, err_warning_{0}, err_passive_{0}, err_bus_off_{0}, err_tx_timeout_{0},
+        err_lost_arbitration_{0}, err_bus_error_{0}, err_no_ack_{0}, err_overflow_{0};
+    std::atomic<uint64_t> restarts_{0}, restart_failures_{0};
+    std::atomic<bool> restart_enabled_{true};
+    std::atomic<int> restart_backoff_min_ms_{10}, restart_backoff_max_ms_{1000};
+
+    /// Control watchdog
+    std::mutex watchdog_mutex_;                    // arm / disarm, the TX thread only try-locks it
+    std::vector<can_frame> watchdog_frames_;       // fallback frames, guarded by watchdog_mutex_
+    std::atomic<bool> watchdog_armed_{false}, watchdog_tripped_{false};
+    std::atomic<uint64_t> watchdog_timeout_ns_{0}, watchdog_period_ns_{0};
+    std::atomic<uint64_t> last_control_ns_{0};     // latest transmit_control() call
+    std::atomic<uint64_t> watchdog_trips_{0}, watchdog_sent_{0};
+    uint64_t watchdog_next_ns_ = 0;                // TX thread
+
+    SocketCAN(std::string interface);
+
+    static std::shared_ptr<SocketCAN> createInstance(const std::string &interface) {
+        return std::shared_ptr<SocketCAN>(new SocketCAN(interface));
+    }
+    void dispatch(const can_frame &frame);
+    bool post_control(const can_frame &frame);
+    bool pop_control(can_frame &frame);
+    void wake_sender();
+    void count_tx_pending();
+    void update_stats_window(uint64_t now_ns);
+    void send_frame(const can_frame &frame);
+    uint64_t service_watchdog(uint64_t now_ns);
+    void handle_error_frame(const can_frame &frame);
+    void set_bus_state(CanBusState state);
+    void notify_link_down();
+    bool link_is_up();
+    bool probe_link();
+    void recovery_loop();
+    bool restart_link(CanBusState state);
+    void publish_table(std::vector<CanDispatchTable::Exact> exact, std::vector<CanDispatchTable::Masked> masked);
+
+    static std::shared_ptr<spdlog::logger> logger_;
+    static std::unordered_map<std::string, std::shared_ptr<SocketCAN>> instances_;
+    static std::mutex instances_mutex_;
+
+   public:
+    SocketCAN(const SocketCAN &) = delete;
+    SocketCAN &operator=(const SocketCAN &) = delete;
+    ~SocketCAN();
+    static void init_logger(std::shared_ptr<spdlog::logger> logger) { logger_ = logger; }
+    static std::shared_ptr<SocketCAN> get(std::string interface);
+    // Lookup only: nullptr if the process has not opened interface, no socket or thread is started.
+    static std::shared_ptr<SocketCAN> find(const std::string &interface);
+    void open(std::string interface);
+    void close();
+    // Config / register frames, sent in order after pending control frames.
+    void transmit(const can_frame &frame);
+    // Control (e.g. MIT) frames: one mailbox per destination ID, a newer frame replaces the
+    // unsent one, so a TX backlog never delays the latest command by more than one frame per ID.
+    // Served before the FIFO. Extended frames fall back to transmit().
+    void transmit_control(const can_frame &frame);
+    // Control frames of several devices, e.g. one command per motor of the bus. All mailboxes are
+    // filled before the TX thread is woken once, so the frames leave back to back.
+    void transmit_control(const can_frame *frames, size_t count);
+
+    // Frames whose ID equals id: an 11 bit standard ID, or a 29 bit extended ID with CAN_EFF_FLAG set.
+    // After remove_can_callback() returns the callback is no longer running or called (unless
+    // removed from the RX thread itself).
+    void add_can_callback(const CanCbkFunc callback, const CanCbkId id);
+    void remove_can_callback(const CanCbkId id);
+    // Frames selected by filter, for devices that are addressed by part of the ID or use
+    // extended frames. A frame is delivered to every subscriber whose filter matches it.
+    void add_can_callback(const CanCbkFunc callback, const CanFilter &filter);
+    void remove_can_callback(const CanFilter &filter);
+    void clear_can_callbacks();
+
+    struct TxStats {
+        uint64_t frames;        // frames handed to the kernel
+        uint64_t queue_full;    // writes that found the socket budget full (EAGAIN), waited for POLLOUT
+        uint64_t enobufs;       // writes rejected by a full interface queue (ENOBUFS), backed off
+        uint64_t dropped;       // frames given up after TX_TIMEOUT_US or a write error
+        uint64_t coalesced;     // control frames replaced before they were sent
+    };
+    TxStats get_tx_stats() const;
+
+    // Error frames of all classes are received (CAN_RAW_ERR_FILTER). While the bus is bus-off or
+    // down, frames handed to the TX thread are dropped instead of waiting for the timeout.
+    void set_restart_cfg(const CanRestartCfg &cfg);
+    CanBusState get_bus_state() const { return static_cast<CanBusState>(bus_state_.load(std::memory_order_relaxed)); }
+    struct BusErrorStats {
+        CanBusState state;
+        uint8_t tx_error_count;     // controller TEC / REC from the last error frame that carried them
+        uint8_t rx_error_count;
+        uint64_t error_frames;
+        uint64_t warning;           // transitions into each state
+        uint64_t passive;
+        uint64_t bus_off;
+        uint64_t tx_timeout;
+        uint64_t lost_arbitration;
+        uint64_t bus_error;         // protocol violations, needs berr-reporting on
+        uint64_t no_ack;
+        uint64_t overflow;          // controller RX / TX buffer overflows
+        uint64_t restarts;          // successful automatic restarts
+        uint64_t restart_failures;
+    };
+    BusErrorStats get_bus_error_stats() const;
+
+    // Command watchdog of the TX thread. While armed, once no control frame was handed to
+    // transmit_control() for timeout_us, the TX thread sends the fallback frames itself every
+    // period_us until the next control frame arrives, e.g. damping commands for every motor of
+    // the bus. Fallback frames bypass the mailboxes and do not feed the watchdog. One set of
+    // fallback frames per bus, arming again replaces it.
+    void arm_control_watchdog(const std::vector<can_frame> &fallback, uint32_t timeout_us, uint32_t period_us);
+    void disarm_control_watchdog();
+    struct WatchdogStats {
+        bool armed;
+        bool tripped;           // fallback frames are being sent
+        uint64_t trips;
+        uint64_t frames;        // fallback frames sent
+    };
+    WatchdogStats get_watchdog_stats() const;
+
+    // Round trip statistics from frames sent on command_id to the next frame received on reply_id
+    // (standard IDs). Several command IDs may share one reply ID and its statistics.
+    void add_rtt_tracking(const CanCbkId command_id, const CanCbkId reply_id);
+    void remove_rtt_tracking(const CanCbkId command_id);
+    CanBusStats get_bus_stats() const;
+};
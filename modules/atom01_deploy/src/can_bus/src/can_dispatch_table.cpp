@@ -0,0 +1,69 @@
+#include "can_dispatch_table.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+constexpr uint32_t max_table_bits = 16;
+constexpr int tries_per_size = 64;
+}  // namespace
+
+CanDispatchTable::CanDispatchTable(std::vector<Exact> exact, std::vector<Masked> masked)
+    : exact_(std::move(exact)), masked_(std::move(masked)) {
+    for (size_t i = 0; i < exact_.size(); i++) {
+        CanCbkId id = exact_[i].id;
+        bool valid = (id & CAN_EFF_FLAG) ? (id & ~(CAN_EFF_FLAG | CAN_EFF_MASK)) == 0 : id <= CAN_SFF_MASK;
+        if (!valid) {
+            throw std::runtime_error(fmt::format("Invalid CAN subscription ID 0x{:X}", id));
+        }
+        for (size_t j = 0; j < i; j++) {
+            if (exact_[j].id == id) {
+                throw std::runtime_error(fmt::format("CAN ID 0x{:X} already has a subscriber", id));
+            }
+        }
+    }
+    for (size_t i = 0; i < masked_.size(); i++) {
+        const CanFilter &filter = masked_[i].filter;
+        if ((filter.id & ~filter.mask) != 0) {
+            throw std::runtime_error(fmt::format("CAN filter 0x{:X}/0x{:X} has ID bits outside its mask", filter.id, filter.mask));
+        }
+        for (size_t j = 0; j < i; j++) {
+            if (masked_[j].filter == filter) {
+                throw std::runtime_error(fmt::format("CAN filter 0x{:X}/0x{:X} already has a subscriber", filter.id, filter.mask));
+            }
+        }
+    }
+
+    // start at >= 2 slots per ID, grow until a collision free multiplier is found
+    uint32_t bits = 1;
+    while ((1u << bits) < 2 * exact_.size()) {
+        bits++;
+    }
+    uint32_t seed = 0x9E3779B9u;
+    for (; bits <= max_table_bits; bits++) {
+        for (int t = 0; t < tries_per_size; t++) {
+            seed = seed * 1664525u + 1013904223u;
+            if (place(seed | 1u, bits)) {
+                return;
+            }
+        }
+    }
+    throw std::runtime_error("Failed to build the CAN dispatch table");
+}
+
+bool CanDispatchTable::place(uint32_t multiplier, uint32_t bits) {
+    slots_.assign(size_t(1) << bits, Slot());
+    multiplier_ = multiplier;
+    shift_ = 32 - bits;
+    for (size_t i = 0; i < exact_.size(); i++) {
+        Slot &slot = slots_[(exact_[i].id * multiplier_) >> shift_];
+        if (slot.key != CAN_ERR_FLAG) {
+            return false;
+        }
+        slot.key = exact_[i].id;
+        slot.index = static_cast<uint32_t>(i);
+    }
+    return true;
+}
@@ -0,0 +1,164 @@
+/**
+ * @file
+ * This file implements the rtnetlink link requests on SocketCAN interfaces.
+ */
+
+#include "can_link.hpp"
+
+#include <errno.h>
+#include <linux/can/netlink.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr const int NETLINK_TIMEOUT_MS = 500;
+
+struct LinkRequest {
+    nlmsghdr header;
+    ifinfomsg info;
+    char attributes[128];
+};
+
+void init_request(LinkRequest &req, int ifindex) {
+    memset(&req, 0, sizeof(req));
+    req.header.nlmsg_len = NLMSG_LENGTH(sizeof(ifinfomsg));
+    req.header.nlmsg_type = RTM_NEWLINK;
+    req.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+    req.header.nlmsg_seq = 1;
+    req.info.ifi_family = AF_UNSPEC;
+    req.info.ifi_index = ifindex;
+}
+
+// Appends an attribute; with len 0 it opens a nested attribute, closed by end_nest().
+rtattr *put_attr(LinkRequest &req, unsigned short type, const void *data, size_t len) {
+    rtattr *attr = reinterpret_cast<rtattr *>(reinterpret_cast<char *>(&req.header) + NLMSG_ALIGN(req.header.nlmsg_len));
+    attr->rta_type = type;
+    attr->rta_len = static_cast<unsigned short>(RTA_LENGTH(len));
+    if (len > 0) memcpy(RTA_DATA(attr), data, len);
+    req.header.nlmsg_len = NLMSG_ALIGN(req.header.nlmsg_len) + RTA_ALIGN(attr->rta_len);
+    return attr;
+}
+
+void end_nest(LinkRequest &req, rtattr *nest) {
+    nest->rta_len = static_cast<unsigned short>(reinterpret_cast<char *>(&req.header) + req.header.nlmsg_len -
+                                                reinterpret_cast<char *>(nest));
+}
+
+// Sends the request and waits for the kernel's acknowledgement, or for the reply message when
+// reply is given.
+int transact(LinkRequest &req, char *reply = nullptr, size_t reply_size = 0, size_t *reply_len = nullptr) {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+        return errno;
+    }
+    struct timeval timeout{0, NETLINK_TIMEOUT_MS * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_nl kernel{};
+    kernel.nl_family = AF_NETLINK;
+    int err = 0;
+    if (sendto(fd, &req, req.header.nlmsg_len, 0, reinterpret_cast<sockaddr *>(&kernel), sizeof(kernel)) < 0) {
+        err = errno;
+    } else {
+        alignas(nlmsghdr) char ack_buffer[1024];
+        if (reply == nullptr) {
+            reply = ack_buffer;
+            reply_size = sizeof(ack_buffer);
+        }
+        ssize_t len = recv(fd, reply, reply_size, 0);
+        const nlmsghdr *ack = reinterpret_cast<const nlmsghdr *>(reply);
+        if (len < 0) {
+            err = errno;
+        } else if (!NLMSG_OK(ack, static_cast<size_t>(len))) {
+            err = EPROTO;
+        } else if (ack->nlmsg_type == NLMSG_ERROR) {
+            err = -static_cast<const nlmsgerr *>(NLMSG_DATA(ack))->error;
+        } else if (reply_len != nullptr) {
+            *reply_len = static_cast<size_t>(len);
+        } else {
+            err = EPROTO;
+        }
+    }
+    ::close(fd);
+    return err;
+}
+
+const rtattr *find_attr(const rtattr *attr, size_t len, unsigned short type) {
+    for (; RTA_OK(attr, len); attr = RTA_NEXT(attr, len)) {
+        if ((attr->rta_type & NLA_TYPE_MASK) == type) return attr;
+    }
+    return nullptr;
+}
+
+// Copies the IFLA_INFO_DATA attribute type of the interface (ip -details link show <if>).
+int get_can_attr(int ifindex, unsigned short type, void *data, size_t size) {
+    LinkRequest req;
+    init_request(req, ifindex);
+    req.header.nlmsg_type = RTM_GETLINK;
+    req.header.nlmsg_flags = NLM_F_REQUEST;
+    alignas(nlmsghdr) char reply[8192];
+    size_t len = 0;
+    int err = transact(req, reply, sizeof(reply), &len);
+    if (err != 0) {
+        return err;
+    }
+    const nlmsghdr *msg = reinterpret_cast<const nlmsghdr *>(reply);
+    if (msg->nlmsg_type != RTM_NEWLINK || msg->nlmsg_len < NLMSG_LENGTH(sizeof(ifinfomsg))) {
+        return EPROTO;
+    }
+    const ifinfomsg *info = static_cast<const ifinfomsg *>(NLMSG_DATA(msg));
+    const rtattr *link_info = find_attr(IFLA_RTA(info), IFLA_PAYLOAD(msg), IFLA_LINKINFO);
+    const rtattr *info_data = link_info ? find_attr(static_cast<const rtattr *>(RTA_DATA(link_info)), RTA_PAYLOAD(link_info), IFLA_INFO_DATA) : nullptr;
+    const rtattr *attr = info_data ? find_attr(static_cast<const rtattr *>(RTA_DATA(info_data)), RTA_PAYLOAD(info_data), type) : nullptr;
+    if (attr == nullptr || RTA_PAYLOAD(attr) < size) {
+        return ENODATA;
+    }
+    memcpy(data, RTA_DATA(attr), size);
+    return 0;
+}
+
+}  // namespace
+
+int can_link_restart(int ifindex) {
+    LinkRequest req;
+    init_request(req, ifindex);
+    rtattr *link_info = put_attr(req, IFLA_LINKINFO, nullptr, 0);
+    put_attr(req, IFLA_INFO_KIND, "can", 3);
+    rtattr *info_data = put_attr(req, IFLA_INFO_DATA, nullptr, 0);
+    uint32_t restart = 1;
+    put_attr(req, IFLA_CAN_RESTART, &restart, sizeof(restart));
+    end_nest(req, info_data);
+    end_nest(req, link_info);
+    return transact(req);
+}
+
+int can_link_set_up(int ifindex, bool up) {
+    LinkRequest req;
+    init_request(req, ifindex);
+    req.info.ifi_change = IFF_UP;
+    req.info.ifi_flags = up ? IFF_UP : 0;
+    return transact(req);
+}
+
+int can_link_get_bitrate(int ifindex, uint32_t &bitrate) {
+    can_bittiming timing;
+    int err = get_can_attr(ifindex, IFLA_CAN_BITTIMING, &timing, sizeof(timing));
+    if (err != 0) {
+        return err;
+    }
+    bitrate = timing.bitrate;
+    return bitrate > 0 ? 0 : ENODATA;
+}
+
+int can_link_get_state(int ifindex, uint32_t &state) {
+    return get_can_attr(ifindex, IFLA_CAN_STATE, &state, sizeof(state));
+}
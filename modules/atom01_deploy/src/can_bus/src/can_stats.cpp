@@ -0,0 +1,123 @@
+/**
+ * @file
+ * This file implements the frame length and latency histogram helpers of the bus statistics.
+ */
+
+#include "can_stats.hpp"
+
+#include <algorithm>
+
+namespace {
+
+struct BitStream {
+    uint8_t bits[128];
+    int count = 0;
+
+    void put(uint32_t value, int width) {
+        for (int i = width - 1; i >= 0; i--) bits[count++] = (value >> i) & 1u;
+    }
+};
+
+}  // namespace
+
+int can_frame_bits(const can_frame &frame) {
+    BitStream s;
+    bool rtr = frame.can_id & CAN_RTR_FLAG;
+    int len = rtr ? 0 : std::min<int>(frame.can_dlc, CAN_MAX_DLEN);
+    s.put(0, 1);  // SOF
+    if (frame.can_id & CAN_EFF_FLAG) {
+        uint32_t id = frame.can_id & CAN_EFF_MASK;
+        s.put(id >> 18, 11);
+        s.put(1, 1);  // SRR
+        s.put(1, 1);  // IDE
+        s.put(id & 0x3FFFF, 18);
+        s.put(rtr, 1);
+        s.put(0, 2);  // r1, r0
+    } else {
+        s.put(frame.can_id & CAN_SFF_MASK, 11);
+        s.put(rtr, 1);
+        s.put(0, 2);  // IDE, r0
+    }
+    s.put(frame.can_dlc & 0xF, 4);
+    for (int i = 0; i < len; i++) s.put(frame.data[i], 8);
+
+    uint32_t crc = 0;
+    for (int i = 0; i < s.count; i++) {
+        uint32_t next = s.bits[i] ^ ((crc >> 14) & 1u);
+        crc = (crc << 1) & 0x7FFF;
+        if (next) crc ^= 0x4599;
+    }
+    s.put(crc, 15);
+
+    // a stuff bit follows five equal bits and starts the next run itself
+    int stuff = 0, run = 1;
+    uint8_t last = s.bits[0];
+    for (int i = 1; i < s.count; i++) {
+        if (s.bits[i] == last) {
+            if (++run == 5) {
+                stuff++;
+                last = !last;
+                run = 1;
+            }
+        } else {
+            last = s.bits[i];
+            run = 1;
+        }
+    }
+    return s.count + stuff + 1 + 2 + 7 + 3;
+}
+
+// Values are taken in units of 1.024 us; below 4 units each unit is a bucket, above that the
+// two bits after the leading one select one of four buckets per octave.
+int can_rtt_bucket(uint64_t rtt_ns) {
+    uint64_t v = rtt_ns >> 10;
+    if (v < 4) {
+        return static_cast<int>(v);
+    }
+    int msb = 63 - __builtin_clzll(v);
+    int bucket = 4 * (msb - 1) + static_cast<int>((v >> (msb - 2)) & 3u);
+    return std::min(bucket, CAN_RTT_BUCKETS - 1);
+}
+
+uint64_t can_rtt_bucket_lower_ns(int bucket) {
+    if (bucket < 4) {
+        return static_cast<uint64_t>(bucket) << 10;
+    }
+    int msb = bucket / 4 + 1;
+    return static_cast<uint64_t>(4 + bucket % 4) << (msb - 2) << 10;
+}
+
+void CanRttTracker::on_sent(uint64_t now_ns) {
+    if (sent_ns.exchange(now_ns, std::memory_order_relaxed) != 0) {
+        lost.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void CanRttTracker::on_reply(uint64_t now_ns) {
+    uint64_t sent = sent_ns.exchange(0, std::memory_order_relaxed);
+    if (sent == 0 || now_ns < sent) {
+        return;  // unsolicited, or a reply to a command that was already counted as lost
+    }
+    uint64_t rtt = now_ns - sent;
+    replies.fetch_add(1, std::memory_order_relaxed);
+    sum_ns.fetch_add(rtt, std::memory_order_relaxed);
+    if (rtt > max_ns.load(std::memory_order_relaxed)) max_ns.store(rtt, std::memory_order_relaxed);
+    histogram[can_rtt_bucket(rtt)].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t CanRttStats::percentile_ns(double q) const {
+    if (replies == 0) {
+        return 0;
+    }
+    uint64_t total = 0;
+    for (uint64_t n : histogram) total += n;
+    uint64_t rank = static_cast<uint64_t>(std::clamp(q, 0.0, 1.0) * static_cast<double>(total));
+    uint64_t seen = 0;
+    for (int i = 0; i < CAN_RTT_BUCKETS - 1; i++) {
+        seen += histogram[i];
+        if (seen > rank) {
+            return can_rtt_bucket_lower_ns(i + 1);
+        }
+    }
+    return max_ns;
+}
@@ -0,0 +1,828 @@
+/**
+ * @file
+ * This file implements functions to receive
+ * and transmit CAN frames via SocketCAN.
+ */
+
+#include "socket_can.hpp"
+
+#include <linux/can/netlink.h>
+
+#include "can_link.hpp"
+#include "rt_clock.hpp"
+
+std::shared_ptr<spdlog::logger> SocketCAN::logger_ = nullptr;
+std::unordered_map<std::string, std::shared_ptr<SocketCAN>> SocketCAN::instances_;
+std::mutex SocketCAN::instances_mutex_;
+
+const char *can_bus_state_name(CanBusState state) {
+    switch (state) {
+        case CanBusState::ERROR_ACTIVE: return "error-active";
+        case CanBusState::ERROR_WARNING: return "error-warning";
+        case CanBusState::ERROR_PASSIVE: return "error-passive";
+        case CanBusState::BUS_OFF: return "bus-off";
+        case CanBusState::DOWN: return "down";
+    }
+    return "unknown";
+}
+
+std::shared_ptr<SocketCAN> SocketCAN::get(std::string interface) {
+    std::lock_guard<std::mutex> lock(instances_mutex_);
+    if (logger_.get() == nullptr) {
+        logger_ = spdlog::get("SocketCAN");
+        if (logger_.get() == nullptr) logger_ = spdlog::stdout_color_mt("SocketCAN");
+    }
+    if (instances_.find(interface) == instances_.end()) instances_[interface] = createInstance(interface);
+    return instances_[interface];
+}
+
+std::shared_ptr<SocketCAN> SocketCAN::find(const std::string &interface) {
+    std::lock_guard<std::mutex> lock(instances_mutex_);
+    auto it = instances_.find(interface);
+    return it == instances_.end() ? nullptr : it->second;
+}
+
+SocketCAN::SocketCAN(std::string interface)
+    : interface_(interface), sockfd_(INIT_FD), receiving_(false), tx_queue_(TX_QUEUE_SIZE),
+      control_slots_(new CanControlSlot[CAN_SFF_MASK + 1]), control_ready_(CAN_SFF_MASK + 1),
+      rtt_trackers_(new CanRttTracker[CAN_MAX_RTT_TRACKERS]),
+      rtt_by_command_(new std::atomic<uint8_t>[CAN_SFF_MASK + 1]()), rtt_by_reply_(new std::atomic<uint8_t>[CAN_SFF_MASK + 1]()) {
+    open(interface);
+}
+
+SocketCAN::~SocketCAN() { this->close(); }
+
+void SocketCAN::open(std::string interface) {
+    sockfd_ = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (sockfd_ == INIT_FD) {
+        logger_->error("Failed to create CAN socket");
+        throw std::runtime_error("Failed to create CAN socket");
+    }
+
+    strncpy(if_request_.ifr_name, interface.c_str(), IFNAMSIZ);
+    if (ioctl(sockfd_, SIOCGIFINDEX, &if_request_) == -1) {
+        logger_->error("Unable to detect CAN interface {}", interface);
+
+        this->close();
+        throw std::runtime_error("Unable to detect CAN interface " + interface);
+    }
+
+    // Keep the socket's share of kernel memory below the interface queue, so a busy adapter shows
+    // up as EAGAIN / POLLOUT on this socket instead of ENOBUFS from the queueing discipline.
+    ifreq txq_request = if_request_;
+    if (ioctl(sockfd_, SIOCGIFTXQLEN, &txq_request) == 0 && txq_request.ifr_qlen > 0 &&
+        txq_request.ifr_qlen < tx_budget_frames_) {
+        logger_->warn("{} txqueuelen is {}, TX budget reduced from {} frames (raise with: ip link set {} txqueuelen {})",
+                      interface, txq_request.ifr_qlen, tx_budget_frames_, interface, tx_budget_frames_);
+        tx_budget_frames_ = txq_request.ifr_qlen;
+    }
+    int bufsize = tx_budget_frames_ * TX_FRAME_TRUESIZE / 2;  // the kernel doubles SO_SNDBUF
+    if (setsockopt(sockfd_, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize)) != 0) {
+        logger_->warn("Failed to set SO_SNDBUF on {}: {}", interface, strerror(errno));
+    }
+
+    can_err_mask_t err_mask = CAN_ERR_MASK;
+    if (setsockopt(sockfd_, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &err_mask, sizeof(err_mask)) != 0) {
+        logger_->warn("Failed to subscribe to error frames on {}: {}", interface, strerror(errno));
+    }
+
+    tx_event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    recovery_event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (tx_event_fd_ < 0 || recovery_event_fd_ < 0) {
+        logger_->error("Failed to create TX eventfd");
+        this->close();
+        throw std::runtime_error("Failed to create TX eventfd");
+    }
+
+    // Bind the socket to the network interface
+    addr_.can_family = AF_CAN;
+    addr_.can_ifindex = if_request_.ifr_ifindex;
+    int rc = ::bind(sockfd_, reinterpret_cast<struct sockaddr *>(&addr_), sizeof(addr_));
+    if (rc == -1) {
+        logger_->error("Failed to bind socket to network interface {}", interface);
+        this->close();
+        throw std::runtime_error("Failed to bind socket to network interface " + interface);
+    }
+
+    int flags = fcntl(sockfd_, F_GETFL, 0);
+    if (flags == -1) {
+        logger_->error("Failed to get socket flags");
+        this->close();
+        throw std::runtime_error("Failed to get socket flags");
+    }
+    if (fcntl(sockfd_, F_SETFL, flags | O_NONBLOCK) == -1) {
+        logger_->error("Failed to set socket to non-blocking");
+        this->close();
+        throw std::runtime_error("Failed to set socket to non-blocking");
+    }
+
+    if (!link_is_up()) {
+        set_bus_state(CanBusState::DOWN);
+    }
+    uint32_t bitrate = 0;
+    int bitrate_err = can_link_get_bitrate(if_request_.ifr_ifindex, bitrate);
+    if (bitrate_err == 0) {
+        bitrate_ = bitrate;
+    } else {
+        logger_->info("No bitrate reported for {} ({}), bus load assumes {} bit/s", interface, strerror(bitrate_err), bitrate_);
+    }
+
+    receiving_ = true;
+    receiver_thread_ = std::thread([this]() {
+        ThreadTopology::instance().apply("can_rx", interface_);
+
+        fd_set descriptors;
+        int maxfd = sockfd_;
+        struct timeval timeout;
+        can_frame rx_frame;
+
+        while (receiving_) {
+            FD_ZERO(&descriptors);
+            FD_SET(sockfd_, &descriptors);
+
+            timeout.tv_sec = TIMEOUT_SEC;
+            timeout.tv_usec = TIMEOUT_USEC;
+
+            int ready = ::select(maxfd + 1, &descriptors, NULL, NULL, &timeout);
+            update_stats_window(monotonic_ns());
+            if (ready == 1) {
+                while (true){
+                    int len = ::read(sockfd_, &rx_frame, CAN_MTU);
+                    if (len < 0) {
+                        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                            break; 
+                        }
+                        if (errno == ENETDOWN || errno == ENODEV) {
+                            notify_link_down();
+                            break;
+                        }
+                        logger_->warn("CAN read error: {}", strerror(errno));
+                        break;
+                    }
+                    if (len == 0){
+                        break;
+                    }
+                    if (rx_frame.can_id & CAN_ERR_FLAG) {
+                        handle_error_frame(rx_frame);
+                        continue;
+                    }
+                    rx_frames_.fetch_add(1, std::memory_order_relaxed);
+                    rx_bits_.fetch_add(can_frame_bits(rx_frame), std::memory_order_relaxed);
+                    if (!(rx_frame.can_id & CAN_EFF_FLAG)) {
+                        uint8_t tracker = rtt_by_reply_[rx_frame.can_id & CAN_SFF_MASK].load(std::memory_order_acquire);
+                        if (tracker != 0) rtt_trackers_[tracker - 1].on_reply(monotonic_ns());
+                    }
+                    dispatch(rx_frame);
+                }
+            }
+        }
+    });
+
+    sender_thread_ = std::thread([this]() {
+        ThreadTopology::instance().apply("can_tx", interface_);
+
+        can_frame tx_frame;
+        while (receiving_) {
+            uint64_t watchdog_due_ns = service_watchdog(monotonic_ns());
+            if (pop_control(tx_frame)) {
+                send_frame(tx_frame);
+                continue;
+            }
+            if (tx_queue_.pop(tx_frame)) {
+                tx_pending_.fetch_sub(1, std::memory_order_relaxed);
+                send_frame(tx_frame);
+                continue;
+            }
+            // announce the sleep before the final check, producers wake us only while it is set
+            tx_sleeping_.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (control_ready_.empty() && tx_queue_.empty() && receiving_) {
+                struct pollfd pfd{tx_event_fd_, POLLIN, 0};
+                if (watchdog_due_ns == 0) {
+                    ::poll(&pfd, 1, -1);
+                } else {
+                    uint64_t now = monotonic_ns();
+                    uint64_t wait_ns = watchdog_due_ns > now ? watchdog_due_ns - now : 0;
+                    struct timespec timeout{static_cast<time_t>(wait_ns / 1000000000ull),
+                                            static_cast<long>(wait_ns % 1000000000ull)};
+                    ::ppoll(&pfd, 1, &timeout, nullptr);
+                }
+            }
+            tx_sleeping_.store(false);
+            uint64_t events;
+            ssize_t ret = ::read(tx_event_fd_, &events, sizeof(events));
+            (void)ret;
+        }
+    });
+
+    recovery_thread_ = std::thread([this]() {
+        ThreadTopology::instance().apply("can_err", interface_);
+        recovery_loop();
+    });
+}
+
+// RX thread. Error frames are generated by the driver, see linux/can/error.h.
+void SocketCAN::handle_error_frame(const can_frame &frame) {
+    canid_t err = frame.can_id & CAN_ERR_MASK;
+    err_frames_.fetch_add(1, std::memory_order_relaxed);
+    if (err & CAN_ERR_TX_TIMEOUT) err_tx_timeout_.fetch_add(1, std::memory_order_relaxed);
+    if (err & CAN_ERR_LOSTARB) err_lost_arbitration_.fetch_add(1, std::memory_order_relaxed);
+    if (err & (CAN_ERR_PROT | CAN_ERR_BUSERROR)) err_bus_error_.fetch_add(1, std::memory_order_relaxed);
+    if (err & CAN_ERR_ACK) err_no_ack_.fetch_add(1, std::memory_order_relaxed);
+    if ((err & CAN_ERR_CRTL) && (frame.data[1] & (CAN_ERR_CRTL_RX_OVERFLOW | CAN_ERR_CRTL_TX_OVERFLOW))) {
+        err_overflow_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (err & (CAN_ERR_CNT | CAN_ERR_CRTL)) {
+        tx_error_count_.store(frame.data[6], std::memory_order_relaxed);
+        rx_error_count_.store(frame.data[7], std::memory_order_relaxed);
+    }
+
+    CanBusState state = get_bus_state();
+    if (err & CAN_ERR_BUSOFF) {
+        state = CanBusState::BUS_OFF;
+    } else if (err & CAN_ERR_RESTARTED) {
+        state = CanBusState::ERROR_ACTIVE;
+    } else if (err & CAN_ERR_CRTL) {
+        uint8_t ctrl = frame.data[1];
+        if (ctrl & (CAN_ERR_CRTL_RX_PASSIVE | CAN_ERR_CRTL_TX_PASSIVE)) {
+            state = CanBusState::ERROR_PASSIVE;
+        } else if (ctrl & (CAN_ERR_CRTL_RX_WARNING | CAN_ERR_CRTL_TX_WARNING)) {
+            state = CanBusState::ERROR_WARNING;
+        } else if (ctrl & CAN_ERR_CRTL_ACTIVE) {
+            state = CanBusState::ERROR_ACTIVE;
+        }
+    }
+    set_bus_state(state);
+}
+
+void SocketCAN::set_bus_state(CanBusState state) {
+    CanBusState prev = static_cast<CanBusState>(bus_state_.exchange(static_cast<uint8_t>(state)));
+    if (prev == state) {
+        return;
+    }
+    switch (state) {
+        case CanBusState::ERROR_WARNING: err_warning_.fetch_add(1, std::memory_order_relaxed); break;
+        case CanBusState::ERROR_PASSIVE: err_passive_.fetch_add(1, std::memory_order_relaxed); break;
+        case CanBusState::BUS_OFF: err_bus_off_.fetch_add(1, std::memory_order_relaxed); break;
+        default: break;
+    }
+    if (state > prev) {
+        logger_->warn("{} is {} (was {}), TEC {} REC {}", interface_, can_bus_state_name(state),
+                      can_bus_state_name(prev), tx_error_count_.load(), rx_error_count_.load());
+    } else {
+        logger_->info("{} is {} (was {})", interface_, can_bus_state_name(state), can_bus_state_name(prev));
+    }
+    if (state >= CanBusState::BUS_OFF && recovery_event_fd_ >= 0) {
+        uint64_t one = 1;
+        ssize_t ret = ::write(recovery_event_fd_, &one, sizeof(one));
+        (void)ret;
+    }
+}
+
+// ENETDOWN is also reported once for our own down / up restart, by then the link may be up again.
+void SocketCAN::notify_link_down() {
+    if (!link_is_up()) {
+        set_bus_state(CanBusState::DOWN);
+    }
+}
+
+bool SocketCAN::link_is_up() {
+    ifreq flags_request = if_request_;
+    return ioctl(sockfd_, SIOCGIFFLAGS, &flags_request) == 0 && (flags_request.ifr_flags & IFF_UP);
+}
+
+// Re-reads the state of a faulted link from the kernel, true if it is usable again. The link may
+// recover without our restart: brought up externally, restarted by the kernel (restart-ms), or
+// while our restarts fail (EPERM without CAP_NET_ADMIN, EBUSY once it already left bus-off).
+bool SocketCAN::probe_link() {
+    if (!link_is_up()) {
+        return false;
+    }
+    uint32_t can_state = 0;
+    int err = can_link_get_state(if_request_.ifr_ifindex, can_state);
+    CanBusState state = CanBusState::ERROR_ACTIVE;  // up without a reported state (vcan)
+    if (err == 0) {
+        switch (can_state) {
+            case CAN_STATE_ERROR_ACTIVE: state = CanBusState::ERROR_ACTIVE; break;
+            case CAN_STATE_ERROR_WARNING: state = CanBusState::ERROR_WARNING; break;
+            case CAN_STATE_ERROR_PASSIVE: state = CanBusState::ERROR_PASSIVE; break;
+            default: return false;  // bus-off, stopped or sleeping
+        }
+    }
+    set_bus_state(state);
+    return true;
+}
+
+void SocketCAN::recovery_loop() {
+    int backoff_ms = 0;             // 0: no restart since the bus was last stable
+    uint64_t next_restart_ns = 0;   // 0: no restart scheduled
+    uint64_t last_restart_ns = 0;
+    while (receiving_) {
+        int timeout_ms = -1;
+        uint64_t now = monotonic_ns();
+        int backoff_min_ms = restart_backoff_min_ms_.load();
+        int backoff_max_ms = restart_backoff_max_ms_.load();
+        if (get_bus_state() >= CanBusState::BUS_OFF && probe_link()) {
+            continue;
+        }
+        if (get_bus_state() >= CanBusState::BUS_OFF && restart_enabled_.load()) {
+            if (next_restart_ns == 0) {
+                backoff_ms = backoff_ms == 0 ? backoff_min_ms : std::min(backoff_ms * 2, backoff_max_ms);
+                next_restart_ns = now + static_cast<uint64_t>(backoff_ms) * 1000000ull;
+            }
+            if (now >= next_restart_ns) {
+                restart_link(get_bus_state());
+                last_restart_ns = monotonic_ns();
+                next_restart_ns = 0;  // still faulted on the next pass: the delay doubles
+                continue;
+            }
+            timeout_ms = std::min(static_cast<int>((next_restart_ns - now + 999999) / 1000000), LINK_PROBE_MS);
+        } else if (get_bus_state() >= CanBusState::BUS_OFF) {
+            next_restart_ns = 0;
+            timeout_ms = LINK_PROBE_MS;
+        } else {
+            next_restart_ns = 0;
+            if (backoff_ms != 0) {
+                uint64_t stable_until = last_restart_ns + static_cast<uint64_t>(backoff_max_ms) * 1000000ull;
+                if (now >= stable_until) {
+                    backoff_ms = 0;
+                } else {
+                    timeout_ms = static_cast<int>((stable_until - now + 999999) / 1000000);
+                }
+            }
+        }
+        struct pollfd pfd{recovery_event_fd_, POLLIN, 0};
+        ::poll(&pfd, 1, timeout_ms);
+        uint64_t events;
+        ssize_t ret = ::read(recovery_event_fd_, &events, sizeof(events));
+        (void)ret;
+    }
+}
+
+// A bus-off controller is restarted in place; drivers without restart support and interfaces that
+// went down are (re)started with a link down / up.
+bool SocketCAN::restart_link(CanBusState state) {
+    int ifindex = if_request_.ifr_ifindex;
+    int err = EOPNOTSUPP;
+    if (state == CanBusState::BUS_OFF) {
+        err = can_link_restart(ifindex);
+        if (err == EBUSY) {
+            return false;  // restart-ms is set and the kernel restarts it, or it already left bus-off
+        }
+        if (err == EOPNOTSUPP) {
+            err = can_link_set_up(ifindex, false);
+        }
+    }
+    if (err == 0 || err == EOPNOTSUPP) {
+        err = can_link_set_up(ifindex, true);
+    }
+    if (err != 0) {
+        restart_failures_.fetch_add(1, std::memory_order_relaxed);
+        logger_->error("Failed to restart {} ({}): {}", interface_, can_bus_state_name(state), strerror(err));
+        return false;
+    }
+    restarts_.fetch_add(1, std::memory_order_relaxed);
+    logger_->info("Restarted {} after {}", interface_, can_bus_state_name(state));
+    set_bus_state(CanBusState::ERROR_ACTIVE);
+    return true;
+}
+
+void SocketCAN::set_restart_cfg(const CanRestartCfg &cfg) {
+    if (cfg.backoff_min_ms <= 0 || cfg.backoff_max_ms < cfg.backoff_min_ms) {
+        throw std::runtime_error(fmt::format("Invalid CAN restart backoff [{}, {}] ms", cfg.backoff_min_ms, cfg.backoff_max_ms));
+    }
+    restart_backoff_min_ms_.store(cfg.backoff_min_ms);
+    restart_backoff_max_ms_.store(cfg.backoff_max_ms);
+    restart_enabled_.store(cfg.enabled);
+    if (recovery_event_fd_ >= 0) {
+        uint64_t one = 1;
+        ssize_t ret = ::write(recovery_event_fd_, &one, sizeof(one));
+        (void)ret;
+    }
+}
+
+SocketCAN::BusErrorStats SocketCAN::get_bus_error_stats() const {
+    return {get_bus_state(),
+            tx_error_count_.load(std::memory_order_relaxed),
+            rx_error_count_.load(std::memory_order_relaxed),
+            err_frames_.load(std::memory_order_relaxed),
+            err_warning_.load(std::memory_order_relaxed),
+            err_passive_.load(std::memory_order_relaxed),
+            err_bus_off_.load(std::memory_order_relaxed),
+            err_tx_timeout_.load(std::memory_order_relaxed),
+            err_lost_arbitration_.load(std::memory_order_relaxed),
+            err_bus_error_.load(std::memory_order_relaxed),
+            err_no_ack_.load(std::memory_order_relaxed),
+            err_overflow_.load(std::memory_order_relaxed),
+            restarts_.load(std::memory_order_relaxed),
+            restart_failures_.load(std::memory_order_relaxed)};
+}
+
+// Paced by the socket: EAGAIN means the send budget is in flight, wait for POLLOUT; ENOBUFS means
+// the interface queue is full (shared with other sockets), which poll does not report, back off.
+void SocketCAN::send_frame(const can_frame &frame) {
+    if (get_bus_state() >= CanBusState::BUS_OFF) {
+        tx_dropped_.fetch_add(1, std::memory_order_relaxed);  // stale by the time the bus is back
+        return;
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;) {
+        if (::write(sockfd_, &frame, sizeof(can_frame)) == sizeof(can_frame)) {
+            tx_frames_.fetch_add(1, std::memory_order_relaxed);
+            tx_bits_.fetch_add(can_frame_bits(frame), std::memory_order_relaxed);
+            if (!(frame.can_id & CAN_EFF_FLAG)) {
+                uint8_t tracker = rtt_by_command_[frame.can_id & CAN_SFF_MASK].load(std::memory_order_acquire);
+                if (tracker != 0) rtt_trackers_[tracker - 1].on_sent(monotonic_ns());
+            }
+            return;
+        }
+        int err = errno;
+        if (err == ENETDOWN || err == ENODEV) {
+            tx_dropped_.fetch_add(1, std::memory_order_relaxed);
+            notify_link_down();
+            return;
+        }
+        if (err != EAGAIN && err != EWOULDBLOCK && err != ENOBUFS && err != EINTR) {
+            tx_dropped_.fetch_add(1, std::memory_order_relaxed);
+            logger_->error("Failed to transmit CAN frame on {}: {}", interface_, strerror(err));
+            return;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t waited_us = (now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000;
+        if (waited_us >= TX_TIMEOUT_US || !receiving_) {
+            if (tx_dropped_.fetch_add(1, std::memory_order_relaxed) == 0) {
+                logger_->error("CAN TX on {} blocked for {} us, dropping frames", interface_, waited_us);
+            }
+            return;
+        }
+        if (err == ENOBUFS) {
+            tx_enobufs_.fetch_add(1, std::memory_order_relaxed);
+            struct timespec backoff{0, TX_ENOBUFS_BACKOFF_US * 1000};
+            nanosleep(&backoff, nullptr);
+        } else if (err != EINTR) {
+            tx_queue_full_.fetch_add(1, std::memory_order_relaxed);
+            struct pollfd pfd{sockfd_, POLLOUT, 0};
+            int timeout_ms = static_cast<int>((TX_TIMEOUT_US - waited_us + 999) / 1000);
+            ::poll(&pfd, 1, timeout_ms);
+        }
+    }
+}
+
+// TX thread, every loop. Returns when the watchdog has to run next, 0 while it is disarmed.
+uint64_t SocketCAN::service_watchdog(uint64_t now_ns) {
+    if (!watchdog_armed_.load(std::memory_order_acquire)) {
+        watchdog_tripped_.store(false, std::memory_order_relaxed);
+        return 0;
+    }
+    uint64_t timeout_ns = watchdog_timeout_ns_.load(std::memory_order_relaxed);
+    uint64_t due_ns = last_control_ns_.load(std::memory_order_relaxed) + timeout_ns;
+    if (now_ns < due_ns) {
+        watchdog_tripped_.store(false, std::memory_order_relaxed);
+        return due_ns;
+    }
+    if (!watchdog_tripped_.load(std::memory_order_relaxed)) {
+        watchdog_tripped_.store(true, std::memory_order_relaxed);
+        watchdog_trips_.fetch_add(1, std::memory_order_relaxed);
+        watchdog_next_ns_ = now_ns;
+        logger_->warn("No control frame on {} for {} ms, sending fallback frames", interface_, timeout_ns / 1000000);
+    }
+    if (now_ns >= watchdog_next_ns_) {
+        std::unique_lock<std::mutex> lock(watchdog_mutex_, std::try_to_lock);
+        if (lock.owns_lock() && watchdog_armed_.load(std::memory_order_relaxed)) {
+            for (const can_frame &frame : watchdog_frames_) {
+                send_frame(frame);
+            }
+            watchdog_sent_.fetch_add(watchdog_frames_.size(), std::memory_order_relaxed);
+        }
+        watchdog_next_ns_ = now_ns + watchdog_period_ns_.load(std::memory_order_relaxed);
+    }
+    return watchdog_next_ns_;
+}
+
+void SocketCAN::arm_control_watchdog(const std::vector<can_frame> &fallback, uint32_t timeout_us, uint32_t period_us) {
+    if (timeout_us == 0 || period_us == 0) {
+        throw std::runtime_error("Control watchdog on " + interface_ + " needs a timeout and a period");
+    }
+    {
+        std::lock_guard<std::mutex> lock(watchdog_mutex_);
+        watchdog_frames_ = fallback;
+        watchdog_timeout_ns_.store(static_cast<uint64_t>(timeout_us) * 1000, std::memory_order_relaxed);
+        watchdog_period_ns_.store(static_cast<uint64_t>(period_us) * 1000, std::memory_order_relaxed);
+        last_control_ns_.store(monotonic_ns(), std::memory_order_relaxed);
+        watchdog_armed_.store(true, std::memory_order_release);
+    }
+    wake_sender();  // sleeps without a deadline while disarmed
+}
+
+void SocketCAN::disarm_control_watchdog() {
+    watchdog_armed_.store(false, std::memory_order_release);
+    std::lock_guard<std::mutex> lock(watchdog_mutex_);
+    watchdog_frames_.clear();
+}
+
+SocketCAN::WatchdogStats SocketCAN::get_watchdog_stats() const {
+    return {watchdog_armed_.load(std::memory_order_relaxed), watchdog_tripped_.load(std::memory_order_relaxed),
+            watchdog_trips_.load(std::memory_order_relaxed), watchdog_sent_.load(std::memory_order_relaxed)};
+}
+
+void SocketCAN::wake_sender() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (tx_sleeping_.load()) {
+        uint64_t one = 1;
+        ssize_t ret = ::write(tx_event_fd_, &one, sizeof(one));
+        (void)ret;
+    }
+}
+
+SocketCAN::TxStats SocketCAN::get_tx_stats() const {
+    return {tx_frames_.load(std::memory_order_relaxed), tx_queue_full_.load(std::memory_order_relaxed),
+            tx_enobufs_.load(std::memory_order_relaxed), tx_dropped_.load(std::memory_order_relaxed),
+            control_coalesced_.load(std::memory_order_relaxed)};
+}
+
+void SocketCAN::close() {
+    receiving_ = false;
+    uint64_t one = 1;
+    if (tx_event_fd_ >= 0) {
+        ssize_t ret = ::write(tx_event_fd_, &one, sizeof(one));
+        (void)ret;
+    }
+    if (recovery_event_fd_ >= 0) {
+        ssize_t ret = ::write(recovery_event_fd_, &one, sizeof(one));
+        (void)ret;
+    }
+    if (receiver_thread_.joinable()) receiver_thread_.join();
+    if (sender_thread_.joinable()) sender_thread_.join();
+    if (recovery_thread_.joinable()) recovery_thread_.join();
+
+    if (sockfd_ != INIT_FD) ::close(sockfd_);
+    sockfd_ = INIT_FD;
+    if (tx_event_fd_ >= 0) ::close(tx_event_fd_);
+    tx_event_fd_ = -1;
+    if (recovery_event_fd_ >= 0) ::close(recovery_event_fd_);
+    recovery_event_fd_ = -1;
+}
+
+void SocketCAN::transmit_control(const can_frame &frame) {
+    if (frame.can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG)) {
+        transmit(frame);
+        return;
+    }
+    if (sockfd_ == INIT_FD) {
+        logger_->error("Unable to transmit: Socket not open");
+        return;
+    }
+    last_control_ns_.store(monotonic_ns(), std::memory_order_relaxed);
+    if (post_control(frame)) {
+        wake_sender();
+    }
+}
+
+void SocketCAN::transmit_control(const can_frame *frames, size_t count) {
+    if (sockfd_ == INIT_FD) {
+        logger_->error("Unable to transmit: Socket not open");
+        return;
+    }
+    last_control_ns_.store(monotonic_ns(), std::memory_order_relaxed);
+    bool queued = false;
+    for (size_t i = 0; i < count; i++) {
+        if (frames[i].can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG)) {
+            transmit(frames[i]);
+        } else {
+            queued |= post_control(frames[i]);
+        }
+    }
+    if (queued) {
+        wake_sender();
+    }
+}
+
+// Stores the frame in its mailbox, true when the ID was queued for the TX thread.
+bool SocketCAN::post_control(const can_frame &frame) {
+    uint16_t id = static_cast<uint16_t>(frame.can_id & CAN_SFF_MASK);
+    CanControlSlot &slot = control_slots_[id];
+    uint64_t data;
+    memcpy(&data, frame.data, sizeof(data));
+    slot.data.store(data, std::memory_order_relaxed);
+    uint32_t prev = slot.state.exchange(CONTROL_PENDING | frame.can_dlc, std::memory_order_acq_rel);
+    if (prev & CONTROL_PENDING) {
+        control_coalesced_.fetch_add(1, std::memory_order_relaxed);  // still queued, now carries the new frame
+        return false;
+    }
+    if (control_ready_.bounded_push(id)) {
+        count_tx_pending();
+    }
+    return true;
+}
+
+// TX thread only. The pending flag is taken before the payload is read, a newer frame written in
+// between is sent now and at most once more with the same content.
+bool SocketCAN::pop_control(can_frame &frame) {
+    uint16_t id;
+    while (control_ready_.pop(id)) {
+        tx_pending_.fetch_sub(1, std::memory_order_relaxed);
+        CanControlSlot &slot = control_slots_[id];
+        uint32_t state = slot.state.exchange(0, std::memory_order_acq_rel);
+        if (!(state & CONTROL_PENDING)) {
+            continue;
+        }
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        frame.can_id = id;
+        frame.can_dlc = static_cast<uint8_t>(state & 0xFF);
+        memcpy(frame.data, &data, sizeof(data));
+        return true;
+    }
+    return false;
+}
+
+void SocketCAN::transmit(const can_frame &frame) {
+    if (sockfd_ == INIT_FD) {
+        logger_->error("Unable to transmit: Socket not open");
+        return;
+    }
+    if (tx_queue_.bounded_push(frame)) {
+        count_tx_pending();
+    } else {
+        tx_dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    wake_sender();
+}
+
+void SocketCAN::count_tx_pending() {
+    uint64_t depth = tx_pending_.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint64_t high = tx_pending_high_water_.load(std::memory_order_relaxed);
+    while (depth > high && !tx_pending_high_water_.compare_exchange_weak(high, depth, std::memory_order_relaxed)) {
+    }
+}
+
+// RX thread, once per wakeup: rates over the last completed window.
+void SocketCAN::update_stats_window(uint64_t now_ns) {
+    if (window_start_ns_ == 0) {
+        window_start_ns_ = now_ns;
+        return;
+    }
+    uint64_t elapsed_ns = now_ns - window_start_ns_;
+    if (elapsed_ns < CAN_STATS_WINDOW_NS) {
+        return;
+    }
+    uint64_t tx_frames = tx_frames_.load(std::memory_order_relaxed);
+    uint64_t rx_frames = rx_frames_.load(std::memory_order_relaxed);
+    uint64_t bits = tx_bits_.load(std::memory_order_relaxed) + rx_bits_.load(std::memory_order_relaxed);
+    double seconds = static_cast<double>(elapsed_ns) * 1e-9;
+    tx_fps_.store(static_cast<float>((tx_frames - window_tx_frames_) / seconds), std::memory_order_relaxed);
+    rx_fps_.store(static_cast<float>((rx_frames - window_rx_frames_) / seconds), std::memory_order_relaxed);
+    bus_load_.store(static_cast<float>((bits - window_bits_) / (seconds * bitrate_)), std::memory_order_relaxed);
+    stats_stamp_ns_.store(now_ns, std::memory_order_relaxed);
+    window_start_ns_ = now_ns;
+    window_tx_frames_ = tx_frames;
+    window_rx_frames_ = rx_frames;
+    window_bits_ = bits;
+}
+
+void SocketCAN::add_rtt_tracking(const CanCbkId command_id, const CanCbkId reply_id) {
+    if (command_id > CAN_SFF_MASK || reply_id > CAN_SFF_MASK) {
+        throw std::runtime_error(fmt::format("RTT tracking needs standard IDs, got 0x{:x} -> 0x{:x}", command_id, reply_id));
+    }
+    std::lock_guard<std::mutex> lock(can_callback_mutex_);
+    uint8_t tracker = rtt_by_reply_[reply_id].load();
+    if (tracker == 0) {
+        if (rtt_tracker_count_ == CAN_MAX_RTT_TRACKERS) {
+            throw std::runtime_error(fmt::format("Too many RTT trackers on {}", interface_));
+        }
+        CanRttTracker &t = rtt_trackers_[rtt_tracker_count_];
+        t.command_id.store(command_id);
+        t.reply_id.store(reply_id);
+        tracker = static_cast<uint8_t>(++rtt_tracker_count_);
+        rtt_by_reply_[reply_id].store(tracker, std::memory_order_release);
+    }
+    rtt_by_command_[command_id].store(tracker, std::memory_order_release);
+}
+
+// The tracker and its statistics are kept, a later add_rtt_tracking() for the reply ID reuses them.
+void SocketCAN::remove_rtt_tracking(const CanCbkId command_id) {
+    if (command_id <= CAN_SFF_MASK) {
+        rtt_by_command_[command_id].store(0, std::memory_order_release);
+    }
+}
+
+CanBusStats SocketCAN::get_bus_stats() const {
+    CanBusStats stats;
+    stats.interface = interface_;
+    stats.bitrate = bitrate_;
+    stats.stamp_ns = stats_stamp_ns_.load(std::memory_order_relaxed);
+    stats.tx_frames = tx_frames_.load(std::memory_order_relaxed);
+    stats.rx_frames = rx_frames_.load(std::memory_order_relaxed);
+    stats.tx_fps = tx_fps_.load(std::memory_order_relaxed);
+    stats.rx_fps = rx_fps_.load(std::memory_order_relaxed);
+    stats.load = bus_load_.load(std::memory_order_relaxed);
+    stats.tx_queue_depth = tx_pending_.load(std::memory_order_relaxed);
+    stats.tx_queue_high_water = tx_pending_high_water_.load(std::memory_order_relaxed);
+    for (int i = 0; i < CAN_MAX_RTT_TRACKERS; i++) {
+        const CanRttTracker &t = rtt_trackers_[i];
+        if (t.reply_id.load() == 0 && t.command_id.load() == 0) {
+            break;
+        }
+        CanRttStats rtt;
+        rtt.command_id = t.command_id.load(std::memory_order_relaxed);
+        rtt.reply_id = t.reply_id.load(std::memory_order_relaxed);
+        rtt.replies = t.replies.load(std::memory_order_relaxed);
+        rtt.lost = t.lost.load(std::memory_order_relaxed);
+        rtt.sum_ns = t.sum_ns.load(std::memory_order_relaxed);
+        rtt.max_ns = t.max_ns.load(std::memory_order_relaxed);
+        for (int b = 0; b < CAN_RTT_BUCKETS; b++) {
+            rtt.histogram[b] = t.histogram[b].load(std::memory_order_relaxed);
+        }
+        stats.rtt.push_back(rtt);
+    }
+    return stats;
+}
+
+// Lock free: the table pointer is loaded once per frame, callbacks are called in place.
+// rx_dispatch_seq_ lets (un)registration wait until no frame is dispatched from a replaced table.
+void SocketCAN::dispatch(const can_frame &frame) {
+    rx_dispatch_seq_.fetch_add(1);
+    const CanDispatchTable *table = dispatch_table_.load();
+    if (table != nullptr) {
+        CanCbkId key = can_dispatch_key(frame.can_id);
+        if (key != CAN_ERR_FLAG) {
+            const CanCbkFunc *callback = table->find(key);
+            if (callback != nullptr) {
+                (*callback)(frame);
+            }
+        }
+        for (const auto &sub : table->masked()) {
+            if (sub.filter.matches(frame.can_id)) {
+                sub.callback(frame);
+            }
+        }
+    }
+    rx_dispatch_seq_.fetch_add(1);
+}
+
+void SocketCAN::publish_table(std::vector<CanDispatchTable::Exact> exact, std::vector<CanDispatchTable::Masked> masked) {
+    auto table = std::make_unique<CanDispatchTable>(std::move(exact), std::move(masked));
+    dispatch_table_.store(table.get());
+    dispatch_tables_.push_back(std::move(table));
+    if (std::this_thread::get_id() == receiver_thread_.get_id()) {
+        return;  // called from a callback, retired tables are kept until the next registration
+    }
+    // grace period: a dispatch in progress may still use a retired table
+    uint32_t seq = rx_dispatch_seq_.load();
+    if (seq & 1u) {
+        while (rx_dispatch_seq_.load() == seq) {
+            std::this_thread::yield();
+        }
+    }
+    dispatch_tables_.erase(dispatch_tables_.begin(), dispatch_tables_.end() - 1);
+}
+
+void SocketCAN::add_can_callback(const CanCbkFunc callback, const CanCbkId id) {
+    std::lock_guard<std::mutex> lock(can_callback_mutex_);
+    const CanDispatchTable *table = dispatch_table_.load();
+    std::vector<CanDispatchTable::Exact> exact = table ? table->exact() : std::vector<CanDispatchTable::Exact>();
+    std::vector<CanDispatchTable::Masked> masked = table ? table->masked() : std::vector<CanDispatchTable::Masked>();
+    exact.push_back({id, callback});
+    publish_table(std::move(exact), std::move(masked));
+}
+
+void SocketCAN::remove_can_callback(CanCbkId id) {
+    std::lock_guard<std::mutex> lock(can_callback_mutex_);
+    const CanDispatchTable *table = dispatch_table_.load();
+    if (table == nullptr) {
+        return;
+    }
+    std::vector<CanDispatchTable::Exact> exact;
+    for (const auto &sub : table->exact()) {
+        if (sub.id != id) exact.push_back(sub);
+    }
+    publish_table(std::move(exact), table->masked());
+}
+
+void SocketCAN::add_can_callback(const CanCbkFunc callback, const CanFilter &filter) {
+    std::lock_guard<std::mutex> lock(can_callback_mutex_);
+    const CanDispatchTable *table = dispatch_table_.load();
+    std::vector<CanDispatchTable::Exact> exact = table ? table->exact() : std::vector<CanDispatchTable::Exact>();
+    std::vector<CanDispatchTable::Masked> masked = table ? table->masked() : std::vector<CanDispatchTable::Masked>();
+    masked.push_back({filter, callback});
+    publish_table(std::move(exact), std::move(masked));
+}
+
+void SocketCAN::remove_can_callback(const CanFilter &filter) {
+    std::lock_guard<std::mutex> lock(can_callback_mutex_);
+    const CanDispatchTable *table = dispatch_table_.load();
+    if (table == nullptr) {
+        return;
+    }
+    std::vector<CanDispatchTable::Masked> masked;
+    for (const auto &sub : table->masked()) {
+        if (!(sub.filter == filter)) masked.push_back(sub);
+    }
+    publish_table(table->exact(), std::move(masked));
+}
+
+void SocketCAN::clear_can_callbacks() {
+    std::lock_guard<std::mutex> lock(can_callback_mutex_);
+    publish_table({}, {});
+}
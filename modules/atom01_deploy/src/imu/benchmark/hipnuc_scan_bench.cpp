@@ -0,0 +1,97 @@
+// Throughput of the per-byte HiPNUC decoder (hipnuc_input) against the block scanner (hipnuc_scan)
+// on a synthetic 0x91 / 0x92 stream, fed in read()-sized chunks.
+//
+//   hipnuc_scan_bench [frames] [chunk_bytes]
+
+extern "C" {
+#include "hipnuc_dec.h"
+#include "hipnuc_scan.h"
+}
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static void append_frame(std::vector<uint8_t>& out, const uint8_t* payload, uint16_t len) {
+    uint8_t hdr[6] = {0x5A, 0xA5, static_cast<uint8_t>(len & 0xFF), static_cast<uint8_t>(len >> 8), 0, 0};
+    uint16_t crc = hipnuc_scan_crc16(0, hdr, 4);
+    crc = hipnuc_scan_crc16(crc, payload, len);
+    hdr[4] = crc & 0xFF;
+    hdr[5] = crc >> 8;
+    out.insert(out.end(), hdr, hdr + 6);
+    out.insert(out.end(), payload, payload + len);
+}
+
+static std::vector<uint8_t> make_stream(size_t frames, uint8_t tag) {
+    std::vector<uint8_t> out;
+    hipnuc_scanner_t init;
+    hipnuc_scanner_init(&init);
+    for (size_t i = 0; i < frames; i++) {
+        if (tag == 0x91) {
+            hi91_t p;
+            memset(&p, 0, sizeof(p));
+            p.tag = 0x91;
+            p.system_time = static_cast<uint32_t>(i);
+            p.gyr[0] = 0.1f * (i % 100);
+            p.quat[0] = 1.0f;
+            append_frame(out, reinterpret_cast<const uint8_t*>(&p), sizeof(p));
+        } else {
+            hi92_t p;
+            memset(&p, 0, sizeof(p));
+            p.tag = 0x92;
+            p.gyr_b[0] = static_cast<int16_t>(i % 1000);
+            p.quat[0] = 10000;
+            append_frame(out, reinterpret_cast<const uint8_t*>(&p), sizeof(p));
+        }
+        // a little line noise between frames
+        if (i % 64 == 0) {
+            out.push_back(0x5A);
+            out.push_back(0x00);
+        }
+    }
+    return out;
+}
+
+static void count_cbk(void* ctx, const hipnuc_imu_t*) { ++*static_cast<size_t*>(ctx); }
+
+static void run(const char* name, const std::vector<uint8_t>& stream, size_t chunk) {
+    static hipnuc_raw_t raw;
+    memset(&raw, 0, sizeof(raw));
+    size_t n_input = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t ofs = 0; ofs < stream.size(); ofs += chunk) {
+        size_t len = std::min(chunk, stream.size() - ofs);
+        for (size_t i = 0; i < len; i++) {
+            if (hipnuc_input(&raw, stream[ofs + i]) > 0) {
+                n_input++;
+            }
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    hipnuc_scanner_t scanner;
+    hipnuc_scanner_init(&scanner);
+    size_t n_scan = 0;
+    for (size_t ofs = 0; ofs < stream.size(); ofs += chunk) {
+        size_t len = std::min(chunk, stream.size() - ofs);
+        hipnuc_scan(&scanner, stream.data() + ofs, len, count_cbk, &n_scan);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    double s_input = std::chrono::duration<double>(t1 - t0).count();
+    double s_scan = std::chrono::duration<double>(t2 - t1).count();
+    double mb = stream.size() / 1e6;
+    printf("%s: %zu bytes, chunk %zu\n", name, stream.size(), chunk);
+    printf("  hipnuc_input  %8.1f MB/s  %zu frames\n", mb / s_input, n_input);
+    printf("  hipnuc_scan   %8.1f MB/s  %zu frames  (%.1fx)\n", mb / s_scan, n_scan, s_input / s_scan);
+}
+
+int main(int argc, char** argv) {
+    size_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+    size_t chunk = argc > 2 ? strtoul(argv[2], nullptr, 10) : 256;
+    run("HI91", make_stream(frames, 0x91), chunk);
+    run("HI92", make_stream(frames, 0x92), chunk);
+    return 0;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct ClockSyncCfg {
+    uint32_t bucket_ms = 100;               // device time per regression point
+    size_t window = 128;                    // regression points kept (window * bucket_ms of history)
+    size_t min_points = 8;                  // points needed before timestamps are aligned
+    uint64_t stall_threshold_ns = 5000000;  // queueing delay above which a transport stall is counted
+    uint64_t fixed_delay_ns = 0;            // constant sensor/transport latency not observable from timestamps
+    int64_t max_jump_ms = 1000;             // device/host clock disagreement that restarts the estimate
+};
+
+struct ClockSyncStats {
+    bool synced = false;
+    double drift_ppm = 0.0;         // device clock rate error against CLOCK_MONOTONIC, positive when fast
+    uint64_t delay_ns = 0;          // transport delay of the latest sample
+    uint64_t delay_mean_ns = 0;     // smoothed transport delay
+    uint64_t delay_peak_ns = 0;     // largest transport delay within the regression window
+    uint32_t stalls = 0;            // number of times the delay crossed stall_threshold_ns
+    uint32_t resets = 0;            // number of restarts after device clock jumps
+};
+
+// Maps device timestamps (ms) to CLOCK_MONOTONIC. Samples are grouped into bucket_ms intervals;
+// the rate is a least squares line through the bucket means (averaging out the 1 ms device
+// resolution), the offset comes from the lower envelope formed by the least delayed sample of each
+// bucket, so the line approximates the host time at which a sample was taken. Transport delay is
+// the RX time minus that line (plus fixed_delay_ns).
+// Single threaded, runs on the RX thread of the driver. Buffers are allocated in the constructor.
+class ClockSync {
+   public:
+    explicit ClockSync(const ClockSyncCfg& cfg = ClockSyncCfg());
+
+    void reset();
+
+    // Feeds one (device time, RX time) pair, returns the host-aligned timestamp of the sample.
+    uint64_t update(uint32_t device_ms, uint64_t rx_ns);
+
+    // Host-aligned timestamp for a sample without its own device time (mean delay compensation).
+    uint64_t compensate(uint64_t rx_ns);
+
+    const ClockSyncStats& get_stats() const { return stats_; }
+
+   private:
+    struct Point {
+        int64_t device_ms;      // least delayed sample of the bucket, unwrapped
+        uint64_t rx_ns;
+        double mean_dev_ms;     // bucket mean relative to the sample above
+        double mean_rx_ns;
+        uint64_t delay_peak_ns;
+    };
+
+    void open_bucket(int64_t device_ms, uint64_t rx_ns);
+    void close_bucket();
+    void refit();
+    uint64_t monotonic(uint64_t stamp_ns, uint64_t rx_ns);
+
+    ClockSyncCfg cfg_;
+    ClockSyncStats stats_;
+
+    std::vector<Point> points_;     // ring of bucket minima
+    size_t head_ = 0;
+    size_t count_ = 0;
+
+    bool started_ = false;
+    uint32_t last_raw_ms_ = 0;
+    int64_t last_device_ms_ = 0;
+    uint64_t last_rx_ns_ = 0;
+    uint64_t last_stamp_ns_ = 0;
+
+    int64_t bucket_ = 0;
+    Point current_{};               // open bucket
+    int64_t first_device_ms_ = 0;   // first sample of the open bucket, base of the sums
+    uint64_t first_rx_ns_ = 0;
+    double sum_dev_ms_ = 0.0;
+    double sum_rx_ns_ = 0.0;
+    size_t samples_ = 0;
+
+    // host_ns = ref_rx_ns_ + offset_ns_ + slope_ * (device_ms - ref_device_ms_)
+    bool valid_ = false;
+    int64_t ref_device_ms_ = 0;
+    uint64_t ref_rx_ns_ = 0;
+    double offset_ns_ = 0.0;
+    double slope_ = 1e6;            // ns per device ms
+    bool in_stall_ = false;
+};
@@ -4,12 +4,32 @@
 #include <string.h>
 #include <iostream>
 #include <cmath>
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "rt_clock.hpp"
+#include "imu_sample.hpp"
+#include "imu_filter.hpp"
+#include "clock_sync.hpp"
+#include "seqlock.hpp"
+
+using ImuSampleCbk = std::function<void(const ImuSample&)>;
+
+// Device side configuration applied at startup. Unset fields keep the current device setting.
+struct ImuDeviceCfg {
+    int rate_hz = 0;            // output rate
+    uint8_t packet = 0;         // output packet, e.g. 0x91 / 0x92 on HiPNUC serial
+    int filter_mode = -1;       // on-device attitude filter mode
+    std::vector<std::pair<uint16_t, uint32_t>> registers;   // raw configuration registers (address, value)
+    std::string can_protocol;   // CAN frame protocol, e.g. "j1939" / "canopen" on HiPNUC, empty accepts all
+    bool save = false;          // store the configuration in device flash
+};
+
 class IMUDriver {
    public:
 
@@ -20,16 +40,107 @@ class IMUDriver {
                                                 const std::string& imu_type, const int baudrate=0);
 
     virtual uint16_t get_imu_id() { return imu_id_; }
-    virtual std::vector<float> get_ang_vel() { return ang_vel_; }
-    virtual std::vector<float> get_quat() { return quat_; }
-    virtual std::vector<float> get_lin_acc() { return lin_acc_; }
-    virtual float get_temperature() { return temperature_; }
+    virtual std::vector<float> get_ang_vel() {
+        ImuSample sample;
+        latest_.load(sample);
+        return {sample.gyro[0], sample.gyro[1], sample.gyro[2]};
+    }
+    virtual std::vector<float> get_quat() {
+        ImuSample sample;
+        latest_.load(sample);
+        return {sample.quat[0], sample.quat[1], sample.quat[2], sample.quat[3]};
+    }
+    virtual std::vector<float> get_lin_acc() {
+        ImuSample sample;
+        latest_.load(sample);
+        return {sample.acc[0], sample.acc[1], sample.acc[2]};
+    }
+    virtual float get_temperature() {
+        ImuSample sample;
+        latest_.load(sample);
+        return sample.temperature;
+    }
+
+    // Applies cfg to the device and verifies it by read-back; throws if the device does not confirm it.
+    virtual void configure(const ImuDeviceCfg& /*cfg*/) {
+        throw std::runtime_error("IMU configuration not supported");
+    }
+
+    // Called from the RX thread for every decoded sample. Set once, before samples are consumed.
+    void set_sample_callback(ImuSampleCbk cbk) {
+        sample_cbk_ = std::move(cbk);
+        has_sample_cbk_.store(true, std::memory_order_release);
+    }
+
+    // Enables per-sample filtering on the RX thread. Set once; samples passed to the callback and
+    // returned by get_latest_sample() are filtered from then on.
+    void set_filter(const ImuFilterCfg& cfg) {
+        if (filter_) {
+            throw std::runtime_error("IMU filter already configured");
+        }
+        filter_ = std::make_unique<ImuFilter>(cfg);
+        has_filter_.store(true, std::memory_order_release);
+    }
+
+    // Latest (filtered) sample, lock free and allocation free. Returns false before the first sample.
+    bool get_latest_sample(ImuSample& out) const {
+        latest_.load(out);
+        return out.seq != 0;
+    }
+
+    // Device clock synchronization state, lock free.
+    ClockSyncStats get_clock_stats() const {
+        ClockSyncStats stats;
+        clock_stats_.load(stats);
+        return stats;
+    }
 
    protected:
+    // Publishes a decoded sample, RX thread only. Assigns the sequence number and the host-aligned
+    // timestamp: samples carrying a device time feed the clock estimate, others are compensated by
+    // the mean transport delay.
+    void publish_sample(ImuSample& sample) {
+        sample.seq = ++sample_seq_;
+        if (sample.device_time_ms != 0) {
+            sample.stamp_ns = clock_sync_.update(sample.device_time_ms, sample.rx_time_ns);
+        } else {
+            sample.stamp_ns = clock_sync_.compensate(sample.rx_time_ns);
+        }
+        ClockSyncStats clock_stats = clock_sync_.get_stats();
+        clock_stats_.store(clock_stats);
+        if (has_filter_.load(std::memory_order_acquire)) {
+            // a device clock jump (the IMU restarted) moves the sample stamps, the filter restarts
+            // with the clock estimate instead of integrating across the jump
+            if (clock_stats.resets != filter_clock_resets_) {
+                filter_clock_resets_ = clock_stats.resets;
+                filter_->reset();
+            }
+            ImuSample filtered;
+            filter_->update(sample, filtered);
+            sample = filtered;
+        }
+        latest_.store(sample);
+        if (has_sample_cbk_.load(std::memory_order_acquire)) {
+            sample_cbk_(sample);
+        }
+    }
+
+    // Device time carried by a non-sample message (e.g. a time frame), RX thread only.
+    void sync_device_time(uint32_t device_time_ms, uint64_t rx_time_ns) {
+        clock_sync_.update(device_time_ms, rx_time_ns);
+        clock_stats_.store(clock_sync_.get_stats());
+    }
+
     uint16_t imu_id_;
 
-    std::vector<float> quat_{0.f, 0.f, 0.f, 0.f};       // w, x, y, z
-    std::vector<float> ang_vel_{0.f, 0.f, 0.f};         // x, y, z
-    std::vector<float> lin_acc_{0.f, 0.f, 0.f};         // x, y, z
-    float temperature_{0.f}; // temperature
+   private:
+    ImuSampleCbk sample_cbk_;
+    std::atomic<bool> has_sample_cbk_{false};
+    std::unique_ptr<ImuFilter> filter_;
+    std::atomic<bool> has_filter_{false};
+    uint32_t filter_clock_resets_ = 0;  // clock sync resets seen by the filter, RX thread only
+    Seqlock<ImuSample> latest_;
+    ClockSync clock_sync_;
+    Seqlock<ClockSyncStats> clock_stats_;
+    uint32_t sample_seq_ = 0;
 };
\ No newline at end of file
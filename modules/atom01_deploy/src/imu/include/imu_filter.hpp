@@ -0,0 +1,37 @@
+#pragma once
+
+#include "imu_sample.hpp"
+
+struct ImuFilterCfg {
+    float gyro_alpha = 1.0f;            // weight of the new gyro sample in the low-pass, 1 = unfiltered
+    float angle_alpha = 1.0f;           // weight of the device attitude against the gyro prediction, 1 = device only
+    bool bias_estimation = false;       // track the gyro bias while the body is at rest
+    float still_gyro_threshold = 0.05f; // rad/s, bias-corrected rate below which the body may be at rest
+    float still_acc_threshold = 0.3f;   // m/s^2, allowed deviation of |acc| from gravity at rest
+    float still_time = 0.5f;            // s at rest before the bias is updated
+    float bias_gain = 0.002f;           // per sample bias update gain
+    float max_dt = 0.05f;               // s, larger sample gaps are not integrated
+};
+
+// Per-sample IMU processing, run on the RX thread at the sensor rate:
+// gyro bias removal, first order gyro low-pass and complementary attitude fusion.
+class ImuFilter {
+   public:
+    explicit ImuFilter(const ImuFilterCfg& cfg);
+
+    // Forgets the filter state and the gyro bias, called when the sample time base jumped.
+    void reset();
+    void update(const ImuSample& raw, ImuSample& out);
+
+    const ImuFilterCfg& get_cfg() const { return cfg_; }
+    const float* get_gyro_bias() const { return gyro_bias_; }
+
+   private:
+    ImuFilterCfg cfg_;
+    bool initialized_ = false;
+    uint64_t last_time_ns_ = 0;
+    uint64_t still_since_ns_ = 0;
+    float gyro_bias_[3] = {0.f, 0.f, 0.f};
+    float gyro_[3] = {0.f, 0.f, 0.f};
+    float quat_[4] = {1.f, 0.f, 0.f, 0.f};
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+struct ImuSample {
+    float quat[4];              // w, x, y, z
+    float gyro[3];              // rad/s
+    float acc[3];               // m/s^2
+    float temperature;          // degC
+    uint32_t device_time_ms;    // device timestamp, 0 if the packet carries none
+    uint64_t rx_time_ns;        // CLOCK_MONOTONIC when the packet was received
+    uint64_t stamp_ns;          // CLOCK_MONOTONIC when the sample was taken, transport delay removed
+    uint32_t seq;               // per driver sample counter, starts at 1
+};
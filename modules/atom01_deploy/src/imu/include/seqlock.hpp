@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+// Single-writer sequence lock for small POD values.
+// The writer never blocks; readers retry while a write is in progress.
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock requires a POD value type");
+
+   public:
+    void store(const T& value) {
+        uint32_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        value_ = value;
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    void load(T& out) const {
+        for (;;) {
+            uint32_t seq0 = seq_.load(std::memory_order_acquire);
+            if (seq0 & 1u) {
+                continue;
+            }
+            out = value_;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == seq0) {
+                return;
+            }
+        }
+    }
+
+    // number of completed writes
+    uint32_t version() const { return seq_.load(std::memory_order_acquire) >> 1; }
+
+   private:
+    std::atomic<uint32_t> seq_{0};
+    T value_{};
+};
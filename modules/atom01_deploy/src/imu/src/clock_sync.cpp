@@ -0,0 +1,171 @@
+#include "clock_sync.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+ClockSync::ClockSync(const ClockSyncCfg& cfg) : cfg_(cfg), points_(cfg.window) {
+    if (cfg_.window < 2 || cfg_.min_points < 2 || cfg_.min_points > cfg_.window || cfg_.bucket_ms == 0) {
+        throw std::runtime_error("Invalid IMU clock sync configuration");
+    }
+}
+
+void ClockSync::reset() {
+    head_ = 0;
+    count_ = 0;
+    started_ = false;
+    valid_ = false;
+    slope_ = 1e6;
+    in_stall_ = false;
+    stats_.synced = false;
+    stats_.drift_ppm = 0.0;
+    stats_.delay_ns = 0;
+    stats_.delay_mean_ns = 0;
+    stats_.delay_peak_ns = 0;
+}
+
+uint64_t ClockSync::update(uint32_t device_ms, uint64_t rx_ns) {
+    if (started_) {
+        // unwrap the 32 bit device counter and restart on jumps the host clock does not see
+        int64_t device = last_device_ms_ + static_cast<int32_t>(device_ms - last_raw_ms_);
+        int64_t host_ms = static_cast<int64_t>(rx_ns - last_rx_ns_) / 1000000;
+        int64_t ddev = device - last_device_ms_;
+        if (ddev < 0 || ddev - host_ms > cfg_.max_jump_ms || rx_ns < last_rx_ns_) {
+            reset();
+            stats_.resets++;
+        } else {
+            last_device_ms_ = device;
+        }
+    }
+    if (!started_) {
+        started_ = true;
+        last_device_ms_ = 0;
+        bucket_ = 0;
+        open_bucket(0, rx_ns);
+    }
+    last_raw_ms_ = device_ms;
+    last_rx_ns_ = rx_ns;
+
+    const int64_t device = last_device_ms_;
+    const int64_t bucket = device / cfg_.bucket_ms;
+    if (bucket != bucket_) {
+        close_bucket();
+        refit();
+        bucket_ = bucket;
+        open_bucket(device, rx_ns);
+    } else if (static_cast<double>(rx_ns - current_.rx_ns) < static_cast<double>(device - current_.device_ms) * slope_) {
+        // less delayed than the current bucket minimum
+        current_.device_ms = device;
+        current_.rx_ns = rx_ns;
+    }
+    sum_dev_ms_ += static_cast<double>(device - first_device_ms_);
+    sum_rx_ns_ += static_cast<double>(rx_ns - first_rx_ns_);
+    samples_++;
+
+    if (!valid_) {
+        return monotonic(rx_ns - std::min(rx_ns, cfg_.fixed_delay_ns), rx_ns);
+    }
+
+    double host = static_cast<double>(ref_rx_ns_) + offset_ns_ + slope_ * static_cast<double>(device - ref_device_ms_);
+    double delay = static_cast<double>(rx_ns) - host;
+    uint64_t delay_ns = (delay > 0.0 ? static_cast<uint64_t>(delay) : 0) + cfg_.fixed_delay_ns;
+
+    stats_.delay_ns = delay_ns;
+    stats_.delay_mean_ns = stats_.delay_mean_ns == 0 ? delay_ns
+        : static_cast<uint64_t>(0.99 * static_cast<double>(stats_.delay_mean_ns) + 0.01 * static_cast<double>(delay_ns));
+    current_.delay_peak_ns = std::max(current_.delay_peak_ns, delay_ns);
+    stats_.delay_peak_ns = std::max(stats_.delay_peak_ns, delay_ns);
+    if (!in_stall_ && delay_ns > cfg_.stall_threshold_ns) {
+        in_stall_ = true;
+        stats_.stalls++;
+    } else if (in_stall_ && delay_ns < cfg_.stall_threshold_ns / 2) {
+        in_stall_ = false;
+    }
+    return monotonic(rx_ns - std::min(rx_ns, delay_ns), rx_ns);
+}
+
+uint64_t ClockSync::compensate(uint64_t rx_ns) {
+    uint64_t delay_ns = valid_ ? stats_.delay_mean_ns : cfg_.fixed_delay_ns;
+    return monotonic(rx_ns - std::min(rx_ns, delay_ns), rx_ns);
+}
+
+void ClockSync::open_bucket(int64_t device_ms, uint64_t rx_ns) {
+    current_ = {device_ms, rx_ns, 0.0, 0.0, 0};
+    first_device_ms_ = device_ms;
+    first_rx_ns_ = rx_ns;
+    sum_dev_ms_ = 0.0;
+    sum_rx_ns_ = 0.0;
+    samples_ = 0;
+}
+
+void ClockSync::close_bucket() {
+    if (samples_ == 0) {
+        return;
+    }
+    const double n = static_cast<double>(samples_);
+    current_.mean_dev_ms = static_cast<double>(first_device_ms_ - current_.device_ms) + sum_dev_ms_ / n;
+    current_.mean_rx_ns = static_cast<double>(static_cast<int64_t>(first_rx_ns_ - current_.rx_ns)) + sum_rx_ns_ / n;
+    points_[head_] = current_;
+    head_ = (head_ + 1) % points_.size();
+    count_ = std::min(count_ + 1, points_.size());
+}
+
+// Refitting moves the line by a fraction of a bucket, keep stamps strictly increasing and
+// never later than the RX time.
+uint64_t ClockSync::monotonic(uint64_t stamp_ns, uint64_t rx_ns) {
+    if (stamp_ns <= last_stamp_ns_) {
+        stamp_ns = std::min(last_stamp_ns_ + 1, rx_ns);
+    }
+    last_stamp_ns_ = stamp_ns;
+    return stamp_ns;
+}
+
+void ClockSync::refit() {
+    if (count_ < cfg_.min_points) {
+        return;
+    }
+    // newest point as reference keeps the sums small enough for doubles
+    const Point& ref = points_[(head_ + points_.size() - 1) % points_.size()];
+    const size_t first = (head_ + points_.size() - count_) % points_.size();
+    double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    uint64_t peak = 0;
+    for (size_t i = 0; i < count_; i++) {
+        const Point& p = points_[(first + i) % points_.size()];
+        double x = static_cast<double>(p.device_ms - ref.device_ms) + p.mean_dev_ms;
+        double y = static_cast<double>(static_cast<int64_t>(p.rx_ns - ref.rx_ns)) + p.mean_rx_ns;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+        peak = std::max(peak, p.delay_peak_ns);
+    }
+    const double n = static_cast<double>(count_);
+    const double den = n * sxx - sx * sx;
+    if (den <= 0.0) {
+        return;
+    }
+    const double slope = (n * sxy - sx * sy) / den;
+    const double intercept = (sy - slope * sx) / n;
+
+    // shift onto the lower envelope: the least delayed point defines zero transport delay
+    double min_res = 0.0;
+    bool first_res = true;
+    for (size_t i = 0; i < count_; i++) {
+        const Point& p = points_[(first + i) % points_.size()];
+        double x = static_cast<double>(p.device_ms - ref.device_ms);
+        double y = static_cast<double>(static_cast<int64_t>(p.rx_ns - ref.rx_ns));
+        double res = y - (intercept + slope * x);
+        if (first_res || res < min_res) {
+            min_res = res;
+            first_res = false;
+        }
+    }
+
+    ref_device_ms_ = ref.device_ms;
+    ref_rx_ns_ = ref.rx_ns;
+    offset_ns_ = intercept + min_res;
+    slope_ = slope;
+    valid_ = true;
+    stats_.synced = true;
+    stats_.drift_ppm = (1e6 / slope - 1.0) * 1e6;
+    stats_.delay_peak_ns = peak;
+}
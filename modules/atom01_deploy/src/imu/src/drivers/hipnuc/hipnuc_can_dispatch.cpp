@@ -0,0 +1,76 @@
+#include "hipnuc_can_dispatch.hpp"
+
+#include <stdexcept>
+
+// Scales follow hipnuc_j1939_parser.c / canopen_parser.c, converted to rad/s and m/s^2
+namespace {
+
+constexpr float GRAVITY = 9.80665f;
+constexpr float DEG_TO_RAD = 0.017453292f;
+
+inline int16_t rd_i16(const uint8_t* p) { return static_cast<int16_t>(p[0] | (p[1] << 8)); }
+
+HipnucCanPart j1939_accel(const uint8_t* d, HipnucCanStaging& s) {
+    for (int i = 0; i < 3; i++) s.sample.acc[i] = rd_i16(d + 2 * i) * (0.00048828f * GRAVITY);
+    return HIPNUC_PART_ACC;
+}
+
+HipnucCanPart j1939_gyro(const uint8_t* d, HipnucCanStaging& s) {
+    for (int i = 0; i < 3; i++) s.sample.gyro[i] = rd_i16(d + 2 * i) * (0.061035f * DEG_TO_RAD);
+    return HIPNUC_PART_GYRO;
+}
+
+HipnucCanPart j1939_quat(const uint8_t* d, HipnucCanStaging& s) {
+    for (int i = 0; i < 4; i++) s.sample.quat[i] = rd_i16(d + 2 * i) * 0.0001f;
+    return HIPNUC_PART_QUAT;
+}
+
+HipnucCanPart j1939_env(const uint8_t* d, HipnucCanStaging& s) {
+    s.sample.temperature = rd_i16(d) * 0.01f;
+    return HIPNUC_PART_TEMP;
+}
+
+HipnucCanPart j1939_time(const uint8_t* d, HipnucCanStaging& s) {
+    s.time_ms = d[3] * 3600000u + d[4] * 60000u + d[5] * 1000u + static_cast<uint32_t>(d[6] | (d[7] << 8));
+    return HIPNUC_PART_TIME;
+}
+
+HipnucCanPart canopen_accel(const uint8_t* d, HipnucCanStaging& s) {
+    for (int i = 0; i < 3; i++) s.sample.acc[i] = rd_i16(d + 2 * i) * (0.001f * GRAVITY);
+    return HIPNUC_PART_ACC;
+}
+
+HipnucCanPart canopen_gyro(const uint8_t* d, HipnucCanStaging& s) {
+    for (int i = 0; i < 3; i++) s.sample.gyro[i] = rd_i16(d + 2 * i) * (0.1f * DEG_TO_RAD);
+    return HIPNUC_PART_GYRO;
+}
+
+HipnucCanPart canopen_quat(const uint8_t* d, HipnucCanStaging& s) {
+    for (int i = 0; i < 4; i++) s.sample.quat[i] = rd_i16(d + 2 * i) * 0.0001f;
+    return HIPNUC_PART_QUAT;
+}
+
+}  // namespace
+
+HipnucCanProtocol hipnuc_can_parse_protocol(const std::string& name) {
+    if (name.empty()) return HIPNUC_CAN_ANY;
+    if (name == "j1939") return HIPNUC_CAN_J1939;
+    if (name == "canopen") return HIPNUC_CAN_CANOPEN;
+    throw std::runtime_error("Unknown Hipnuc CAN protocol: " + name);
+}
+
+const HipnucCanDispatch& HipnucCanDispatch::instance() {
+    static const HipnucCanDispatch dispatch;
+    return dispatch;
+}
+
+HipnucCanDispatch::HipnucCanDispatch() {
+    j1939_[0x2F] = j1939_time;      // PGN 0xFF2F
+    j1939_[0x34] = j1939_accel;     // PGN 0xFF34
+    j1939_[0x37] = j1939_gyro;      // PGN 0xFF37
+    j1939_[0x43] = j1939_env;       // PGN 0xFF43
+    j1939_[0x46] = j1939_quat;      // PGN 0xFF46
+    canopen_[0x180 >> 7] = canopen_accel;   // TPDO1
+    canopen_[0x280 >> 7] = canopen_gyro;    // TPDO2
+    canopen_[0x480 >> 7] = canopen_quat;    // TPDO4
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <linux/can.h>
+#include <stdint.h>
+#include <array>
+#include <string>
+
+#include "imu_sample.hpp"
+
+// Parts of one IMU sample carried by separate CAN frames
+enum HipnucCanPart : uint32_t {
+    HIPNUC_PART_NONE = 0,
+    HIPNUC_PART_ACC = 1u << 0,
+    HIPNUC_PART_GYRO = 1u << 1,
+    HIPNUC_PART_QUAT = 1u << 2,
+    HIPNUC_PART_TEMP = 1u << 3,
+    HIPNUC_PART_TIME = 1u << 4,
+};
+
+// Sample being assembled from the frames of one output period
+struct HipnucCanStaging {
+    ImuSample sample;
+    uint32_t parts;             // parts received for the open sample
+    uint64_t first_rx_ns;       // RX time of its first frame
+    uint32_t time_ms;           // time of day of the last TIME frame
+};
+
+// Decodes one frame into the staging sample (SI units), returns the part it wrote
+using HipnucCanDecoder = HipnucCanPart (*)(const uint8_t* data, HipnucCanStaging& staging);
+
+enum HipnucCanProtocol : uint32_t {
+    HIPNUC_CAN_J1939 = 1u << 0,
+    HIPNUC_CAN_CANOPEN = 1u << 1,
+    HIPNUC_CAN_ANY = HIPNUC_CAN_J1939 | HIPNUC_CAN_CANOPEN,
+};
+
+// "j1939", "canopen" or "" (accept both)
+HipnucCanProtocol hipnuc_can_parse_protocol(const std::string& name);
+
+// PGN / COB-ID -> decoder tables, built once. J1939 data PGNs are 0xFFxx (the PDU specific byte
+// indexes a 256 entry table), CANopen TPDOs are told apart by bits 7..10 of the COB-ID.
+class HipnucCanDispatch {
+   public:
+    static const HipnucCanDispatch& instance();
+
+    HipnucCanDecoder lookup(canid_t can_id, uint32_t protocols) const {
+        if (can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG)) {
+            return nullptr;
+        }
+        if (can_id & CAN_EFF_FLAG) {
+            uint32_t pgn = (can_id >> 8) & 0xFFFF;
+            return (protocols & HIPNUC_CAN_J1939) && (pgn >> 8) == 0xFF ? j1939_[pgn & 0xFF] : nullptr;
+        }
+        return (protocols & HIPNUC_CAN_CANOPEN) ? canopen_[(can_id >> 7) & 0xF] : nullptr;
+    }
+
+   private:
+    HipnucCanDispatch();
+
+    std::array<HipnucCanDecoder, 256> j1939_{};
+    std::array<HipnucCanDecoder, 16> canopen_{};
+};
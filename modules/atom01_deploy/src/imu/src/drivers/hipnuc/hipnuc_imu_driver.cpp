@@ -2,8 +2,8 @@
 
 HipnucIMUDriver::HipnucIMUDriver(uint16_t imu_id, const std::string& interface_type, const std::string& interface, const int baudrate)
     : IMUDriver(), imu_id_(imu_id), interface_type_(interface_type), interface_(interface) {
-    memset(&raw_, 0, sizeof(raw_));
-    memset(&sensor_data_, 0, sizeof(sensor_data_));
+    hipnuc_scanner_init(&scanner_);
+    memset(&staging_, 0, sizeof(staging_));
     if (interface_type_ == "serial") {
         baudrate_ = baudrate;
         serial_ = SerialPort::open(interface_, baudrate_);
@@ -12,10 +12,9 @@ HipnucIMUDriver::HipnucIMUDriver(uint16_t imu_id, const std::string& interface_t
     } else if (interface_type_ == "can") {
         can_ = SocketCAN::get(interface_);
         CanCbkFunc can_callback = std::bind(&HipnucIMUDriver::can_rx_cbk, this, std::placeholders::_1);
-        can_->add_can_callback(can_callback, imu_id_);
-        can_->set_key_extractor([](const can_frame &frame) -> CanCbkId {
-            return frame.can_id & 0x7F;
-        });
+        for (const CanFilter& filter : can_filters()) {
+            can_->add_can_callback(can_callback, filter);
+        }
     } else {
         throw std::runtime_error("Hipnuc driver only support CAN and SERIAL interface");
     }
@@ -25,67 +24,232 @@ HipnucIMUDriver::~HipnucIMUDriver() {
     if (interface_type_ == "serial" && serial_) {
         serial_->close();
     } else if (interface_type_ == "can" && can_) {
-        can_->remove_can_callback(imu_id_);
+        for (const CanFilter& filter : can_filters()) {
+            can_->remove_can_callback(filter);
+        }
     }
 }
 
+// J1939 frames are extended frames with the node as source address (low byte), CANopen TPDOs are
+// standard frames 0x180/0x280/0x480 + node. Only those are subscribed, so motors on the same bus
+// keep their own routing.
+std::vector<CanFilter> HipnucIMUDriver::can_filters() const {
+    return {
+        {CAN_EFF_FLAG | (imu_id_ & 0xFFu), CAN_EFF_FLAG | CAN_RTR_FLAG | 0xFFu},
+        {0x180u + (imu_id_ & 0x7Fu), CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_SFF_MASK},
+        {0x280u + (imu_id_ & 0x7Fu), CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_SFF_MASK},
+        {0x480u + (imu_id_ & 0x7Fu), CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_SFF_MASK},
+    };
+}
+
+// Both callbacks run on the single RX thread of the interface, scanner_ and staging_ are only touched there.
+// Gyro, quaternion and acceleration arrive as separate frames; they are collected into staging_ and
+// published together once all three of the same output period are in. A part arriving twice
+// means the rest of the previous period was lost, the incomplete sample is dropped.
 void HipnucIMUDriver::can_rx_cbk(const can_frame& rx_frame) {
+    uint64_t rx_time_ns = monotonic_ns();
+    HipnucCanDecoder decoder = HipnucCanDispatch::instance().lookup(rx_frame.can_id, can_protocols_.load(std::memory_order_relaxed));
+    if (decoder == nullptr) {
+        handle_cfg_frame(rx_frame);
+        return;
+    }
+
+    HipnucCanPart part = decoder(rx_frame.data, staging_);
+    if (part == HIPNUC_PART_TIME) {
+        sync_device_time(staging_.time_ms, rx_time_ns);
+        return;
+    }
+    if (!(part & can_sample_parts)) {
+        return;
+    }
+    if (staging_.parts & part) {
+        incomplete_count_.fetch_add(1, std::memory_order_relaxed);
+        staging_.parts = 0;
+    }
+    if (staging_.parts == 0) {
+        staging_.first_rx_ns = rx_time_ns;
+    }
+    staging_.parts |= part;
+    if (staging_.parts != can_sample_parts) {
+        return;
+    }
+    staging_.parts = 0;
+
+    ImuSample sample = staging_.sample;
+    // data frames carry no device time, the TIME frames feed the clock estimate instead
+    sample.device_time_ms = 0;
+    sample.rx_time_ns = staging_.first_rx_ns;
+    publish_sample(sample);
+}
+
+void HipnucIMUDriver::handle_cfg_frame(const can_frame& rx_frame) {
     hipnuc_can_frame_t frame;
     frame.can_id = rx_frame.can_id;
     frame.can_dlc = rx_frame.can_dlc;
     memcpy(frame.data, rx_frame.data, 8);
-    
-    std::unique_lock<std::shared_mutex> lock(imu_mutex_);
-    
-    int ret = hipnuc_j1939_parse_frame(&frame, &sensor_data_);
-    if (ret == 0) {
+
+    uint16_t addr;
+    hipnuc_j1939_cmd_t cmd;
+    uint8_t status;
+    uint32_t val;
+    if (hipnuc_j1939_parse_cfg(&frame, &addr, &cmd, &status, &val) != 0) {
         return;
     }
-    
-    ret = canopen_parse_frame(&frame, &sensor_data_);
-    if (ret == 0) {
-        return;
+    {
+        std::lock_guard<std::mutex> lock(cfg_mutex_);
+        cfg_reply_valid_ = true;
+        cfg_reply_addr_ = addr;
+        cfg_reply_status_ = status;
+        cfg_reply_val_ = val;
     }
+    cfg_cv_.notify_all();
 }
 
 void HipnucIMUDriver::serial_rx_cbk(const uint8_t* data, size_t length) {
-    std::unique_lock<std::shared_mutex> lock(imu_mutex_);
-    
-    for (size_t i = 0; i < length; i++) {
-        if (hipnuc_input(&raw_, data[i])) {
-            // Update sensor data from parsed raw data
-            sensor_data_.quat_w = raw_.hi91.quat[0];
-            sensor_data_.quat_x = raw_.hi91.quat[1];
-            sensor_data_.quat_y = raw_.hi91.quat[2];
-            sensor_data_.quat_z = raw_.hi91.quat[3];
-            
-            sensor_data_.gyr_x = raw_.hi91.gyr[0] * DEG_TO_RAD;
-            sensor_data_.gyr_y = raw_.hi91.gyr[1] * DEG_TO_RAD;
-            sensor_data_.gyr_z = raw_.hi91.gyr[2] * DEG_TO_RAD;
-            
-            sensor_data_.acc_x = raw_.hi91.acc[0] * GRA_ACC;
-            sensor_data_.acc_y = raw_.hi91.acc[1] * GRA_ACC;
-            sensor_data_.acc_z = raw_.hi91.acc[2] * GRA_ACC;
-        }
+    rx_time_ns_ = monotonic_ns();
+    hipnuc_scan(&scanner_, data, length, &HipnucIMUDriver::scan_cbk, this);
+}
+
+void HipnucIMUDriver::scan_cbk(void* ctx, const hipnuc_imu_t* imu) {
+    auto* self = static_cast<HipnucIMUDriver*>(ctx);
+    if (imu->tag == 0x91) {
+        self->hi91_count_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        self->hi92_count_.fetch_add(1, std::memory_order_relaxed);
     }
+    uint8_t packet = self->packet_.load(std::memory_order_relaxed);
+    if (packet != 0 && imu->tag != packet) {
+        return;
+    }
+    ImuSample sample;
+    memcpy(sample.quat, imu->quat, sizeof(sample.quat));
+    memcpy(sample.gyro, imu->gyr, sizeof(sample.gyro));
+    memcpy(sample.acc, imu->acc, sizeof(sample.acc));
+    sample.temperature = imu->temperature;
+    sample.device_time_ms = imu->system_time;
+    sample.rx_time_ns = self->rx_time_ns_;
+    self->publish_sample(sample);
 }
 
-std::vector<float> HipnucIMUDriver::get_ang_vel() {
-    std::shared_lock<std::shared_mutex> lock(imu_mutex_);
-    return {sensor_data_.gyr_x, sensor_data_.gyr_y, sensor_data_.gyr_z};
+void HipnucIMUDriver::configure(const ImuDeviceCfg& cfg) {
+    if (interface_type_ == "serial") {
+        configure_serial(cfg);
+    } else {
+        configure_can(cfg);
+    }
 }
 
-std::vector<float> HipnucIMUDriver::get_quat() {
-    std::shared_lock<std::shared_mutex> lock(imu_mutex_);
-    return {sensor_data_.quat_w, sensor_data_.quat_x, sensor_data_.quat_y, sensor_data_.quat_z};
+// ASCII commands of the HiPNUC serial protocol, terminated by CRLF.
+// 0x92 carries gyro/acc/quat as int16 (54 bytes per frame instead of 82 for 0x91), which allows
+// roughly 1.5x the output rate at the same baudrate, but has no device timestamp.
+void HipnucIMUDriver::configure_serial(const ImuDeviceCfg& cfg) {
+    if (!cfg.registers.empty() || !cfg.can_protocol.empty()) {
+        throw std::runtime_error("Hipnuc register and protocol configuration is only supported on the CAN interface");
+    }
+    if ((cfg.packet == 0) != (cfg.rate_hz == 0)) {
+        throw std::runtime_error("Hipnuc serial output needs both packet and rate");
+    }
+    if (cfg.packet != 0 && cfg.packet != 0x91 && cfg.packet != 0x92) {
+        throw std::runtime_error("Hipnuc driver only supports packet 0x91 and 0x92");
+    }
+    if (cfg.rate_hz < 0) {
+        throw std::runtime_error("Hipnuc output rate must be positive");
+    }
+
+    char cmd[64];
+    send_command("LOG DISABLE");
+    if (cfg.filter_mode >= 0) {
+        // attitude mode: 0 = 6-axis, 1 = 9-axis (magnetometer aided)
+        snprintf(cmd, sizeof(cmd), "CONFIG ATT MODE %d", cfg.filter_mode);
+        send_command(cmd);
+    }
+    if (cfg.packet != 0) {
+        packet_.store(cfg.packet, std::memory_order_relaxed);
+        snprintf(cmd, sizeof(cmd), "LOG HI%02X ONTIME %g", cfg.packet, 1.0 / cfg.rate_hz);
+        send_command(cmd);
+    }
+    if (cfg.save) {
+        send_command("SAVECONFIG");
+    }
+    send_command("LOG ENABLE");
+
+    if (cfg.packet == 0) {
+        return;
+    }
+    // the serial protocol has no register read-back, verify the packet type and rate on the stream
+    std::this_thread::sleep_for(std::chrono::milliseconds(command_delay_ms));
+    uint32_t n91 = hi91_count_.load(), n92 = hi92_count_.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(rate_verify_time_ms));
+    uint32_t d91 = hi91_count_.load() - n91, d92 = hi92_count_.load() - n92;
+    uint32_t got = cfg.packet == 0x91 ? d91 : d92;
+    uint32_t other = cfg.packet == 0x91 ? d92 : d91;
+    float rate = got * 1000.0f / rate_verify_time_ms;
+    if (rate < 0.8f * cfg.rate_hz || rate > 1.2f * cfg.rate_hz || other != 0) {
+        throw std::runtime_error("Hipnuc IMU configuration not confirmed: expected HI" + std::to_string(cfg.packet == 0x91 ? 91 : 92) +
+                                 " at " + std::to_string(cfg.rate_hz) + " Hz, measured " + std::to_string(rate) +
+                                 " Hz and " + std::to_string(other) + " other packets");
+    }
 }
 
-std::vector<float> HipnucIMUDriver::get_lin_acc() {
-    std::shared_lock<std::shared_mutex> lock(imu_mutex_);
-    return {sensor_data_.acc_x, sensor_data_.acc_y, sensor_data_.acc_z};
+// J1939 configuration frames (PGN 0xEF00), each register write is confirmed by reading it back.
+// Rate and filter registers differ between HiPNUC CAN models, so they are given as raw registers.
+void HipnucIMUDriver::configure_can(const ImuDeviceCfg& cfg) {
+    if (cfg.packet != 0 || cfg.rate_hz != 0 || cfg.filter_mode >= 0) {
+        throw std::runtime_error("Hipnuc CAN configuration is given as registers");
+    }
+    // frames of the other protocol are ignored from here on
+    can_protocols_.store(hipnuc_can_parse_protocol(cfg.can_protocol), std::memory_order_relaxed);
+    for (const auto& reg : cfg.registers) {
+        write_register(reg.first, reg.second);
+        uint32_t val = read_register(reg.first);
+        if (val != reg.second) {
+            throw std::runtime_error("Hipnuc register 0x" + fmt::format("{:04X}", reg.first) + " reads back " +
+                                     std::to_string(val) + ", expected " + std::to_string(reg.second));
+        }
+    }
+    if (cfg.save) {
+        write_register(0x0000, 0);  // control register, 0 = save configuration
+    }
 }
 
-float HipnucIMUDriver::get_temperature() {
-    std::shared_lock<std::shared_mutex> lock(imu_mutex_);
-    return sensor_data_.temperature;
-}
\ No newline at end of file
+void HipnucIMUDriver::send_command(const std::string& cmd) {
+    serial_->write(cmd + "\r\n");
+    std::this_thread::sleep_for(std::chrono::milliseconds(command_delay_ms));
+}
+
+void HipnucIMUDriver::write_register(uint16_t addr, uint32_t val) {
+    hipnuc_can_frame_t frame;
+    hipnuc_j1939_build_cfg_write(imu_id_, 0x00, addr, val, &frame);
+    can_frame tx_frame;
+    tx_frame.can_id = frame.can_id;
+    tx_frame.can_dlc = frame.can_dlc;
+    memcpy(tx_frame.data, frame.data, 8);
+    can_->transmit(tx_frame);
+    std::this_thread::sleep_for(std::chrono::milliseconds(command_delay_ms));
+}
+
+uint32_t HipnucIMUDriver::read_register(uint16_t addr) {
+    hipnuc_can_frame_t frame;
+    hipnuc_j1939_build_cfg_read(imu_id_, 0x00, addr, 1, &frame);
+    can_frame tx_frame;
+    tx_frame.can_id = frame.can_id;
+    tx_frame.can_dlc = frame.can_dlc;
+    memcpy(tx_frame.data, frame.data, 8);
+
+    std::unique_lock<std::mutex> lock(cfg_mutex_);
+    cfg_reply_valid_ = false;
+    lock.unlock();
+    can_->transmit(tx_frame);
+    lock.lock();
+    bool ok = cfg_cv_.wait_for(lock, std::chrono::milliseconds(cfg_reply_timeout_ms), [this, addr]() {
+        return cfg_reply_valid_ && cfg_reply_addr_ == addr;
+    });
+    if (!ok) {
+        throw std::runtime_error("Hipnuc register 0x" + fmt::format("{:04X}", addr) + " read timeout");
+    }
+    if (cfg_reply_status_ != 0) {
+        throw std::runtime_error("Hipnuc register 0x" + fmt::format("{:04X}", addr) + " read failed, status " +
+                                 std::to_string(cfg_reply_status_));
+    }
+    return cfg_reply_val_;
+}
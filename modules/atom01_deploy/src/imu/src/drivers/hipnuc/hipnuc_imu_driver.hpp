@@ -2,6 +2,7 @@
 
 extern "C" {
 #include "hipnuc_dec.h"
+#include "hipnuc_scan.h"
 #include "nmea_decode.h"
 #include "hipnuc_can_common.h"
 #include "hipnuc_j1939_parser.h"
@@ -12,15 +13,14 @@ extern "C" {
 #include <string>
 #include <thread>
 #include <atomic>
-#include <shared_mutex>
+#include <mutex>
+#include <condition_variable>
 
 #include "imu_driver.hpp"
-#include "protocol/can/socket_can.hpp"
+#include "hipnuc_can_dispatch.hpp"
+#include "socket_can.hpp"
 #include "protocol/serial/serial_port.hpp"
 
-#define GRA_ACC     (9.8)
-#define DEG_TO_RAD  (0.01745329)
-
 class HipnucIMUDriver : public IMUDriver {
    public:
     HipnucIMUDriver(uint16_t imu_id, const std::string& interface_type, const std::string& interface, const int baudrate=0);
@@ -28,19 +28,43 @@ class HipnucIMUDriver : public IMUDriver {
 
     void can_rx_cbk(const can_frame& rx_frame);
     void serial_rx_cbk(const uint8_t* data, size_t length);
-    std::vector<float> get_ang_vel() override;
-    std::vector<float> get_quat() override;
-    std::vector<float> get_lin_acc() override;
-    float get_temperature() override;
+    void configure(const ImuDeviceCfg& cfg) override;
+
+    static void scan_cbk(void* ctx, const hipnuc_imu_t* imu);
 
    private:
+    static const int command_delay_ms = 50;
+    static const int cfg_reply_timeout_ms = 100;
+    static const int rate_verify_time_ms = 500;
+    static constexpr uint32_t can_sample_parts = HIPNUC_PART_GYRO | HIPNUC_PART_QUAT | HIPNUC_PART_ACC;
+
+    std::vector<CanFilter> can_filters() const;
+    void handle_cfg_frame(const can_frame& rx_frame);
+    void configure_serial(const ImuDeviceCfg& cfg);
+    void configure_can(const ImuDeviceCfg& cfg);
+    void send_command(const std::string& cmd);
+    uint32_t read_register(uint16_t addr);
+    void write_register(uint16_t addr, uint32_t val);
+
     uint16_t imu_id_;
     int baudrate_;
     std::string interface_type_;
     std::string interface_;
-    mutable std::shared_mutex imu_mutex_;
     std::shared_ptr<SocketCAN> can_;
     std::shared_ptr<SerialPort> serial_;
-    can_sensor_data_t sensor_data_;
-    hipnuc_raw_t raw_;
+    HipnucCanStaging staging_;
+    std::atomic<uint32_t> can_protocols_{HIPNUC_CAN_ANY};
+    std::atomic<uint32_t> incomplete_count_{0};     // CAN samples dropped with parts missing
+    hipnuc_scanner_t scanner_;
+    uint64_t rx_time_ns_ = 0;
+    std::atomic<uint8_t> packet_{0};    // 0 accepts 0x91 and 0x92
+    std::atomic<uint32_t> hi91_count_{0}, hi92_count_{0};
+
+    // J1939 configuration replies, only used while configuring
+    std::mutex cfg_mutex_;
+    std::condition_variable cfg_cv_;
+    bool cfg_reply_valid_ = false;
+    uint16_t cfg_reply_addr_ = 0;
+    uint8_t cfg_reply_status_ = 0;
+    uint32_t cfg_reply_val_ = 0;
 };
\ No newline at end of file
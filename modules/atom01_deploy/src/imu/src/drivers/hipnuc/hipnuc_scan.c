@@ -0,0 +1,195 @@
+#include "hipnuc_scan.h"
+
+#include <string.h>
+
+#define SYNC1           (0x5A)
+#define SYNC2           (0xA5)
+#define HDR_SIZE        (6)
+#define TAG_HI91        (0x91)
+#define TAG_HI92        (0x92)
+#define HI91_SIZE       (76)
+#define HI92_SIZE       (48)
+
+#define DEG_TO_RAD      (0.0174532925f)
+#define GRAVITY         (9.8f)
+
+/* 0x92 integer scales */
+#define HI92_ACC_SCALE  (0.0048828f)    /* m/s^2 */
+#define HI92_GYR_SCALE  (0.001f)        /* rad/s */
+#define HI92_QUAT_SCALE (0.0001f)
+
+static uint16_t crc_table[256];
+static int crc_table_ready = 0;
+
+static void crc_table_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint16_t crc = (uint16_t)(i << 8);
+        for (int j = 0; j < 8; j++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+        crc_table[i] = crc;
+    }
+    crc_table_ready = 1;
+}
+
+uint16_t hipnuc_scan_crc16(uint16_t crc, const uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc = (uint16_t)(crc << 8) ^ crc_table[((crc >> 8) ^ buf[i]) & 0xFF];
+    }
+    return crc;
+}
+
+static uint16_t rd_u16(const uint8_t *p) { uint16_t v; memcpy(&v, p, 2); return v; }
+static int16_t rd_i16(const uint8_t *p) { int16_t v; memcpy(&v, p, 2); return v; }
+static uint32_t rd_u32(const uint8_t *p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static float rd_f32(const uint8_t *p) { float v; memcpy(&v, p, 4); return v; }
+
+/* offsets follow hi91_t / hi92_t in hipnuc_dec.h */
+static void decode_hi91(const uint8_t *p, hipnuc_imu_t *imu)
+{
+    imu->tag = TAG_HI91;
+    imu->temperature = (float)(int8_t)p[3];
+    imu->system_time = rd_u32(p + 8);
+    for (int i = 0; i < 3; i++) {
+        imu->acc[i] = rd_f32(p + 12 + 4 * i) * GRAVITY;
+        imu->gyr[i] = rd_f32(p + 24 + 4 * i) * DEG_TO_RAD;
+    }
+    for (int i = 0; i < 4; i++) {
+        imu->quat[i] = rd_f32(p + 60 + 4 * i);
+    }
+}
+
+static void decode_hi92(const uint8_t *p, hipnuc_imu_t *imu)
+{
+    imu->tag = TAG_HI92;
+    imu->temperature = (float)(int8_t)p[3];
+    imu->system_time = 0;
+    for (int i = 0; i < 3; i++) {
+        imu->gyr[i] = rd_i16(p + 10 + 2 * i) * HI92_GYR_SCALE;
+        imu->acc[i] = rd_i16(p + 16 + 2 * i) * HI92_ACC_SCALE;
+    }
+    for (int i = 0; i < 4; i++) {
+        imu->quat[i] = rd_i16(p + 40 + 2 * i) * HI92_QUAT_SCALE;
+    }
+}
+
+static int decode_payload(const uint8_t *p, size_t len, hipnuc_scan_cbk_t cbk, void *ctx)
+{
+    int n = 0;
+    size_t ofs = 0;
+    hipnuc_imu_t imu;
+
+    while (ofs < len) {
+        if (p[ofs] == TAG_HI91 && ofs + HI91_SIZE <= len) {
+            decode_hi91(p + ofs, &imu);
+            ofs += HI91_SIZE;
+        } else if (p[ofs] == TAG_HI92 && ofs + HI92_SIZE <= len) {
+            decode_hi92(p + ofs, &imu);
+            ofs += HI92_SIZE;
+        } else {
+            /* other packets have no fixed size, skip the rest of the frame */
+            break;
+        }
+        if (cbk) {
+            cbk(ctx, &imu);
+        }
+        n++;
+    }
+    return n;
+}
+
+/* Decodes all complete frames in p[0..n). Returns the number of bytes consumed; whatever is
+ * left starts with a sync byte and is the beginning of an incomplete frame. */
+static size_t scan_block(hipnuc_scanner_t *s, const uint8_t *p, size_t n, int *decoded,
+                         hipnuc_scan_cbk_t cbk, void *ctx)
+{
+    size_t i = 0;
+
+    while (i < n) {
+        const uint8_t *q = (const uint8_t *)memchr(p + i, SYNC1, n - i);
+        if (!q) {
+            return n;
+        }
+        i = (size_t)(q - p);
+        if (i + 1 >= n) {
+            break;
+        }
+        if (p[i + 1] != SYNC2) {
+            i++;
+            continue;
+        }
+        if (i + HDR_SIZE > n) {
+            break;
+        }
+        size_t len = rd_u16(p + i + 2);
+        if (len > HIPNUC_SCAN_MAX_FRAME - HDR_SIZE) {
+            i++;
+            continue;
+        }
+        if (i + HDR_SIZE + len > n) {
+            break;
+        }
+        uint16_t crc = hipnuc_scan_crc16(0, p + i, 4);
+        crc = hipnuc_scan_crc16(crc, p + i + HDR_SIZE, len);
+        if (crc != rd_u16(p + i + 4)) {
+            s->crc_errors++;
+            i++;
+            continue;
+        }
+        s->frames++;
+        *decoded += decode_payload(p + i + HDR_SIZE, len, cbk, ctx);
+        i += HDR_SIZE + len;
+    }
+    return i;
+}
+
+/* bytes still missing from the partial frame held in the scanner */
+static size_t pending_need(const hipnuc_scanner_t *s)
+{
+    if (s->len < HDR_SIZE) {
+        return HDR_SIZE - s->len;
+    }
+    return HDR_SIZE + rd_u16(s->buf + 2) - s->len;
+}
+
+void hipnuc_scanner_init(hipnuc_scanner_t *s)
+{
+    if (!crc_table_ready) {
+        crc_table_init();
+    }
+    s->len = 0;
+    s->frames = 0;
+    s->crc_errors = 0;
+}
+
+int hipnuc_scan(hipnuc_scanner_t *s, const uint8_t *data, size_t len, hipnuc_scan_cbk_t cbk, void *ctx)
+{
+    int decoded = 0;
+
+    while (len > 0) {
+        if (s->len == 0) {
+            /* fast path, decode in place and keep only the tail */
+            size_t used = scan_block(s, data, len, &decoded, cbk, ctx);
+            memcpy(s->buf, data + used, len - used);
+            s->len = len - used;
+            break;
+        }
+
+        /* complete the carried frame first, then continue in place */
+        size_t take = pending_need(s);
+        if (take > len) {
+            take = len;
+        }
+        memcpy(s->buf + s->len, data, take);
+        s->len += take;
+        data += take;
+        len -= take;
+
+        size_t used = scan_block(s, s->buf, s->len, &decoded, cbk, ctx);
+        memmove(s->buf, s->buf + used, s->len - used);
+        s->len -= used;
+    }
+    return decoded;
+}
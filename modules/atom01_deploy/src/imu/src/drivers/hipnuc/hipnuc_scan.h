@@ -0,0 +1,59 @@
+#ifndef HIPNUC_SCAN_H
+#define HIPNUC_SCAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Block decoder for the HiPNUC serial protocol.
+ * Consumes whole read() buffers, locates frames with memchr, checks them with a table driven
+ * CRC16 and decodes 0x91 / 0x92 payloads straight into physical units. Partial frames at the
+ * end of a buffer are carried over to the next call. */
+
+#define HIPNUC_SCAN_MAX_FRAME   (512)
+
+typedef struct
+{
+    uint8_t  tag;           /* packet that produced the sample, 0x91 or 0x92 */
+    float    quat[4];       /* w, x, y, z */
+    float    gyr[3];        /* rad/s */
+    float    acc[3];        /* m/s^2 */
+    float    temperature;   /* degC */
+    uint32_t system_time;   /* device time in ms, 0x91 only */
+} hipnuc_imu_t;
+
+typedef struct
+{
+    size_t   len;                               /* bytes of the pending partial frame */
+    uint8_t  buf[HIPNUC_SCAN_MAX_FRAME];
+    uint32_t frames;                            /* frames with a valid CRC */
+    uint32_t crc_errors;
+} hipnuc_scanner_t;
+
+typedef void (*hipnuc_scan_cbk_t)(void *ctx, const hipnuc_imu_t *imu);
+
+void hipnuc_scanner_init(hipnuc_scanner_t *s);
+
+/**
+ * @brief Decode a block of bytes from the serial stream
+ *
+ * @param s Scanner state
+ * @param data Received bytes
+ * @param len Number of received bytes
+ * @param cbk Called for every decoded 0x91 / 0x92 packet
+ * @param ctx Passed through to cbk
+ * @return int Number of packets decoded
+ */
+int hipnuc_scan(hipnuc_scanner_t *s, const uint8_t *data, size_t len, hipnuc_scan_cbk_t cbk, void *ctx);
+
+/* CRC16-CCITT (poly 0x1021), as used in the HiPNUC frame header */
+uint16_t hipnuc_scan_crc16(uint16_t crc, const uint8_t *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,108 @@
+#include "imu_filter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+constexpr float gravity = 9.80665f;
+
+void quat_normalize(float q[4]) {
+    float n = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    if (n < 1e-9f) {
+        q[0] = 1.f;
+        q[1] = q[2] = q[3] = 0.f;
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        q[i] /= n;
+    }
+}
+
+// q <- q * exp(0.5 * w * dt), w in the body frame
+void quat_integrate(float q[4], const float w[3], float dt) {
+    float hx = 0.5f * w[0] * dt, hy = 0.5f * w[1] * dt, hz = 0.5f * w[2] * dt;
+    float qw = q[0], qx = q[1], qy = q[2], qz = q[3];
+    q[0] = qw - qx * hx - qy * hy - qz * hz;
+    q[1] = qx + qw * hx + qy * hz - qz * hy;
+    q[2] = qy + qw * hy - qx * hz + qz * hx;
+    q[3] = qz + qw * hz + qx * hy - qy * hx;
+    quat_normalize(q);
+}
+
+}  // namespace
+
+ImuFilter::ImuFilter(const ImuFilterCfg& cfg) : cfg_(cfg) {
+    if (cfg_.gyro_alpha <= 0.f || cfg_.gyro_alpha > 1.f || cfg_.angle_alpha < 0.f || cfg_.angle_alpha > 1.f) {
+        throw std::runtime_error("IMU filter: gyro_alpha must be in (0, 1], angle_alpha in [0, 1]");
+    }
+}
+
+void ImuFilter::reset() {
+    initialized_ = false;
+    last_time_ns_ = 0;
+    still_since_ns_ = 0;
+    std::fill(gyro_bias_, gyro_bias_ + 3, 0.f);
+}
+
+void ImuFilter::update(const ImuSample& raw, ImuSample& out) {
+    out = raw;
+
+    float dt = 0.f;
+    if (initialized_ && raw.stamp_ns > last_time_ns_) {
+        dt = static_cast<float>(raw.stamp_ns - last_time_ns_) * 1e-9f;
+        if (dt > cfg_.max_dt) {
+            dt = 0.f;
+        }
+    }
+    last_time_ns_ = raw.stamp_ns;
+
+    float gyro[3];
+    for (int i = 0; i < 3; i++) {
+        gyro[i] = raw.gyro[i] - gyro_bias_[i];
+    }
+
+    if (cfg_.bias_estimation) {
+        float rate = std::sqrt(gyro[0] * gyro[0] + gyro[1] * gyro[1] + gyro[2] * gyro[2]);
+        float acc = std::sqrt(raw.acc[0] * raw.acc[0] + raw.acc[1] * raw.acc[1] + raw.acc[2] * raw.acc[2]);
+        if (rate < cfg_.still_gyro_threshold && std::fabs(acc - gravity) < cfg_.still_acc_threshold) {
+            if (still_since_ns_ == 0) {
+                still_since_ns_ = raw.stamp_ns;
+            } else if (raw.stamp_ns - still_since_ns_ >= static_cast<uint64_t>(cfg_.still_time * 1e9f)) {
+                for (int i = 0; i < 3; i++) {
+                    gyro_bias_[i] += cfg_.bias_gain * (raw.gyro[i] - gyro_bias_[i]);
+                    gyro[i] = raw.gyro[i] - gyro_bias_[i];
+                }
+            }
+        } else {
+            still_since_ns_ = 0;
+        }
+    }
+
+    if (!initialized_) {
+        std::copy(gyro, gyro + 3, gyro_);
+        std::copy(raw.quat, raw.quat + 4, quat_);
+        quat_normalize(quat_);
+        initialized_ = true;
+    } else {
+        for (int i = 0; i < 3; i++) {
+            gyro_[i] = cfg_.gyro_alpha * gyro[i] + (1.f - cfg_.gyro_alpha) * gyro_[i];
+        }
+        if (cfg_.angle_alpha >= 1.f) {
+            std::copy(raw.quat, raw.quat + 4, quat_);
+        } else {
+            // predict with the unfiltered rate, then pull towards the device attitude
+            quat_integrate(quat_, gyro, dt);
+            float dot = quat_[0] * raw.quat[0] + quat_[1] * raw.quat[1] + quat_[2] * raw.quat[2] + quat_[3] * raw.quat[3];
+            float sign = dot < 0.f ? -1.f : 1.f;
+            for (int i = 0; i < 4; i++) {
+                quat_[i] = (1.f - cfg_.angle_alpha) * quat_[i] + cfg_.angle_alpha * sign * raw.quat[i];
+            }
+        }
+        quat_normalize(quat_);
+    }
+
+    std::copy(gyro_, gyro_ + 3, out.gyro);
+    std::copy(quat_, quat_ + 4, out.quat);
+}
@@ -0,0 +1,26 @@
+#include "serial_baud.hpp"
+
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+bool serial_set_custom_baud(int fd, int baudrate) {
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio) != 0) {
+        return false;
+    }
+    tio.c_cflag &= ~CBAUD;
+    tio.c_cflag |= BOTHER;
+    tio.c_cflag &= ~(CBAUD << IBSHIFT);
+    tio.c_cflag |= BOTHER << IBSHIFT;
+    tio.c_ispeed = baudrate;
+    tio.c_ospeed = baudrate;
+    return ioctl(fd, TCSETS2, &tio) == 0;
+}
+
+int serial_get_actual_baud(int fd) {
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio) != 0) {
+        return -1;
+    }
+    return static_cast<int>(tio.c_ospeed);
+}
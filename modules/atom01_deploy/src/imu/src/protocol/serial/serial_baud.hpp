@@ -0,0 +1,12 @@
+#pragma once
+
+// termios2 helpers. Kept in their own translation unit because <asm/termbits.h>
+// redefines struct termios and cannot be included next to <termios.h>.
+
+// Set an arbitrary input/output baud rate with TCSETS2/BOTHER. Returns false and
+// leaves errno set if the driver rejects the rate.
+bool serial_set_custom_baud(int fd, int baudrate);
+
+// Baud rate the driver actually programmed (may differ from the request when the
+// adapter's divisor cannot hit it exactly), or -1 on error.
+int serial_get_actual_baud(int fd);
@@ -1,9 +1,10 @@
 #include "serial_port.hpp"
+#include "thread_topology.hpp"
 
 std::shared_ptr<spdlog::logger> SerialPort::logger_ = nullptr;
 
 SerialPort::SerialPort(const std::string& interface, int baudrate) 
-    : interface_(interface), baudrate_(baudrate), fd_(-1), running_(false) {
+    : interface_(interface), baudrate_(baudrate), fd_(-1), epoll_fd_(-1), event_fd_(-1), running_(false) {
     init();
 }
 
@@ -23,87 +24,149 @@ void SerialPort::init() {
         throw std::runtime_error("Failed to get serial attributes: " + interface_);
     }
 
-    bool configured = false;
-
-    if (!configured) {
-        speed_t speed;
-        switch (baudrate_) {
-            case 9600: speed = B9600; break;
-            case 19200: speed = B19200; break;
-            case 38400: speed = B38400; break;
-            case 57600: speed = B57600; break;
-            case 115200: speed = B115200; break;
-            case 230400: speed = B230400; break;
-            case 460800: speed = B460800; break;
-            case 921600: speed = B921600; break;
-            default: speed = B115200; break; 
-        }
+    bool custom_baud = false;
+    speed_t speed;
+    switch (baudrate_) {
+        case 9600: speed = B9600; break;
+        case 19200: speed = B19200; break;
+        case 38400: speed = B38400; break;
+        case 57600: speed = B57600; break;
+        case 115200: speed = B115200; break;
+        case 230400: speed = B230400; break;
+        case 460800: speed = B460800; break;
+        case 921600: speed = B921600; break;
+        case 1000000: speed = B1000000; break;
+        case 1500000: speed = B1500000; break;
+        case 2000000: speed = B2000000; break;
+        case 3000000: speed = B3000000; break;
+        case 4000000: speed = B4000000; break;
+        default: speed = B38400; custom_baud = true; break;
+    }
 
-        cfsetispeed(&tty, speed);
-        cfsetospeed(&tty, speed);
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
 
-        tty.c_cflag &= ~CSIZE;
-        tty.c_cflag |= CS8;
-        tty.c_cflag &= ~PARENB;
-        tty.c_cflag &= ~CSTOPB;
-        tty.c_cflag |= (CLOCAL | CREAD);
-        tty.c_cflag &= ~CRTSCTS;
+    tty.c_cflag &= ~CSIZE;
+    tty.c_cflag |= CS8;
+    tty.c_cflag &= ~PARENB;
+    tty.c_cflag &= ~CSTOPB;
+    tty.c_cflag |= (CLOCAL | CREAD);
+    tty.c_cflag &= ~CRTSCTS;
 
-        tty.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
-        tty.c_iflag &= ~(IXON | IXOFF | IXANY);
-        tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL);
-        tty.c_oflag &= ~OPOST;
+    tty.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
+    tty.c_iflag &= ~(IXON | IXOFF | IXANY);
+    tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL);
+    tty.c_oflag &= ~OPOST;
 
-        tty.c_cc[VMIN] = 0;
-        tty.c_cc[VTIME] = 1;
+    // fd is non-blocking and reads are driven by epoll, so no inter-byte timer in the tty layer
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+
+    if (tcsetattr(fd_, TCSANOW, &tty) != 0) {
+        if (logger_) logger_->error("Failed to set serial attributes: {}", interface_);
+        else std::cerr << "Failed to set serial attributes: " << interface_ << std::endl;
+        ::close(fd_);
+        throw std::runtime_error("Failed to set serial attributes: " + interface_);
+    }
 
-        if (tcsetattr(fd_, TCSANOW, &tty) != 0) {
-            if (logger_) logger_->error("Failed to set serial attributes: {}", interface_);
-            else std::cerr << "Failed to set serial attributes: " << interface_ << std::endl;
+    // rates outside the Bxxx table go through termios2/BOTHER instead of silently falling back
+    if (custom_baud) {
+        if (!serial_set_custom_baud(fd_, baudrate_)) {
+            if (logger_) logger_->error("Failed to set custom baudrate {} on {}: {}", baudrate_, interface_, strerror(errno));
+            else std::cerr << "Failed to set custom baudrate " << baudrate_ << " on " << interface_ << ": " << strerror(errno) << std::endl;
             ::close(fd_);
-            throw std::runtime_error("Failed to set serial attributes: " + interface_);
+            throw std::runtime_error("Failed to set custom baudrate on serial port: " + interface_);
+        }
+        int actual = serial_get_actual_baud(fd_);
+        if (logger_) logger_->info("Serial port {} custom baudrate {} (actual {})", interface_, baudrate_, actual);
+    }
+
+    // Ask the driver to push received bytes to the tty immediately instead of batching them
+    // (ftdi_sio drops its latency timer from 16 ms to 1 ms). Not every adapter supports it.
+    struct serial_struct ser;
+    if (ioctl(fd_, TIOCGSERIAL, &ser) == 0) {
+        ser.flags |= ASYNC_LOW_LATENCY;
+        if (ioctl(fd_, TIOCSSERIAL, &ser) != 0) {
+            if (logger_) logger_->warn("Failed to set ASYNC_LOW_LATENCY on {}: {}", interface_, strerror(errno));
         }
+    } else {
+        if (logger_) logger_->warn("{} does not support TIOCGSERIAL, low latency mode not set", interface_);
+    }
+
+    tcflush(fd_, TCIOFLUSH);
+
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (event_fd_ < 0 || epoll_fd_ < 0) {
+        if (logger_) logger_->error("Failed to create epoll for serial port: {}", interface_);
+        else std::cerr << "Failed to create epoll for serial port: " << interface_ << std::endl;
+        close_fds();
+        throw std::runtime_error("Failed to create epoll for serial port: " + interface_);
+    }
+    struct epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd_;
+    int ret_fd = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd_, &ev);
+    ev.data.fd = event_fd_;
+    int ret_ev = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &ev);
+    if (ret_fd != 0 || ret_ev != 0) {
+        if (logger_) logger_->error("Failed to register serial port with epoll: {}", interface_);
+        else std::cerr << "Failed to register serial port with epoll: " << interface_ << std::endl;
+        close_fds();
+        throw std::runtime_error("Failed to register serial port with epoll: " + interface_);
     }
 
     running_ = true;
     rx_thread_ = std::thread([this]() {
-        pthread_setname_np(pthread_self(), "serial_rx");
-        struct sched_param sp{}; sp.sched_priority = 80;
-        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) != 0) {
-            if (logger_) logger_->error("Failed to set realtime priority for IMU serial RX");
-            throw std::runtime_error("Failed to set realtime priority for IMU serial RX");
-        } 
+        try {
+            ThreadTopology::instance().apply("serial_rx", interface_);
+        } catch (const std::exception& e) {
+            if (logger_) logger_->error("{}", e.what());
+            throw;
+        }
         uint8_t buf[BUF_SIZE] = {0};
-        
+        struct epoll_event events[2];
+
+        // Block until bytes arrive or close() signals the eventfd, then drain the tty buffer.
         while (running_) {
-            fd_set readfds;
-            struct timeval tv;
-            
-            FD_ZERO(&readfds);
-            FD_SET(fd_, &readfds);
-            tv.tv_sec = 0;
-            tv.tv_usec = 1000;  // 1ms timeout
-
-            int ret = select(fd_ + 1, &readfds, NULL, NULL, &tv);
+            int ret = epoll_wait(epoll_fd_, events, 2, -1);
             if (ret < 0) {
                 if (errno == EINTR) continue;
-                if (logger_) logger_->error("select error: {}", strerror(errno));
-                else std::cerr << "select error: " << strerror(errno) << std::endl;
+                if (logger_) logger_->error("epoll_wait error: {}", strerror(errno));
+                else std::cerr << "epoll_wait error: " << strerror(errno) << std::endl;
                 break;
-            } else if (ret == 0) {
-                continue;  // timeout
             }
-            
-            int n = read(fd_, buf, BUF_SIZE);
-            if (n < 0) {
-                if (errno == EAGAIN || errno == EWOULDBLOCK) continue;
-                if (logger_) logger_->error("read error: {}", strerror(errno));
-                else std::cerr << "read error: " << strerror(errno) << std::endl;
-                break; 
-            } else if (n > 0) {
-                if (callback_) {
-                    callback_(buf, n);
+
+            bool readable = false;
+            for (int i = 0; i < ret; i++) {
+                if (events[i].data.fd == event_fd_) {
+                    return;
+                }
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    if (logger_) logger_->error("Serial port {} hung up", interface_);
+                    else std::cerr << "Serial port " << interface_ << " hung up" << std::endl;
+                    return;
                 }
+                readable = true;
+            }
+            if (!readable) continue;
+
+            for (;;) {
+                ssize_t n = read(fd_, buf, BUF_SIZE);
+                if (n > 0) {
+                    if (callback_) {
+                        callback_(buf, n);
+                    }
+                    if (n < BUF_SIZE) break;
+                    continue;
+                }
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                    if (logger_) logger_->error("read error: {}", strerror(errno));
+                    else std::cerr << "read error: " << strerror(errno) << std::endl;
+                    return;
+                }
+                break;
             }
         }
     });
@@ -119,9 +182,26 @@ std::shared_ptr<SerialPort> SerialPort::open(const std::string& interface, int b
 
 void SerialPort::close() {
     running_ = false;
+    if (event_fd_ >= 0) {
+        uint64_t one = 1;
+        ssize_t ret = ::write(event_fd_, &one, sizeof(one));
+        (void)ret;
+    }
     if (rx_thread_.joinable()) {
         rx_thread_.join();
     }
+    close_fds();
+}
+
+void SerialPort::close_fds() {
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+    if (event_fd_ >= 0) {
+        ::close(event_fd_);
+        event_fd_ = -1;
+    }
     if (fd_ >= 0) {
         ::close(fd_);
         fd_ = -1;
@@ -132,3 +212,23 @@ void SerialPort::set_serial_callback(SerialCbkFunc callback) {
     callback_ = callback;
 }
 
+
+void SerialPort::write(const uint8_t* data, size_t length) {
+    size_t sent = 0;
+    while (sent < length) {
+        ssize_t n = ::write(fd_, data + sent, length - sent);
+        if (n > 0) {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            if (logger_) logger_->error("write error: {}", strerror(errno));
+            else std::cerr << "write error: " << strerror(errno) << std::endl;
+            throw std::runtime_error("Failed to write serial port: " + interface_);
+        }
+        struct pollfd pfd{fd_, POLLOUT, 0};
+        if (poll(&pfd, 1, 100) == 0) {
+            throw std::runtime_error("Serial port write timeout: " + interface_);
+        }
+    }
+}
@@ -17,7 +17,12 @@
 #include <iostream>
 #include <cerrno>
 #include <termios.h>
+#include <poll.h>
 #include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/serial.h>
+#include "serial_baud.hpp"
 
 #define BUF_SIZE 1024
 
@@ -34,14 +39,19 @@ public:
     void init();
 
     void set_serial_callback(SerialCbkFunc callback);
+    void write(const uint8_t* data, size_t length);
+    void write(const std::string& data) { write(reinterpret_cast<const uint8_t*>(data.data()), data.size()); }
     void close();
 
 private:
     SerialPort(const std::string& interface, int baudrate);
+    void close_fds();
 
     std::string interface_;
     int baudrate_;
     int fd_;
+    int epoll_fd_;
+    int event_fd_;  // wakes the RX thread on close()
     std::atomic<bool> running_;
     std::thread rx_thread_;
     SerialCbkFunc callback_;
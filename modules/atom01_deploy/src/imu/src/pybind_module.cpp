@@ -1,5 +1,6 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include "can_bus_pybind.hpp"
 #include "imu_driver.hpp"
 
 namespace py = pybind11;
@@ -7,6 +8,27 @@ namespace py = pybind11;
 PYBIND11_MODULE(imu_py, m) {
     m.doc() = "IMU Driver Python SDK"; 
 
+    bind_can_bus(m);
+
+    py::class_<ImuDeviceCfg>(m, "ImuDeviceCfg")
+        .def(py::init<>())
+        .def_readwrite("rate_hz", &ImuDeviceCfg::rate_hz)
+        .def_readwrite("packet", &ImuDeviceCfg::packet)
+        .def_readwrite("filter_mode", &ImuDeviceCfg::filter_mode)
+        .def_readwrite("registers", &ImuDeviceCfg::registers)
+        .def_readwrite("can_protocol", &ImuDeviceCfg::can_protocol)
+        .def_readwrite("save", &ImuDeviceCfg::save);
+
+    py::class_<ClockSyncStats>(m, "ClockSyncStats")
+        .def(py::init<>())
+        .def_readonly("synced", &ClockSyncStats::synced)
+        .def_readonly("drift_ppm", &ClockSyncStats::drift_ppm)
+        .def_readonly("delay_ns", &ClockSyncStats::delay_ns)
+        .def_readonly("delay_mean_ns", &ClockSyncStats::delay_mean_ns)
+        .def_readonly("delay_peak_ns", &ClockSyncStats::delay_peak_ns)
+        .def_readonly("stalls", &ClockSyncStats::stalls)
+        .def_readonly("resets", &ClockSyncStats::resets);
+
     py::class_<IMUDriver, std::shared_ptr<IMUDriver>>(m, "IMUDriver")
         .def(py::init<>())
         .def_static("create_imu", &IMUDriver::create_imu, 
@@ -19,5 +41,7 @@ PYBIND11_MODULE(imu_py, m) {
         .def("get_ang_vel", &IMUDriver::get_ang_vel)
         .def("get_quat", &IMUDriver::get_quat)
         .def("get_lin_acc", &IMUDriver::get_lin_acc)
-        .def("get_temperature", &IMUDriver::get_temperature);
+        .def("get_temperature", &IMUDriver::get_temperature)
+        .def("get_clock_stats", &IMUDriver::get_clock_stats)
+        .def("configure", &IMUDriver::configure, py::arg("cfg"));
 }
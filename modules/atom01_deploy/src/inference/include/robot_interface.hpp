@@ -13,11 +13,16 @@
 #include <filesystem>
 #include <iostream>
 #include <queue>
+#include <map>
 #include <sstream>
 #include <yaml-cpp/yaml.h>
 #include "utils/close_chain_mapping.hpp"
+#include "utils/safety_supervisor.hpp"
 #include "utils/thread_pool.hpp"
+#include "utils/sample_history.hpp"
 #include "motor_driver.hpp"
+#include "motor_group.hpp"
+#include "socket_can.hpp"
 #include "imu_driver.hpp"
 
 class RobotInterface {
@@ -25,31 +30,63 @@ class RobotInterface {
     RobotInterface(const std::string& config_file);
     ~RobotInterface() {
         deinit_motors();
+        motor_groups_.clear();
         motors_.clear();
         imu_.reset();
     }
     struct IMUCfg{
         int imu_id_, baudrate_;
-        std::string imu_type_, imu_interface_type_, imu_interface_;
+        int imu_packet_ = 0, imu_rate_ = 0, imu_filter_mode_ = -1;
+        bool imu_save_config_ = false;
+        std::map<int, long int> imu_registers_;
+        std::string imu_type_, imu_interface_type_, imu_interface_, imu_can_protocol_;
     };
     struct MotorsCfg{
         int master_id_offset_;
         std::string motor_type_, motor_interface_type_;
         std::vector<std::string> motor_interface_;
         std::vector<long int> motor_id_, motor_model_, motor_num_;
+        bool can_auto_restart_ = true;
+        std::vector<long int> can_restart_backoff_ms_{10, 1000};  // first and maximum delay
+        int watchdog_timeout_ms_ = 50, watchdog_period_ms_ = 2;  // timeout 0 disables the watchdog
+        std::vector<double> watchdog_kd_;                         // damping per motor, robot kd when empty
+                                                                  // (also used by the safety supervisor)
     };
     struct RobotCfg{
         std::vector<long int> close_chain_motor_id_, motor_sign_;
         std::vector<double> kp_, kd_;
     };
+    // sensor age relative to the capture reference instant, accumulated since the last reset
+    struct SensorAgeStats{
+        uint64_t captures = 0, imu_missing = 0, joints_missing = 0;
+        double imu_age_mean_us = 0.0, imu_age_max_us = 0.0;
+        double joint_age_mean_us = 0.0, joint_age_max_us = 0.0;
+    };
+
+    static constexpr size_t imu_history_len = 64;
+    static constexpr size_t joint_history_len = 16;
+    static constexpr uint64_t imu_max_extrapolation_ns = 10000000;
 
-    void apply_action(std::vector<float> action);
+    // Also runs the safety supervisor on the feedback of this tick. Once it tripped the action is
+    // ignored and its response is sent instead; returns the latched level.
+    SafetyLevel apply_action(std::vector<float> action);
     void init_motors();
     void deinit_motors();
     void reset_joints(std::vector<double> joint_default_angle);
+    // Ends the stream of apply_action() commands: the motors keep the last command and the
+    // watchdog stays off until the next apply_action(). Call before pausing the caller.
+    void pause();
     void set_zeros();
     void clear_errors();
+    // Reads all motor registers into the driver caches, concurrently with control.
+    std::vector<MotorRegisterReport> read_motor_registers() { return read_all_registers(motors_); }
     void refresh_joints();
+    // joint_limits as [min, max] pairs in joint order (empty disables), gravity_z_upper 1 disables
+    void set_safety_limits(const std::vector<double>& joint_limits, float gravity_z_upper);
+    SafetyStatus get_safety_status() {
+        std::unique_lock<std::mutex> lock(joint_mutex_);
+        return safety_->status();
+    }
     std::vector<float> get_joint_q() {
         if (!is_init_.load()) {
             throw std::runtime_error("Motors not initialized");
@@ -84,24 +121,63 @@ class RobotInterface {
         return imu_->get_ang_vel();
     }
 
+    /**
+     * Samples all sensors at one reference instant t_ref_ns (CLOCK_MONOTONIC).
+     * The IMU is interpolated between the samples around t_ref_ns, or extrapolated from the newest
+     * one by at most imu_max_extrapolation_ns; joints use the newest feedback received at or before
+     * t_ref_ns. Outputs must be preallocated. Returns false if a sensor has not reported yet, its
+     * outputs are then left untouched and the observation must not be used. The close-chain joints
+     * are decoupled whenever all joints reported. Not thread safe, call from a single thread.
+     */
+    bool capture_observation(uint64_t t_ref_ns, std::vector<float>& quat, std::vector<float>& ang_vel,
+                             std::vector<float>& joint_q, std::vector<float>& joint_vel, std::vector<float>& joint_tau);
+    SensorAgeStats get_age_stats(bool reset = true);
+    void set_imu_filter(float gyro_alpha, float angle_alpha, bool bias_estimation);
+    ClockSyncStats get_imu_clock_stats();
+    // SocketCAN interfaces used by the motors and the IMU, for SocketCAN::get(...)->get_bus_stats()
+    const std::vector<std::string>& get_can_interfaces() const { return can_interfaces_; }
+
     std::atomic<bool> is_init_{false};
 
    private:
     std::shared_ptr<IMUCfg> imu_cfg_;
     std::shared_ptr<MotorsCfg> motors_cfg_;
     std::shared_ptr<RobotCfg> robot_cfg_;
-    int offline_threshold_ = 25;
     std::shared_ptr<IMUDriver> imu_;
     std::shared_ptr<Decouple> ankle_decouple_;
     std::vector<std::shared_ptr<MotorDriver>> motors_;
+    std::vector<std::unique_ptr<MotorGroup>> motor_groups_;  // one per interface, motors in config order
+    std::vector<size_t> group_offset_;                        // index of the first motor of each group
+    std::vector<MotorGroupState> group_states_;
+    std::vector<float> cmd_q_, cmd_dq_, cmd_kp_, cmd_kd_, cmd_tau_;  // MIT commands by motor index
+    bool watchdog_armed_ = false;                                     // under motors_mutex_
+    std::vector<std::string> can_interfaces_;
     std::unique_ptr<ThreadPool> thread_pool_;
 
     std::mutex motors_mutex_, joint_mutex_;
     std::vector<float> joint_q_, joint_vel_, joint_tau_;
     std::vector<int> close_chain_motor_idx_;
+    // safety supervisor input and state, under joint_mutex_
+    std::unique_ptr<SafetySupervisor> safety_;
+    std::vector<float> motor_temperature_, hold_q_;
+    std::vector<uint8_t> motor_error_;
+    std::vector<uint64_t> motor_rx_ns_;
+    SafetyLevel safety_applied_ = SafetyLevel::OK;  // response the commands are built for
+
+    std::unique_ptr<SampleHistory<ImuSample, imu_history_len>> imu_history_;
+    std::vector<std::unique_ptr<SampleHistory<MotorFeedback, joint_history_len>>> joint_history_;
+    SensorAgeStats age_stats_;
+    double imu_age_sum_us_ = 0.0, joint_age_sum_us_ = 0.0;
+    Eigen::VectorXd cc_q_ = Eigen::VectorXd::Zero(2), cc_vel_ = Eigen::VectorXd::Zero(2), cc_tau_ = Eigen::VectorXd::Zero(2);
 
     void setup_motors();
     void setup_imu();
+    void send_motor_commands();
+    void arm_watchdogs();
+    void disarm_watchdogs();
+    void reset_safety();
+    void power_down();
+    std::vector<MotorOpResult> run_motor_steps(std::vector<MotorStep> (MotorDriver::*steps)());
 
     void exec_motors_parallel(std::function<void(std::shared_ptr<MotorDriver>&, int)> cmd_func);
 };
\ No newline at end of file
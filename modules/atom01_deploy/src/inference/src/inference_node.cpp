@@ -1,5 +1,19 @@
 #include "inference_node.hpp"
 
+OrtCustomThreadHandle InferenceNode::create_ort_thread(void*, OrtThreadWorkerFn fn, void* param) {
+    auto* thread = new std::thread([fn, param]() {
+        ThreadTopology::instance().apply("ort");
+        fn(param);
+    });
+    return reinterpret_cast<OrtCustomThreadHandle>(thread);
+}
+
+void InferenceNode::join_ort_thread(OrtCustomThreadHandle handle) {
+    auto* thread = reinterpret_cast<std::thread*>(const_cast<OrtCustomHandleType*>(handle));
+    thread->join();
+    delete thread;
+}
+
 void InferenceNode::setup_model(std::unique_ptr<ModelContext>& ctx, std::string model_path, int input_size){
     if (!ctx) {
         ctx = std::make_unique<ModelContext>();
@@ -52,10 +66,19 @@ void InferenceNode::setup_model(std::unique_ptr<ModelContext>& ctx, std::string
         
     ctx->output_tensor = std::make_unique<Ort::Value>(Ort::Value::CreateTensor<float>(
         *ctx->memory_info, ctx->output_buffer.data(), ctx->output_buffer.size(), ctx->output_shape.data(), ctx->output_shape.size()));
+
+    // grow the ORT arena and record the memory pattern (from the second run on) before the
+    // inference thread runs the model
+    for (int i = 0; i < 2; i++) {
+        ctx->session->Run(Ort::RunOptions{nullptr},
+            ctx->input_names_raw.data(), ctx->input_tensor.get(), ctx->num_inputs,
+            ctx->output_names_raw.data(), ctx->output_tensor.get(), ctx->num_outputs);
+    }
+    std::fill(ctx->output_buffer.begin(), ctx->output_buffer.end(), 0.0f);
 }
 
 void InferenceNode::reset() {
-    is_running_.store(false);
+    pause_inference();
     std::fill(obs_.begin(), obs_.end(), 0.0f);
     std::fill(joint_pos_.begin(), joint_pos_.end(), 0.0f);
     std::fill(joint_vel_.begin(), joint_vel_.end(), 0.0f);
@@ -70,6 +93,10 @@ void InferenceNode::reset() {
     }
     std::fill(act_.begin(), act_.end(), 0.0f);
     std::fill(last_act_.begin(), last_act_.end(), 0.0f);
+    std::fill(interp_act_.begin(), interp_act_.end(), 0.0f);
+    if (act_interp_) {
+        act_interp_->reset();
+    }
     std::fill(joint_torques_.begin(), joint_torques_.end(), 0.0f);
     is_first_frame_ = true;
     motion_frame_ = 0;
@@ -83,27 +110,51 @@ void InferenceNode::reset() {
     }
 }
 
+// PD tick. After a safety stop it keeps running so that the supervisor response is sent every
+// tick, the action is ignored then.
 void InferenceNode::apply_action() {
-    if(!is_running_.load() || !robot_->is_init_.load()){
+    std::unique_lock<std::mutex> lock(act_mutex_);
+    bool running = is_running_.load();
+    if((!running && !safety_stop_.load()) || !robot_->is_init_.load()){
         return;
     }
-    {
-        std::unique_lock<std::mutex> lock(act_mutex_);
-        for (size_t i = 0; i < act_.size(); i++) {
-            act_[i] = act_alpha_ * act_[i] + (1 - act_alpha_) * last_act_[i];
+    if (running) {
+        act_interp_->evaluate(std::chrono::steady_clock::now(), interp_act_);
+        for (size_t i = 0; i < interp_act_.size(); i++) {
+            interp_act_[i] = act_alpha_ * interp_act_[i] + (1 - act_alpha_) * last_act_[i];
         }
-        last_act_ = act_;
-        robot_->apply_action(act_);
+        std::copy(interp_act_.begin(), interp_act_.end(), last_act_.begin());
+    }
+    SafetyLevel level = robot_->apply_action(interp_act_);
+    if (level != SafetyLevel::OK && !safety_stop_.load()) {
+        safety_stop_.store(true);
+        is_running_.store(false);
+        RCLCPP_ERROR(this->get_logger(), "Safety stop: %s, inference paused. Reset the joints or re-initialize the motors to resume",
+                     SafetySupervisor::describe(robot_->get_safety_status().event).c_str());
     }
 }
 
+// Before the robot leaves the safety response, so that no PD tick sends a stale action meanwhile.
+void InferenceNode::clear_safety_stop() {
+    std::unique_lock<std::mutex> lock(act_mutex_);
+    safety_stop_.store(false);
+}
+
+// Every path that stops inference goes through here, so that the PD tick is not mid-way through
+// apply_action() and the CAN watchdog does not take the pause for a stalled policy.
+void InferenceNode::pause_inference() {
+    std::unique_lock<std::mutex> lock(act_mutex_);
+    is_running_.store(false);
+    robot_->pause();
+}
+
 void InferenceNode::inference() {
-    pthread_setname_np(pthread_self(), "inference");
-    struct sched_param sp{}; sp.sched_priority = 70;
-    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) != 0) {
-        throw std::runtime_error("Failed to set realtime priority for inference thread");
-    }
+    ThreadTopology::instance().apply("inference");
     auto period = std::chrono::microseconds(static_cast<long long>(dt_ * 1000 * 1000 * decimation_));
+    // report sensor ages about every 5 seconds
+    const int age_log_steps = std::max(1, static_cast<int>(5.0f / (dt_ * decimation_)));
+    int age_log_count = 0;
+    bool clock_unsynced_logged = false;
 
     while(rclcpp::ok()){
         auto loop_start = std::chrono::steady_clock::now();
@@ -112,6 +163,33 @@ void InferenceNode::inference() {
             continue;
         }
 
+        // all sensors are sampled at the same instant, the start of this policy step
+        bool complete = robot_->capture_observation(monotonic_ns(), quat_, ang_vel_, joint_pos_, joint_vel_, joint_torques_);
+        if (++age_log_count >= age_log_steps) {
+            age_log_count = 0;
+            auto stats = robot_->get_age_stats();
+            RCLCPP_INFO(this->get_logger(), "Sensor age [us] imu mean %.0f max %.0f, joints mean %.0f max %.0f, missing imu %lu joints %lu of %lu",
+                        stats.imu_age_mean_us, stats.imu_age_max_us, stats.joint_age_mean_us, stats.joint_age_max_us,
+                        stats.imu_missing, stats.joints_missing, stats.captures);
+            auto clock = robot_->get_imu_clock_stats();
+            if (clock.synced) {
+                RCLCPP_INFO(this->get_logger(), "IMU clock drift %.1f ppm, delay [us] last %.0f mean %.0f peak %.0f, stalls %u, resets %u",
+                            clock.drift_ppm, clock.delay_ns * 1e-3, clock.delay_mean_ns * 1e-3, clock.delay_peak_ns * 1e-3,
+                            clock.stalls, clock.resets);
+            } else if (!clock_unsynced_logged) {
+                clock_unsynced_logged = true;
+                RCLCPP_WARN(this->get_logger(), "IMU clock not synchronized, the IMU sends no device time (HI92 packet?), "
+                            "samples are stamped with the mean transport delay");
+            }
+        }
+        // a sensor has not reported yet: skip the step, the PD loop keeps following the last action
+        if (!complete) {
+            RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 1000,
+                                 "Observation incomplete, IMU or joints have not reported yet, policy step skipped");
+            std::this_thread::sleep_until(loop_start + period);
+            continue;
+        }
+
         int offset = 0;
 
         if(is_beyondmimic_.load()){
@@ -128,7 +206,6 @@ void InferenceNode::inference() {
             offset += joint_num_ * 2;
         }
 
-        read_imu();
         for (int i = 0; i < 3; i++) {
             obs_[i + offset] = ang_vel_[i] * obs_scales_ang_vel_;
         }
@@ -137,11 +214,6 @@ void InferenceNode::inference() {
         Eigen::Vector3f gravity_w(0.0f, 0.0f, -1.0f);
         Eigen::Quaternionf q_w2b = q_b2w.inverse();
         Eigen::Vector3f gravity_b = q_w2b * gravity_w;
-        if (gravity_b.z() > gravity_z_upper_){
-            RCLCPP_FATAL(this->get_logger(), "Robot fell down! Shutting down...");
-            rclcpp::shutdown();
-            return;
-        }
         obs_[0 + offset] = gravity_b.x() * obs_scales_gravity_b_;
         obs_[1 + offset] = gravity_b.y() * obs_scales_gravity_b_;
         obs_[2 + offset] = gravity_b.z() * obs_scales_gravity_b_;
@@ -156,18 +228,10 @@ void InferenceNode::inference() {
             offset += 3;
         }
 
-        read_joints();
         for (int i = 0; i < joint_num_; i++) {
             obs_[offset + i] = (joint_pos_[usd2urdf_[i]] - joint_default_angle_[usd2urdf_[i]]) * obs_scales_dof_pos_;
             obs_[offset + joint_num_ + i] = joint_vel_[usd2urdf_[i]] * obs_scales_dof_vel_;
         }
-        for(size_t i = 0; i < joint_limits_.size() / 2; i++){
-            if(joint_pos_[i] < joint_limits_[i * 2] || joint_pos_[i] > joint_limits_[i * 2 + 1]){
-                RCLCPP_FATAL(this->get_logger(), "Joint %ld out of limit! Shutting down...", i+1);
-                rclcpp::shutdown();
-                return;
-            }
-        }
         offset += joint_num_ * 2;
         publish_joint_states();
 
@@ -223,6 +287,7 @@ void InferenceNode::inference() {
                     act_[14 + i] = interrupt_action_[i];
                 }
             }
+            act_interp_->push(act_, std::chrono::steady_clock::now());
             publish_action();
         }
 
@@ -241,11 +306,8 @@ void InferenceNode::inference() {
 }
 
 int main(int argc, char **argv) {
+    // main stays SCHED_OTHER while rclcpp creates its DDS threads, they inherit the scheduling
     pthread_setname_np(pthread_self(), "main");
-    struct sched_param sp{}; sp.sched_priority = 70;
-    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) != 0) {
-        throw std::runtime_error("Failed to set realtime priority for main thread");
-    }
     rclcpp::init(argc, argv);
     try {
         auto node = std::make_shared<InferenceNode>();
@@ -255,6 +317,8 @@ int main(int argc, char **argv) {
         RCLCPP_INFO(node->get_logger(), "Press 'X' to reset motors");
         RCLCPP_INFO(node->get_logger(), "Press 'B' to start/pause inference");
         RCLCPP_INFO(node->get_logger(), "Press 'Y' to switch between joystick and /cmd_vel control");
+        // the executor threads (PD timer) are spawned by spin() and inherit the "executor" spec
+        ThreadTopology::instance().apply("executor");
         executor.spin();
     } catch (const std::exception &e) {
         RCLCPP_FATAL(rclcpp::get_logger("main"), "Exception caught: %s", e.what());
@@ -21,7 +21,9 @@
 #include <sensor_msgs/msg/joy.hpp>
 #include <geometry_msgs/msg/twist.hpp>
 #include <std_msgs/msg/float32_multi_array.hpp> 
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
 #include "utils/motion_loader.hpp"
+#include "utils/action_interpolator.hpp"
 #include <std_srvs/srv/trigger.hpp>
 #include "robot_interface.hpp"
 
@@ -31,11 +33,16 @@ class InferenceNode : public rclcpp::Node {
         load_config();
 
         robot_ = std::make_shared<RobotInterface>(std::string(ROOT_DIR) + "config/robot.yaml");
+        robot_->set_imu_filter(gyro_alpha_, angle_alpha_, gyro_bias_estimation_);
+        robot_->set_safety_limits(joint_limits_, gravity_z_upper_);
 
         Ort::ThreadingOptions thread_opts;
         if (intra_threads_ > 0) {
             thread_opts.SetGlobalIntraOpNumThreads(intra_threads_);
         }
+        // intra-op workers get the "ort" thread spec instead of inheriting it from this thread
+        thread_opts.SetGlobalCustomCreateThreadFn(create_ort_thread);
+        thread_opts.SetGlobalCustomJoinThreadFn(join_ort_thread);
         env_ = std::make_unique<Ort::Env>(thread_opts, ORT_LOGGING_LEVEL_WARNING, "ONNXRuntimeInference");
         if(use_attn_enc_){
             setup_model(normal_ctx_, model_path_, obs_num_ * frame_stack_ + perception_obs_num_);
@@ -66,6 +73,8 @@ class InferenceNode : public rclcpp::Node {
         ang_vel_ = std::vector<float>(3, 0.0);
         act_ = std::vector<float>(joint_num_, 0.0);
         last_act_ = std::vector<float>(joint_num_, 0.0);
+        interp_act_ = std::vector<float>(joint_num_, 0.0);
+        act_interp_ = std::make_unique<ActionInterpolator>(joint_num_, ActionInterpolator::parse_mode(action_interp_), dt_ * decimation_);
         joint_torques_ = std::vector<float>(joint_num_, 0.0);
         if (use_interrupt_){
             interrupt_action_ = std::vector<float>(10, 0.0);
@@ -94,9 +103,12 @@ class InferenceNode : public rclcpp::Node {
             this->create_publisher<sensor_msgs::msg::Imu>("/imu", control_command_qos);
         joint_state_publisher_ =
             this->create_publisher<sensor_msgs::msg::JointState>("/joint_states", control_command_qos);
+        diagnostics_publisher_ =
+            this->create_publisher<diagnostic_msgs::msg::DiagnosticArray>("/diagnostics", 10);
         inference_thread_ = std::thread(&InferenceNode::inference, this);
-        timer_pub_ = this->create_wall_timer(std::chrono::milliseconds((int)(dt_ * 1000)),
+        timer_pub_ = this->create_wall_timer(std::chrono::microseconds((int)(dt_ * 1000 * 1000)),
                                              std::bind(&InferenceNode::apply_action, this));
+        timer_diag_ = this->create_wall_timer(std::chrono::seconds(1), std::bind(&InferenceNode::publish_diagnostics, this));
 
         reset_joints_service_ = this->create_service<std_srvs::srv::Trigger>(
             "reset_joints", std::bind(&InferenceNode::reset_joints_srv, this, std::placeholders::_1, std::placeholders::_2));
@@ -148,11 +160,16 @@ class InferenceNode : public rclcpp::Node {
     std::shared_ptr<RobotInterface> robot_;
     int offline_threshold_ = 10;
     std::atomic<bool> is_running_{false}, is_joy_control_{true}, is_interrupt_{false}, is_beyondmimic_{false};
+    std::atomic<bool> safety_stop_{false};  // set by the PD timer when the supervisor trips, changed under act_mutex_
+    std::string action_interp_;
+    std::unique_ptr<ActionInterpolator> act_interp_;
     std::string model_name_, model_path_, motion_name_, motion_path_, motion_model_name_, motion_model_path_, perception_obs_topic_;
-    bool use_interrupt_, use_beyondmimic_, use_attn_enc_;
+    bool use_interrupt_, use_beyondmimic_, use_attn_enc_, gyro_bias_estimation_;
     int obs_num_, motion_obs_num_, perception_obs_num_, frame_stack_, motion_frame_stack_, joint_num_;
     int decimation_;
     std::unique_ptr<Ort::Env> env_;
+    static OrtCustomThreadHandle create_ort_thread(void* options, OrtThreadWorkerFn fn, void* param);
+    static void join_ort_thread(OrtCustomThreadHandle handle);
     int intra_threads_;
     Ort::AllocatorWithDefaultOptions allocator_;
     rclcpp::Subscription<sensor_msgs::msg::Joy>::SharedPtr joy_subscription_;
@@ -162,7 +179,10 @@ class InferenceNode : public rclcpp::Node {
     rclcpp::Publisher<sensor_msgs::msg::JointState>::SharedPtr action_publisher_;
     rclcpp::Publisher<sensor_msgs::msg::Imu>::SharedPtr imu_publisher_;
     rclcpp::Publisher<sensor_msgs::msg::JointState>::SharedPtr joint_state_publisher_;
-    rclcpp::TimerBase::SharedPtr timer_pub_;
+    rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnostics_publisher_;
+    bool thread_layout_logged_ = false;  // the thread layout is logged with the first diagnostics
+    std::map<pid_t, uint64_t> thread_faults_;  // page faults of the real-time threads at the last diagnostics
+    rclcpp::TimerBase::SharedPtr timer_pub_, timer_diag_;
     std::thread inference_thread_;
     float act_alpha_, gyro_alpha_, angle_alpha_;
     float dt_;
@@ -182,7 +202,7 @@ class InferenceNode : public rclcpp::Node {
     rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr reset_joints_service_, set_zeros_service_, clear_errors_service_, refresh_joints_service_, read_joints_service_, read_imu_service_, init_motors_service_, deinit_motors_service_, start_inference_service_, stop_inference_service_;
 
     std::mutex act_mutex_, perception_mutex_, interrupt_mutex_, cmd_mutex_;
-    std::vector<float> obs_, act_, last_act_, perception_obs_, motion_pos_, motion_vel_, joint_pos_, joint_vel_, cmd_vel_, quat_, ang_vel_, interrupt_action_, joint_torques_;
+    std::vector<float> obs_, act_, last_act_, interp_act_, perception_obs_, motion_pos_, motion_vel_, joint_pos_, joint_vel_, cmd_vel_, quat_, ang_vel_, interrupt_action_, joint_torques_;
 
     void subs_joy_callback(const std::shared_ptr<sensor_msgs::msg::Joy> msg);
     void subs_cmd_callback(const std::shared_ptr<geometry_msgs::msg::Twist> msg);
@@ -190,6 +210,8 @@ class InferenceNode : public rclcpp::Node {
     void subs_joint_state_callback(const std::shared_ptr<sensor_msgs::msg::JointState> msg);
     void inference();
     void apply_action();
+    void clear_safety_stop();
+    void pause_inference();
     void read_joints() {
         joint_pos_ = robot_->get_joint_q();
         joint_vel_ = robot_->get_joint_vel();
@@ -225,6 +247,7 @@ class InferenceNode : public rclcpp::Node {
     void publish_joint_states();
     void publish_action();
     void publish_imu();
+    void publish_diagnostics();
     
     template <typename T>
     void print_vector(const std::string& name, const std::vector<T>& vec) {
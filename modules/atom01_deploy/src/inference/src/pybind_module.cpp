@@ -1,24 +1,58 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include "can_bus_pybind.hpp"
 #include "robot_interface.hpp"
 
 namespace py = pybind11;
 
 PYBIND11_MODULE(robot_py, m) {
+    bind_can_bus(m);
+
+    py::enum_<SafetyLevel>(m, "SafetyLevel")
+        .value("OK", SafetyLevel::OK)
+        .value("DAMP", SafetyLevel::DAMP)
+        .value("HOLD", SafetyLevel::HOLD)
+        .value("POWER_DOWN", SafetyLevel::POWER_DOWN);
+
     py::class_<RobotInterface>(m, "RobotInterface")
         .def(py::init<const std::string&>(), py::arg("config_file"))
         .def("apply_action", &RobotInterface::apply_action, py::arg("action"))
         .def("init_motors", &RobotInterface::init_motors)
         .def("deinit_motors", &RobotInterface::deinit_motors)
         .def("reset_joints", &RobotInterface::reset_joints, py::arg("joint_default_angle"))
+        .def("pause", &RobotInterface::pause)
         .def("set_zeros", &RobotInterface::set_zeros)
         .def("clear_errors", &RobotInterface::clear_errors)
         .def("refresh_joints", &RobotInterface::refresh_joints)
+        .def("set_safety_limits", &RobotInterface::set_safety_limits, py::arg("joint_limits"), py::arg("gravity_z_upper"))
+        .def("get_safety_status", [](RobotInterface &r) {
+            SafetyStatus status = r.get_safety_status();
+            py::dict entry;
+            entry["level"] = status.level;
+            entry["cause"] = SafetySupervisor::describe(status.event);
+            entry["ticks"] = status.ticks;
+            entry["trips"] = status.trips;
+            return entry;
+        })
+        .def("read_motor_registers", [](RobotInterface &r) {
+            py::list reports;
+            for (const MotorRegisterReport &report : r.read_motor_registers()) {
+                py::dict entry;
+                entry["interface"] = report.interface;
+                entry["motor_id"] = report.motor_id;
+                entry["values"] = report.values;
+                entry["missing"] = report.missing;
+                entry["elapsed_ms"] = report.elapsed_ms;
+                reports.append(entry);
+            }
+            return reports;
+        })
         .def("get_joint_q", &RobotInterface::get_joint_q)
         .def("get_joint_vel", &RobotInterface::get_joint_vel)
         .def("get_joint_tau", &RobotInterface::get_joint_tau)
         .def("get_quat", &RobotInterface::get_quat)
         .def("get_ang_vel", &RobotInterface::get_ang_vel)
+        .def("get_can_interfaces", &RobotInterface::get_can_interfaces)
         .def_property_readonly("is_init", [](const RobotInterface &r) {
             return r.is_init_.load();
         });
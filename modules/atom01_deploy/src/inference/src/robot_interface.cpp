@@ -3,6 +3,45 @@
 RobotInterface::RobotInterface(const std::string& config_file) {
     YAML::Node config = YAML::LoadFile(config_file);
 
+    // before any thread is started, every thread applies its spec when it starts
+    if (config["threads"]) {
+        auto& topology = ThreadTopology::instance();
+        std::map<std::string, ThreadSpec> specs;
+        for (const auto& entry : config["threads"]) {
+            std::string name = entry.first.as<std::string>();
+            YAML::Node thread_node = entry.second;
+            // "can_rx.can2" starts from the spec of can_rx
+            size_t dot = name.find('.');
+            ThreadSpec spec = dot == std::string::npos ? topology.spec(name)
+                                                       : topology.spec(name.substr(0, dot), name.substr(dot + 1));
+            if (thread_node["policy"]) spec.policy = ThreadTopology::parse_policy(thread_node["policy"].as<std::string>());
+            if (thread_node["priority"]) spec.priority = thread_node["priority"].as<int>();
+            if (thread_node["cpus"]) {
+                YAML::Node cpus_node = thread_node["cpus"];
+                if (cpus_node.IsSequence()) {
+                    spec.cpus = cpus_node.as<std::vector<int>>();
+                } else {
+                    spec.cpus = topology.parse_cpus(cpus_node.as<std::string>());
+                }
+            }
+            if (thread_node["spread"]) spec.spread = thread_node["spread"].as<bool>();
+            if (spec.policy == SCHED_OTHER) spec.priority = 0;
+            specs[name] = spec;
+        }
+        topology.configure(specs);
+    }
+
+    // locked and prefaulted before the CAN, IMU and thread pool threads start
+    RtMemoryCfg memory_cfg;
+    if (config["memory"]) {
+        YAML::Node memory_node = config["memory"];
+        if (memory_node["lock"]) memory_cfg.lock = memory_node["lock"].as<bool>();
+        if (memory_node["tune_malloc"]) memory_cfg.tune_malloc = memory_node["tune_malloc"].as<bool>();
+        if (memory_node["heap_reserve_mb"]) memory_cfg.heap_reserve_mb = memory_node["heap_reserve_mb"].as<size_t>();
+        if (memory_node["stack_prefault_kb"]) memory_cfg.stack_prefault_kb = memory_node["stack_prefault_kb"].as<size_t>();
+    }
+    init_rt_memory(memory_cfg);
+
     imu_cfg_ = std::make_shared<IMUCfg>();
     if (config["imu"]) {
         YAML::Node imu_node = config["imu"];
@@ -11,6 +50,12 @@ RobotInterface::RobotInterface(const std::string& config_file) {
         if (imu_node["imu_type"]) imu_cfg_->imu_type_ = imu_node["imu_type"].as<std::string>();
         if (imu_node["imu_interface_type"]) imu_cfg_->imu_interface_type_ = imu_node["imu_interface_type"].as<std::string>();
         if (imu_node["imu_interface"]) imu_cfg_->imu_interface_ = imu_node["imu_interface"].as<std::string>();
+        if (imu_node["imu_packet"]) imu_cfg_->imu_packet_ = imu_node["imu_packet"].as<int>();
+        if (imu_node["imu_rate"]) imu_cfg_->imu_rate_ = imu_node["imu_rate"].as<int>();
+        if (imu_node["imu_filter_mode"]) imu_cfg_->imu_filter_mode_ = imu_node["imu_filter_mode"].as<int>();
+        if (imu_node["imu_save_config"]) imu_cfg_->imu_save_config_ = imu_node["imu_save_config"].as<bool>();
+        if (imu_node["imu_registers"]) imu_cfg_->imu_registers_ = imu_node["imu_registers"].as<std::map<int, long int>>();
+        if (imu_node["imu_can_protocol"]) imu_cfg_->imu_can_protocol_ = imu_node["imu_can_protocol"].as<std::string>();
         setup_imu();
     }
 
@@ -24,6 +69,11 @@ RobotInterface::RobotInterface(const std::string& config_file) {
         if (motors_node["motor_id"]) motors_cfg_->motor_id_ = motors_node["motor_id"].as<std::vector<long int>>();
         if (motors_node["motor_model"]) motors_cfg_->motor_model_ = motors_node["motor_model"].as<std::vector<long int>>();
         if (motors_node["motor_num"]) motors_cfg_->motor_num_ = motors_node["motor_num"].as<std::vector<long int>>();
+        if (motors_node["can_auto_restart"]) motors_cfg_->can_auto_restart_ = motors_node["can_auto_restart"].as<bool>();
+        if (motors_node["can_restart_backoff_ms"]) motors_cfg_->can_restart_backoff_ms_ = motors_node["can_restart_backoff_ms"].as<std::vector<long int>>();
+        if (motors_node["watchdog_timeout_ms"]) motors_cfg_->watchdog_timeout_ms_ = motors_node["watchdog_timeout_ms"].as<int>();
+        if (motors_node["watchdog_period_ms"]) motors_cfg_->watchdog_period_ms_ = motors_node["watchdog_period_ms"].as<int>();
+        if (motors_node["watchdog_kd"]) motors_cfg_->watchdog_kd_ = motors_node["watchdog_kd"].as<std::vector<double>>();
         setup_motors();
     } else {
         throw std::runtime_error("Motors configuration not found in " + config_file);
@@ -45,6 +95,38 @@ RobotInterface::RobotInterface(const std::string& config_file) {
     } else {
         throw std::runtime_error("Robot configuration not found in " + config_file);
     }
+    if (motors_cfg_->watchdog_kd_.empty()) {
+        motors_cfg_->watchdog_kd_ = robot_cfg_->kd_;
+    }
+    if (motors_cfg_->watchdog_timeout_ms_ > 0 &&
+        (motors_cfg_->watchdog_period_ms_ <= 0 || motors_cfg_->watchdog_kd_.size() != motors_.size())) {
+        throw std::runtime_error("watchdog_period_ms must be positive and watchdog_kd (or robot kd) must have one value per motor");
+    }
+
+    safety_ = std::make_unique<SafetySupervisor>(motors_.size());
+    if (config["safety"]) {
+        YAML::Node safety_node = config["safety"];
+        SafetyCfg cfg = safety_->get_cfg();
+        // one value per joint, or one for all joints
+        auto per_joint = [this](const YAML::Node& node) {
+            return node.IsSequence() ? node.as<std::vector<float>>() : std::vector<float>(motors_.size(), node.as<float>());
+        };
+        if (safety_node["max_joint_vel"]) cfg.max_vel = per_joint(safety_node["max_joint_vel"]);
+        if (safety_node["max_joint_tau"]) cfg.max_tau = per_joint(safety_node["max_joint_tau"]);
+        if (safety_node["max_temperature"]) cfg.max_temperature = safety_node["max_temperature"].as<float>();
+        if (safety_node["stale_ms"]) cfg.stale_ms = safety_node["stale_ms"].as<uint32_t>();
+        if (safety_node["response"]) {
+            for (const auto& entry : safety_node["response"]) {
+                cfg.response[SafetySupervisor::parse_check(entry.first.as<std::string>())] =
+                    SafetySupervisor::parse_level(entry.second.as<std::string>());
+            }
+        }
+        safety_->configure(cfg);
+    }
+    motor_temperature_.assign(motors_.size(), 0.0f);
+    motor_error_.assign(motors_.size(), 0);
+    motor_rx_ns_.assign(motors_.size(), 0);
+    hold_q_.assign(motors_.size(), 0.0f);
 
     thread_pool_ = std::make_unique<ThreadPool>(motors_cfg_->motor_interface_.size());
 
@@ -56,6 +138,21 @@ RobotInterface::RobotInterface(const std::string& config_file) {
 }
 
 void RobotInterface::setup_motors(){
+    if (motors_cfg_->motor_interface_type_ == "can") {
+        if (motors_cfg_->can_restart_backoff_ms_.size() != 2) {
+            throw std::runtime_error("can_restart_backoff_ms must be [first, maximum]");
+        }
+        CanRestartCfg restart_cfg;
+        restart_cfg.enabled = motors_cfg_->can_auto_restart_;
+        restart_cfg.backoff_min_ms = static_cast<int>(motors_cfg_->can_restart_backoff_ms_[0]);
+        restart_cfg.backoff_max_ms = static_cast<int>(motors_cfg_->can_restart_backoff_ms_[1]);
+        for (const auto& interface : motors_cfg_->motor_interface_) {
+            SocketCAN::get(interface)->set_restart_cfg(restart_cfg);
+            if (std::find(can_interfaces_.begin(), can_interfaces_.end(), interface) == can_interfaces_.end()) {
+                can_interfaces_.push_back(interface);
+            }
+        }
+    }
     size_t count = 0;
     motors_.resize(motors_cfg_->motor_id_.size());
     for (size_t i = 0; i < motors_cfg_->motor_interface_.size(); ++i){
@@ -63,29 +160,94 @@ void RobotInterface::setup_motors(){
             motors_[count] = MotorDriver::create_motor(motors_cfg_->motor_id_[count], motors_cfg_->motor_interface_type_, motors_cfg_->motor_interface_[i], motors_cfg_->motor_type_, motors_cfg_->motor_model_[count], motors_cfg_->master_id_offset_);
             count += 1;
         }
+        size_t offset = count - motors_cfg_->motor_num_[i];
+        motor_groups_.push_back(std::make_unique<MotorGroup>(
+            std::vector<std::shared_ptr<MotorDriver>>(motors_.begin() + offset, motors_.begin() + count)));
+        group_offset_.push_back(offset);
+    }
+    group_states_.resize(motor_groups_.size());
+    for (size_t g = 0; g < motor_groups_.size(); ++g) {
+        group_states_[g].resize(motor_groups_[g]->size());
+    }
+    cmd_q_.assign(motors_.size(), 0.0f);
+    cmd_dq_.assign(motors_.size(), 0.0f);
+    cmd_kp_.assign(motors_.size(), 0.0f);
+    cmd_kd_.assign(motors_.size(), 0.0f);
+    cmd_tau_.assign(motors_.size(), 0.0f);
+    joint_history_.resize(motors_.size());
+    for (size_t i = 0; i < motors_.size(); ++i) {
+        joint_history_[i] = std::make_unique<SampleHistory<MotorFeedback, joint_history_len>>();
+        auto* history = joint_history_[i].get();
+        motors_[i]->set_feedback_callback([history](const MotorFeedback& feedback) {
+            history->push(feedback.rx_time_ns, feedback);
+        });
     }
 }
 
 void RobotInterface::setup_imu(){
     imu_ = IMUDriver::create_imu(imu_cfg_->imu_id_, imu_cfg_->imu_interface_type_, imu_cfg_->imu_interface_, imu_cfg_->imu_type_, imu_cfg_->baudrate_);
+    if (imu_cfg_->imu_interface_type_ == "can") {
+        can_interfaces_.push_back(imu_cfg_->imu_interface_);
+    }
+    ImuDeviceCfg device_cfg;
+    device_cfg.packet = imu_cfg_->imu_packet_;
+    device_cfg.rate_hz = imu_cfg_->imu_rate_;
+    device_cfg.filter_mode = imu_cfg_->imu_filter_mode_;
+    device_cfg.save = imu_cfg_->imu_save_config_;
+    for (const auto& reg : imu_cfg_->imu_registers_) {
+        device_cfg.registers.emplace_back(reg.first, reg.second);
+    }
+    device_cfg.can_protocol = imu_cfg_->imu_can_protocol_;
+    if (device_cfg.packet != 0 || device_cfg.rate_hz != 0 || device_cfg.filter_mode >= 0 || !device_cfg.registers.empty() ||
+        !device_cfg.can_protocol.empty()) {
+        imu_->configure(device_cfg);
+    }
+    imu_history_ = std::make_unique<SampleHistory<ImuSample, imu_history_len>>();
+    auto* history = imu_history_.get();
+    imu_->set_sample_callback([history](const ImuSample& sample) {
+        history->push(sample.stamp_ns, sample);
+    });
 }
 
-void RobotInterface::apply_action(std::vector<float> action) {
+void RobotInterface::set_imu_filter(float gyro_alpha, float angle_alpha, bool bias_estimation) {
+    if (!imu_) {
+        throw std::runtime_error("IMU not initialized");
+    }
+    ImuFilterCfg cfg;
+    cfg.gyro_alpha = gyro_alpha;
+    cfg.angle_alpha = angle_alpha;
+    cfg.bias_estimation = bias_estimation;
+    imu_->set_filter(cfg);
+}
+
+ClockSyncStats RobotInterface::get_imu_clock_stats() {
+    if (!imu_) {
+        throw std::runtime_error("IMU not initialized");
+    }
+    return imu_->get_clock_stats();
+}
+
+SafetyLevel RobotInterface::apply_action(std::vector<float> action) {
     if(!is_init_.load()){
-        return;
+        return get_safety_status().level;
     }
 
+    SafetyLevel level;
     {
         std::unique_lock<std::mutex> lock(joint_mutex_);
-        std::vector<std::function<void()>> tasks;
-        exec_motors_parallel([this](std::shared_ptr<MotorDriver>& motor, int idx) {
-            joint_q_[idx] = motor->get_motor_pos() * robot_cfg_->motor_sign_[idx];
-            joint_vel_[idx] = motor->get_motor_spd() * robot_cfg_->motor_sign_[idx];
-            joint_tau_[idx] = motor->get_motor_current() * robot_cfg_->motor_sign_[idx];
-            if (motor->get_response_count() > offline_threshold_) {
-                throw std::runtime_error("Motor " + std::to_string(idx) + " offline");
+        for (size_t g = 0; g < motor_groups_.size(); ++g) {
+            const MotorGroupState& state = group_states_[g];
+            motor_groups_[g]->read_states(group_states_[g]);
+            for (size_t j = 0; j < motor_groups_[g]->size(); ++j) {
+                size_t idx = group_offset_[g] + j;
+                joint_q_[idx] = state.pos[j] * robot_cfg_->motor_sign_[idx];
+                joint_vel_[idx] = state.spd[j] * robot_cfg_->motor_sign_[idx];
+                joint_tau_[idx] = state.current[j] * robot_cfg_->motor_sign_[idx];
+                motor_temperature_[idx] = state.temperature[j];
+                motor_error_[idx] = state.error_id[j];
+                motor_rx_ns_[idx] = state.rx_time_ns[j];
             }
-        });
+        }
 
         if (!close_chain_motor_idx_.empty()){
             Eigen::VectorXd q(2), vel(2), tau(2);
@@ -125,18 +287,89 @@ void RobotInterface::apply_action(std::vector<float> action) {
             action[idx1] = tau[0];
             action[idx2] = tau[1];
         }
+
+        // between reset_joints() / init_motors() / pause() and the next action no commands are
+        // sent and the motors do not reply, the supervisor counts feedback age from that action
+        uint64_t now_ns = monotonic_ns();
+        SampleHistory<ImuSample, imu_history_len>::Entry imu;
+        bool has_imu = imu_history_ && imu_history_->latest(imu);
+        SafetyInput input{joint_q_.data(), joint_vel_.data(), joint_tau_.data(), motor_temperature_.data(),
+                          motor_error_.data(), motor_rx_ns_.data(), has_imu ? imu.value.quat : nullptr,
+                          has_imu ? imu.value.rx_time_ns : 0, now_ns};
+        level = safety_->evaluate(input);
+        if (level != safety_applied_) {
+            const SafetyStatus& status = safety_->status();
+            spdlog::error("Safety: {}", SafetySupervisor::describe(status.event));
+            if (level == SafetyLevel::HOLD) {
+                for (size_t g = 0; g < motor_groups_.size(); ++g) {
+                    for (size_t j = 0; j < motor_groups_[g]->size(); ++j) {
+                        hold_q_[group_offset_[g] + j] = group_states_[g].pos[j];
+                    }
+                }
+            }
+            safety_applied_ = level;
+        }
     }
 
-    exec_motors_parallel([this, &action](std::shared_ptr<MotorDriver>& motor, int idx) {
-        if (std::find(close_chain_motor_idx_.begin(), close_chain_motor_idx_.end(), idx) == close_chain_motor_idx_.end()){
-            motor->motor_mit_cmd(action[idx] * robot_cfg_->motor_sign_[idx], 0.0f, robot_cfg_->kp_[idx], robot_cfg_->kd_[idx], 0.0f);
+    if (level == SafetyLevel::POWER_DOWN) {
+        power_down();
+        return level;
+    }
+    std::unique_lock<std::mutex> lock(motors_mutex_);
+    for (size_t idx = 0; idx < motors_.size(); ++idx) {
+        if (level == SafetyLevel::DAMP) {
+            cmd_q_[idx] = 0.0f;
+            cmd_kp_[idx] = 0.0f;
+            cmd_kd_[idx] = motors_cfg_->watchdog_kd_[idx];
+            cmd_tau_[idx] = 0.0f;
+        } else if (level == SafetyLevel::HOLD) {
+            // in motor space, the closed chain motors hold with the gains of their joints
+            cmd_q_[idx] = hold_q_[idx];
+            cmd_kp_[idx] = robot_cfg_->kp_[idx];
+            cmd_kd_[idx] = robot_cfg_->kd_[idx];
+            cmd_tau_[idx] = 0.0f;
         } else {
-            motor->motor_mit_cmd(0.0f, 0.0f, 0.0f, 0.0f, action[idx] * robot_cfg_->motor_sign_[idx]);
+            float cmd = action[idx] * robot_cfg_->motor_sign_[idx];
+            bool torque = std::find(close_chain_motor_idx_.begin(), close_chain_motor_idx_.end(), idx) != close_chain_motor_idx_.end();
+            cmd_q_[idx] = torque ? 0.0f : cmd;
+            cmd_kp_[idx] = torque ? 0.0f : robot_cfg_->kp_[idx];
+            cmd_kd_[idx] = torque ? 0.0f : robot_cfg_->kd_[idx];
+            cmd_tau_[idx] = torque ? cmd : 0.0f;
         }
-    });
+        cmd_dq_[idx] = 0.0f;
+    }
+    if (!watchdog_armed_) {
+        arm_watchdogs();
+    }
+    send_motor_commands();
+    return level;
+}
+
+// One TX burst per bus with the commands in cmd_*_, call with motors_mutex_ held.
+void RobotInterface::send_motor_commands() {
+    for (size_t g = 0; g < motor_groups_.size(); ++g) {
+        size_t offset = group_offset_[g];
+        motor_groups_[g]->mit_cmd_batch(cmd_q_.data() + offset, cmd_dq_.data() + offset, cmd_kp_.data() + offset,
+                                        cmd_kd_.data() + offset, cmd_tau_.data() + offset);
+    }
+}
+
+void RobotInterface::pause() {
+    {
+        std::unique_lock<std::mutex> lock(joint_mutex_);
+        safety_->end_stream();
+    }
+    std::unique_lock<std::mutex> lock(motors_mutex_);
+    disarm_watchdogs();
 }
 
+// Holds the default pose until the next apply_action(), so the watchdog stays off meanwhile.
 void RobotInterface::reset_joints(std::vector<double> joint_default_angle) {
+    reset_safety();
+    {
+        std::unique_lock<std::mutex> lock(motors_mutex_);
+        disarm_watchdogs();
+    }
     if (!close_chain_motor_idx_.empty()){
         Eigen::VectorXd q(2), vel(2), tau(2);
         int idx1 = close_chain_motor_idx_[0];
@@ -154,13 +387,20 @@ void RobotInterface::reset_joints(std::vector<double> joint_default_angle) {
         joint_default_angle[idx2] = q[1];
     }
 
-    exec_motors_parallel([this, &joint_default_angle](std::shared_ptr<MotorDriver>& motor, int idx) {
-        motor->motor_mit_cmd(joint_default_angle[idx] * robot_cfg_->motor_sign_[idx], 0.0f, robot_cfg_->kp_[idx]/2.0f, robot_cfg_->kd_[idx]/2.0f, 0.0f);
-    });
-    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-    exec_motors_parallel([this, &joint_default_angle](std::shared_ptr<MotorDriver>& motor, int idx) {
-        motor->motor_mit_cmd(joint_default_angle[idx] * robot_cfg_->motor_sign_[idx], 0.0f, robot_cfg_->kp_[idx], robot_cfg_->kd_[idx], 0.0f);
-    });
+    for (float gain : {0.5f, 1.0f}) {
+        if (gain == 1.0f) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        }
+        std::unique_lock<std::mutex> lock(motors_mutex_);
+        for (size_t idx = 0; idx < motors_.size(); ++idx) {
+            cmd_q_[idx] = joint_default_angle[idx] * robot_cfg_->motor_sign_[idx];
+            cmd_dq_[idx] = 0.0f;
+            cmd_kp_[idx] = robot_cfg_->kp_[idx] * gain;
+            cmd_kd_[idx] = robot_cfg_->kd_[idx] * gain;
+            cmd_tau_[idx] = 0.0f;
+        }
+        send_motor_commands();
+    }
 }
 
 void RobotInterface::refresh_joints() {
@@ -206,29 +446,101 @@ void RobotInterface::refresh_joints() {
 }
 
 void RobotInterface::set_zeros() {
-    exec_motors_parallel([](std::shared_ptr<MotorDriver>& motor, int idx) {
-        motor->set_motor_zero();
-    });
+    std::string failures = describe_failures(run_motor_steps(&MotorDriver::zero_steps));
+    if (!failures.empty()) {
+        throw std::runtime_error("Set zeros: " + failures);
+    }
 }
 
 void RobotInterface::clear_errors() {
-    exec_motors_parallel([](std::shared_ptr<MotorDriver>& motor, int idx) {
-        motor->clear_motor_error();
-    });
+    std::string failures = describe_failures(run_motor_steps(&MotorDriver::clear_error_steps));
+    if (!failures.empty()) {
+        throw std::runtime_error("Clear errors: " + failures);
+    }
 }
 
 void RobotInterface::init_motors() {
-    exec_motors_parallel([](std::shared_ptr<MotorDriver>& motor, int idx) {
-        motor->init_motor();
-    });
+    std::string failures = describe_failures(run_motor_steps(&MotorDriver::init_steps));
+    if (!failures.empty()) {
+        // leave no motor half enabled
+        run_motor_steps(&MotorDriver::deinit_steps);
+        throw std::runtime_error("Init motors: " + failures);
+    }
+    reset_safety();
     is_init_.store(true);
 }
 
+// Failures are only logged by the sequencer, this also runs from the destructor.
 void RobotInterface::deinit_motors() {
-    exec_motors_parallel([](std::shared_ptr<MotorDriver>& motor, int idx) {
-        motor->deinit_motor();
-    });
     is_init_.store(false);
+    {
+        std::unique_lock<std::mutex> lock(motors_mutex_);
+        disarm_watchdogs();
+    }
+    run_motor_steps(&MotorDriver::deinit_steps);
+}
+
+// From here on the CAN TX threads damp the motors of a bus whose commands stop, e.g. while the
+// caller of apply_action() stalls. Armed by the first apply_action(), call with motors_mutex_ held.
+void RobotInterface::arm_watchdogs() {
+    if (motors_cfg_->watchdog_timeout_ms_ <= 0) {
+        return;
+    }
+    std::vector<float> kd(motors_cfg_->watchdog_kd_.begin(), motors_cfg_->watchdog_kd_.end());
+    for (size_t g = 0; g < motor_groups_.size(); ++g) {
+        motor_groups_[g]->arm_watchdog(static_cast<uint32_t>(motors_cfg_->watchdog_timeout_ms_),
+                                       static_cast<uint32_t>(motors_cfg_->watchdog_period_ms_), kd.data() + group_offset_[g]);
+    }
+    watchdog_armed_ = true;
+}
+
+void RobotInterface::disarm_watchdogs() {
+    for (auto& group : motor_groups_) {
+        group->disarm_watchdog();
+    }
+    watchdog_armed_ = false;
+}
+
+void RobotInterface::set_safety_limits(const std::vector<double>& joint_limits, float gravity_z_upper) {
+    if (!joint_limits.empty() && joint_limits.size() != 2 * motors_.size()) {
+        throw std::runtime_error("joint_limits must have a [min, max] pair per joint");
+    }
+    std::unique_lock<std::mutex> lock(joint_mutex_);
+    SafetyCfg cfg = safety_->get_cfg();
+    cfg.q_min.clear();
+    cfg.q_max.clear();
+    for (size_t i = 0; i < joint_limits.size(); i += 2) {
+        cfg.q_min.push_back(joint_limits[i]);
+        cfg.q_max.push_back(joint_limits[i + 1]);
+    }
+    cfg.gravity_z_upper = gravity_z_upper;
+    safety_->configure(cfg);
+}
+
+void RobotInterface::reset_safety() {
+    std::unique_lock<std::mutex> lock(joint_mutex_);
+    safety_->reset();
+    safety_applied_ = SafetyLevel::OK;
+}
+
+// Disables all motors from the PD tick without waiting for the replies.
+void RobotInterface::power_down() {
+    is_init_.store(false);
+    std::unique_lock<std::mutex> lock(motors_mutex_);
+    disarm_watchdogs();
+    for (auto& motor : motors_) {
+        motor->unlock_motor();
+    }
+}
+
+// Runs the given procedure on all motors of all buses at once and waits for the slowest one.
+std::vector<MotorOpResult> RobotInterface::run_motor_steps(std::vector<MotorStep> (MotorDriver::*steps)()) {
+    std::unique_lock<std::mutex> lock(motors_mutex_);
+    MotorSequencer sequencer;
+    for (auto& motor : motors_) {
+        sequencer.add(*motor, ((*motor).*steps)());
+    }
+    return sequencer.run();
 }
 
 void RobotInterface::exec_motors_parallel(std::function<void(std::shared_ptr<MotorDriver>&, int)> cmd_func) {
@@ -249,3 +561,116 @@ void RobotInterface::exec_motors_parallel(std::function<void(std::shared_ptr<Mot
     }
     thread_pool_->run_parallel(tasks);
 }
+
+
+bool RobotInterface::capture_observation(uint64_t t_ref_ns, std::vector<float>& quat, std::vector<float>& ang_vel,
+                                         std::vector<float>& joint_q, std::vector<float>& joint_vel, std::vector<float>& joint_tau) {
+    bool imu_complete = true, joints_complete = true;
+    double imu_age_us = 0.0, joint_age_max_us = 0.0, joint_age_sum_us = 0.0;
+
+    SampleHistory<ImuSample, imu_history_len>::Entry a, b;
+    int n = imu_history_ ? imu_history_->bracket(t_ref_ns, a, b) : 0;
+    if (n == 0) {
+        imu_complete = false;
+    } else {
+        if (n == 1) {
+            a = b;
+        }
+        const ImuSample& sa = a.value;
+        const ImuSample& sb = b.value;
+        Eigen::Quaternionf qa(sa.quat[0], sa.quat[1], sa.quat[2], sa.quat[3]);
+        Eigen::Quaternionf qb(sb.quat[0], sb.quat[1], sb.quat[2], sb.quat[3]);
+        Eigen::Quaternionf q = qb;
+        if (t_ref_ns > b.stamp_ns) {
+            // past the newest sample: integrate its body rate over the (bounded) gap
+            float dt = std::min(t_ref_ns - b.stamp_ns, imu_max_extrapolation_ns) * 1e-9f;
+            Eigen::Vector3f omega(sb.gyro[0], sb.gyro[1], sb.gyro[2]);
+            float angle = omega.norm() * dt;
+            if (angle > 1e-9f) {
+                q = qb * Eigen::Quaternionf(Eigen::AngleAxisf(angle, omega.normalized()));
+            }
+            for (int i = 0; i < 3; i++) {
+                ang_vel[i] = sb.gyro[i];
+            }
+        } else if (b.stamp_ns > a.stamp_ns && t_ref_ns > a.stamp_ns) {
+            float s = static_cast<float>(t_ref_ns - a.stamp_ns) / static_cast<float>(b.stamp_ns - a.stamp_ns);
+            q = qa.slerp(s, qb);
+            for (int i = 0; i < 3; i++) {
+                ang_vel[i] = sa.gyro[i] + s * (sb.gyro[i] - sa.gyro[i]);
+            }
+        } else {
+            q = qa;
+            for (int i = 0; i < 3; i++) {
+                ang_vel[i] = sa.gyro[i];
+            }
+        }
+        quat[0] = q.w();
+        quat[1] = q.x();
+        quat[2] = q.y();
+        quat[3] = q.z();
+        imu_age_us = t_ref_ns > b.stamp_ns ? (t_ref_ns - b.stamp_ns) * 1e-3 : 0.0;
+    }
+
+    size_t reported = 0;
+    SampleHistory<MotorFeedback, joint_history_len>::Entry fb;
+    for (size_t i = 0; i < joint_history_.size(); i++) {
+        if (!joint_history_[i]->latest_before(t_ref_ns, fb) && !joint_history_[i]->latest(fb)) {
+            joints_complete = false;
+            continue;
+        }
+        joint_q[i] = fb.value.pos * robot_cfg_->motor_sign_[i];
+        joint_vel[i] = fb.value.spd * robot_cfg_->motor_sign_[i];
+        joint_tau[i] = fb.value.current * robot_cfg_->motor_sign_[i];
+        double age_us = t_ref_ns > fb.stamp_ns ? (t_ref_ns - fb.stamp_ns) * 1e-3 : 0.0;
+        joint_age_sum_us += age_us;
+        joint_age_max_us = std::max(joint_age_max_us, age_us);
+        reported += 1;
+    }
+
+    // the ankles are decoupled whenever all joints reported, independently of the IMU
+    if (joints_complete && !close_chain_motor_idx_.empty()) {
+        for (int leg = 0; leg < 2; leg++) {
+            int idx1 = close_chain_motor_idx_[leg * 2];
+            int idx2 = close_chain_motor_idx_[leg * 2 + 1];
+            cc_q_ << joint_q[idx1], joint_q[idx2];
+            cc_vel_ << joint_vel[idx1], joint_vel[idx2];
+            cc_tau_ << joint_tau[idx1], joint_tau[idx2];
+            ankle_decouple_->get_forwardQVT(cc_q_, cc_vel_, cc_tau_, leg == 0);
+            joint_q[idx1] = cc_q_[0];
+            joint_q[idx2] = cc_q_[1];
+            joint_vel[idx1] = cc_vel_[0];
+            joint_vel[idx2] = cc_vel_[1];
+            joint_tau[idx1] = cc_tau_[0];
+            joint_tau[idx2] = cc_tau_[1];
+        }
+    }
+
+    age_stats_.captures += 1;
+    if (!imu_complete) {
+        age_stats_.imu_missing += 1;
+    }
+    if (!joints_complete) {
+        age_stats_.joints_missing += 1;
+    }
+    imu_age_sum_us_ += imu_age_us;
+    age_stats_.imu_age_max_us = std::max(age_stats_.imu_age_max_us, imu_age_us);
+    if (reported > 0) {
+        joint_age_sum_us_ += joint_age_sum_us / reported;
+        age_stats_.joint_age_max_us = std::max(age_stats_.joint_age_max_us, joint_age_max_us);
+    }
+    return imu_complete && joints_complete;
+}
+
+RobotInterface::SensorAgeStats RobotInterface::get_age_stats(bool reset) {
+    SensorAgeStats stats = age_stats_;
+    if (stats.captures > 0) {
+        stats.imu_age_mean_us = imu_age_sum_us_ / stats.captures;
+        stats.joint_age_mean_us = joint_age_sum_us_ / stats.captures;
+    }
+    if (reset) {
+        age_stats_ = SensorAgeStats();
+        imu_age_sum_us_ = 0.0;
+        joint_age_sum_us_ = 0.0;
+    }
+    return stats;
+}
@@ -5,8 +5,10 @@ void InferenceNode::load_config() {
     this->declare_parameter<std::string>("motion_name", "motion.npz");
     this->declare_parameter<std::string>("motion_model_name", "1.onnx");
     this->declare_parameter<float>("act_alpha", 0.9);
+    this->declare_parameter<std::string>("action_interp", "hold");
     this->declare_parameter<float>("gyro_alpha", 0.9);
     this->declare_parameter<float>("angle_alpha", 0.9);
+    this->declare_parameter<bool>("gyro_bias_estimation", false);
     this->declare_parameter<int>("intra_threads", -1);
     this->declare_parameter<bool>("use_interrupt", false);
     this->declare_parameter<bool>("use_beyondmimic", false);
@@ -32,14 +34,17 @@ void InferenceNode::load_config() {
     this->declare_parameter<std::vector<double>>("clip_cmd", std::vector<double>{});
     this->declare_parameter<std::vector<double>>("joint_default_angle", std::vector<double>{});
     this->declare_parameter<std::vector<double>>("joint_limits", std::vector<double>{});
+    this->declare_parameter<float>("gravity_z_upper", 1.0);
 
 
     this->get_parameter("model_name", model_name_);
     this->get_parameter("motion_name", motion_name_);
     this->get_parameter("motion_model_name", motion_model_name_);
     this->get_parameter("act_alpha", act_alpha_);
+    this->get_parameter("action_interp", action_interp_);
     this->get_parameter("gyro_alpha", gyro_alpha_);
     this->get_parameter("angle_alpha", angle_alpha_);
+    this->get_parameter("gyro_bias_estimation", gyro_bias_estimation_);
     this->get_parameter("intra_threads", intra_threads_);
     this->get_parameter("use_interrupt", use_interrupt_);
     this->get_parameter("use_beyondmimic", use_beyondmimic_);
@@ -65,6 +70,7 @@ void InferenceNode::load_config() {
     this->get_parameter("clip_cmd", clip_cmd_);
     this->get_parameter("joint_default_angle", joint_default_angle_);
     this->get_parameter("joint_limits", joint_limits_);
+    this->get_parameter("gravity_z_upper", gravity_z_upper_);
 
 
     model_path_ = std::string(ROOT_DIR) + "models/" + model_name_;
@@ -74,8 +80,10 @@ void InferenceNode::load_config() {
     RCLCPP_INFO(this->get_logger(), "motion_path: %s", motion_path_.c_str());
     RCLCPP_INFO(this->get_logger(), "motion_model_path: %s", motion_model_path_.c_str());
     RCLCPP_INFO(this->get_logger(), "act_alpha: %f", act_alpha_);
+    RCLCPP_INFO(this->get_logger(), "action_interp: %s", action_interp_.c_str());
     RCLCPP_INFO(this->get_logger(), "gyro_alpha: %f", gyro_alpha_);
     RCLCPP_INFO(this->get_logger(), "angle_alpha: %f", angle_alpha_);
+    RCLCPP_INFO(this->get_logger(), "gyro_bias_estimation: %s", gyro_bias_estimation_ ? "true" : "false");
     RCLCPP_INFO(this->get_logger(), "intra_threads: %d", intra_threads_);
     RCLCPP_INFO(this->get_logger(), "use_interrupt: %s", use_interrupt_ ? "true" : "false");
     RCLCPP_INFO(this->get_logger(), "use_beyondmimic: %s", use_beyondmimic_ ? "true" : "false");
@@ -92,6 +100,7 @@ void InferenceNode::load_config() {
     RCLCPP_INFO(this->get_logger(), "obs_scales_gravity_b: %f", obs_scales_gravity_b_);
     RCLCPP_INFO(this->get_logger(), "action_scale: %f", action_scale_);
     RCLCPP_INFO(this->get_logger(), "clip_actions: %f", clip_actions_);
+    RCLCPP_INFO(this->get_logger(), "gravity_z_upper: %f", gravity_z_upper_);
     print_vector<long int>("usd2urdf", usd2urdf_);
     print_vector<double>("clip_cmd", clip_cmd_);
     print_vector<double>("joint_default_angle", joint_default_angle_);
@@ -120,8 +129,13 @@ void InferenceNode::subs_joy_callback(const std::shared_ptr<sensor_msgs::msg::Jo
             robot_->deinit_motors();
             RCLCPP_INFO(this->get_logger(), "Motors deinitialized");
         } else {
-            robot_->init_motors();
-            RCLCPP_INFO(this->get_logger(), "Motors initialized");
+            try {
+                clear_safety_stop();
+                robot_->init_motors();
+                RCLCPP_INFO(this->get_logger(), "Motors initialized");
+            } catch (const std::exception& e) {
+                RCLCPP_ERROR(this->get_logger(), "%s", e.what());
+            }
         }
     }
     if (msg->buttons[1] == 1 && msg->buttons[1] != last_button1_) {
@@ -132,13 +146,22 @@ void InferenceNode::subs_joy_callback(const std::shared_ptr<sensor_msgs::msg::Jo
         if (!robot_->is_init_.load()){
             RCLCPP_WARN(this->get_logger(), "Motors are not initialized!");
         } else {
+            clear_safety_stop();
             robot_->reset_joints(joint_default_angle_);
             RCLCPP_INFO(this->get_logger(), "Motors reset");
         }
     }
     if (msg->buttons[2] == 1 && msg->buttons[2] != last_button2_) {
-        is_running_.store(!is_running_.load());
-        RCLCPP_INFO(this->get_logger(), "Inference %s", is_running_.load() ? "started" : "paused");
+        if (safety_stop_.load()) {
+            RCLCPP_WARN(this->get_logger(), "Safety stop active, reset the joints or re-initialize the motors first!");
+        } else {
+            if (is_running_.load()) {
+                pause_inference();
+            } else {
+                is_running_.store(true);
+            }
+            RCLCPP_INFO(this->get_logger(), "Inference %s", is_running_.load() ? "started" : "paused");
+        }
     }
     if (msg->buttons[3] == 1 && msg->buttons[3] != last_button3_) {
         is_joy_control_.store(!is_joy_control_);
@@ -151,7 +174,7 @@ void InferenceNode::subs_joy_callback(const std::shared_ptr<sensor_msgs::msg::Jo
                 RCLCPP_INFO(this->get_logger(), "Interrupt mode %s", is_interrupt_.load() ? "enabled" : "disabled");
             }
             if(use_beyondmimic_){
-                is_running_.store(false);
+                pause_inference();
                 std::this_thread::sleep_for(std::chrono::milliseconds(50));
                 is_beyondmimic_.store(!is_beyondmimic_.load());
                 bool is_beyondmimic = is_beyondmimic_.load();
@@ -170,6 +193,8 @@ void InferenceNode::subs_joy_callback(const std::shared_ptr<sensor_msgs::msg::Jo
                 std::fill(active_ctx_->output_buffer.begin(), active_ctx_->output_buffer.end(), 0.0f);
                 std::fill(act_.begin(), act_.end(), 0.0f);
                 std::fill(last_act_.begin(), last_act_.end(), 0.0f);
+                std::fill(interp_act_.begin(), interp_act_.end(), 0.0f);
+                act_interp_->reset();
                 is_first_frame_ = true;
                 motion_frame_ = 0;
                 std::this_thread::sleep_for(std::chrono::milliseconds(50));
@@ -225,6 +250,7 @@ void InferenceNode::reset_joints_srv(const std::shared_ptr<std_srvs::srv::Trigge
         return;
     }
     try {
+        clear_safety_stop();
         robot_->reset_joints(joint_default_angle_);
         response->success = true;
         response->message = "Joints reset successfully";
@@ -334,6 +360,7 @@ void InferenceNode::init_motors_srv(const std::shared_ptr<std_srvs::srv::Trigger
         return;
     }
     try {
+        clear_safety_stop();
         robot_->init_motors();
         response->success = true;
         response->message = "Motors initialized successfully";
@@ -367,6 +394,11 @@ void InferenceNode::start_inference_srv(const std::shared_ptr<std_srvs::srv::Tri
         response->message = "Inference is already running!";
         return;
     }
+    if (safety_stop_.load()) {
+        response->success = false;
+        response->message = "Safety stop active, reset the joints or re-initialize the motors first.";
+        return;
+    }
     is_running_.store(true);
     response->success = true;
     response->message = "Inference started";
@@ -379,7 +411,7 @@ void InferenceNode::stop_inference_srv(const std::shared_ptr<std_srvs::srv::Trig
         response->message = "Inference is already stopped!";
         return;
     }
-    is_running_.store(false);
+    pause_inference();
     response->success = true;
     response->message = "Inference stopped";
 }
@@ -417,4 +449,139 @@ void InferenceNode::publish_imu() {
     msg.angular_velocity.y = ang_vel_[1];
     msg.angular_velocity.z = ang_vel_[2];
     imu_publisher_->publish(msg);
-}
\ No newline at end of file
+}
+
+// One status per CAN bus: load, error state and the command -> reply latency of every device on it,
+// one for the safety supervisor, one with the scheduling of every thread and one for the memory.
+void InferenceNode::publish_diagnostics() {
+    using diagnostic_msgs::msg::DiagnosticStatus;
+    using diagnostic_msgs::msg::KeyValue;
+    auto msg = diagnostic_msgs::msg::DiagnosticArray();
+    msg.header.stamp = this->now();
+    for (const auto& interface : robot_->get_can_interfaces()) {
+        auto can = SocketCAN::get(interface);
+        CanBusStats bus = can->get_bus_stats();
+        SocketCAN::BusErrorStats errors = can->get_bus_error_stats();
+        SocketCAN::TxStats tx = can->get_tx_stats();
+        SocketCAN::WatchdogStats watchdog = can->get_watchdog_stats();
+
+        DiagnosticStatus status;
+        status.name = "can: " + interface;
+        status.hardware_id = interface;
+        status.level = DiagnosticStatus::OK;
+        status.message = can_bus_state_name(errors.state);
+        if (errors.state >= CanBusState::BUS_OFF) {
+            status.level = DiagnosticStatus::ERROR;
+        } else if (errors.state != CanBusState::ERROR_ACTIVE || bus.load > 0.8f) {
+            status.level = DiagnosticStatus::WARN;
+        }
+        if (bus.load > 0.8f) {
+            status.message += ", bus load high";
+        }
+        if (watchdog.tripped) {
+            status.message += ", watchdog damping";
+        }
+        auto add = [&status](const std::string& key, const std::string& value) {
+            KeyValue kv;
+            kv.key = key;
+            kv.value = value;
+            status.values.push_back(kv);
+        };
+        add("bitrate", std::to_string(bus.bitrate));
+        add("load %", fmt::format("{:.1f}", bus.load * 100.0f));
+        add("tx frames/s", fmt::format("{:.0f}", bus.tx_fps));
+        add("rx frames/s", fmt::format("{:.0f}", bus.rx_fps));
+        add("tx queue high water", std::to_string(bus.tx_queue_high_water));
+        add("tx dropped", std::to_string(tx.dropped));
+        add("tx coalesced", std::to_string(tx.coalesced));
+        add("tec / rec", fmt::format("{} / {}", errors.tx_error_count, errors.rx_error_count));
+        add("error frames", std::to_string(errors.error_frames));
+        add("bus off", std::to_string(errors.bus_off));
+        add("restarts", std::to_string(errors.restarts));
+        add("watchdog", watchdog.armed ? (watchdog.tripped ? "damping" : "armed") : "off");
+        add("watchdog trips", std::to_string(watchdog.trips));
+        for (const auto& rtt : bus.rtt) {
+            add(fmt::format("rtt 0x{:03x}", rtt.command_id),
+                fmt::format("p50 {} us, p99 {} us, max {} us, replies {}, lost {}", rtt.percentile_ns(0.5) / 1000,
+                            rtt.percentile_ns(0.99) / 1000, rtt.max_ns / 1000, rtt.replies, rtt.lost));
+        }
+        msg.status.push_back(status);
+    }
+
+    SafetyStatus safety = robot_->get_safety_status();
+    DiagnosticStatus status;
+    status.name = "safety supervisor";
+    status.level = safety.level == SafetyLevel::OK ? DiagnosticStatus::OK : DiagnosticStatus::ERROR;
+    status.message = safety.level == SafetyLevel::OK ? "ok" : SafetySupervisor::describe(safety.event);
+    auto add = [&status](const std::string& key, const std::string& value) {
+        KeyValue kv;
+        kv.key = key;
+        kv.value = value;
+        status.values.push_back(kv);
+    };
+    add("response", SafetySupervisor::level_name(safety.level));
+    add("ticks", std::to_string(safety.ticks));
+    add("trips", std::to_string(safety.trips));
+    msg.status.push_back(status);
+
+    auto& topology = ThreadTopology::instance();
+    std::vector<ThreadLayout> threads = topology.layout();
+    std::vector<std::string> warnings = topology.validate();
+    DiagnosticStatus thread_status;
+    thread_status.name = "threads";
+    thread_status.level = warnings.empty() ? DiagnosticStatus::OK : DiagnosticStatus::WARN;
+    thread_status.message = warnings.empty() ? "ok" : warnings.front();
+    for (const auto& thread : threads) {
+        KeyValue kv;
+        kv.key = thread.name;
+        kv.value = topology.describe(thread);
+        thread_status.values.push_back(kv);
+    }
+    for (const auto& warning : warnings) {
+        KeyValue kv;
+        kv.key = "warning";
+        kv.value = warning;
+        thread_status.values.push_back(kv);
+    }
+    msg.status.push_back(thread_status);
+
+    // page faults of the real-time threads since the last publish, there should be none
+    uint64_t rt_faults = 0;
+    std::map<pid_t, uint64_t> thread_faults;
+    for (const auto& thread : threads) {
+        if (!thread.alive || thread.policy == SCHED_OTHER) continue;
+        uint64_t faults = thread.faults.minor + thread.faults.major;
+        thread_faults[thread.tid] = faults;
+        auto it = thread_faults_.find(thread.tid);
+        if (it != thread_faults_.end()) rt_faults += faults - it->second;
+    }
+    thread_faults_ = std::move(thread_faults);
+    RtMemoryStatus memory = rt_memory_status();
+    DiagnosticStatus memory_status;
+    memory_status.name = "memory";
+    memory_status.level = memory.locked && rt_faults == 0 ? DiagnosticStatus::OK : DiagnosticStatus::WARN;
+    memory_status.message = memory.locked ? "locked" : "not locked";
+    if (rt_faults > 0) {
+        memory_status.message += ", page faults on real-time threads";
+    }
+    auto add_memory = [&memory_status](const std::string& key, const std::string& value) {
+        KeyValue kv;
+        kv.key = key;
+        kv.value = value;
+        memory_status.values.push_back(kv);
+    };
+    add_memory("locked kB", std::to_string(memory.locked_kb));
+    add_memory("resident kB", std::to_string(memory.resident_kb));
+    add_memory("heap reserve MB", std::to_string(memory.heap_reserve_mb));
+    add_memory("stack prefault kB", std::to_string(memory.stack_prefault_kb));
+    add_memory("real-time page faults", std::to_string(rt_faults));
+    msg.status.push_back(memory_status);
+
+    if (!thread_layout_logged_) {
+        thread_layout_logged_ = true;
+        for (const auto& thread : threads) {
+            RCLCPP_INFO(this->get_logger(), "%s", topology.describe(thread).c_str());
+        }
+    }
+    diagnostics_publisher_->publish(msg);
+}
@@ -0,0 +1,70 @@
+#include "action_interpolator.hpp"
+
+#include <algorithm>
+
+ActionInterpolator::ActionInterpolator(size_t size, Mode mode, double policy_period)
+    : size_(size), mode_(mode), policy_period_(policy_period),
+      prev2_(size, 0.0f), prev_(size, 0.0f), curr_(size, 0.0f) {
+    if (policy_period_ <= 0.0) {
+        throw std::runtime_error("ActionInterpolator: policy period must be positive");
+    }
+}
+
+ActionInterpolator::Mode ActionInterpolator::parse_mode(const std::string& name) {
+    if (name == "hold") return HOLD;
+    if (name == "linear") return LINEAR;
+    if (name == "cubic") return CUBIC;
+    throw std::runtime_error("Unknown action interpolation mode: " + name);
+}
+
+void ActionInterpolator::reset() {
+    std::fill(prev2_.begin(), prev2_.end(), 0.0f);
+    std::fill(prev_.begin(), prev_.end(), 0.0f);
+    std::fill(curr_.begin(), curr_.end(), 0.0f);
+    count_ = 0;
+}
+
+void ActionInterpolator::push(const std::vector<float>& target, Clock::time_point stamp) {
+    if (count_ == 0) {
+        // no history yet: start from a standstill at the first target
+        std::copy(target.begin(), target.begin() + size_, prev2_.begin());
+        std::copy(target.begin(), target.begin() + size_, prev_.begin());
+    } else {
+        prev2_.swap(prev_);
+        prev_.swap(curr_);
+    }
+    std::copy(target.begin(), target.begin() + size_, curr_.begin());
+    stamp_ = stamp;
+    count_ += 1;
+}
+
+void ActionInterpolator::evaluate(Clock::time_point now, std::vector<float>& out) const {
+    if (mode_ == HOLD || count_ < 2) {
+        std::copy(curr_.begin(), curr_.end(), out.begin());
+        return;
+    }
+
+    float s = static_cast<float>(std::chrono::duration<double>(now - stamp_).count() / policy_period_);
+    s = std::clamp(s, 0.0f, 1.0f);
+
+    if (mode_ == LINEAR || count_ < 3) {
+        for (size_t i = 0; i < size_; i++) {
+            out[i] = prev_[i] + s * (curr_[i] - prev_[i]);
+        }
+        return;
+    }
+
+    // Hermite basis on [prev_, curr_]; tangents per policy period. Only past targets are known, so the
+    // start tangent is the central difference around prev_ and the end tangent the backward difference.
+    const float s2 = s * s;
+    const float s3 = s2 * s;
+    const float h00 = 2.0f * s3 - 3.0f * s2 + 1.0f;
+    const float h10 = s3 - 2.0f * s2 + s;
+    const float h01 = -2.0f * s3 + 3.0f * s2;
+    const float h11 = s3 - s2;
+    for (size_t i = 0; i < size_; i++) {
+        const float m0 = 0.5f * (curr_[i] - prev2_[i]);
+        const float m1 = curr_[i] - prev_[i];
+        out[i] = h00 * prev_[i] + h10 * m0 + h01 * curr_[i] + h11 * m1;
+    }
+}
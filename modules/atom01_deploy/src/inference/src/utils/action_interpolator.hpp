@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// Upsamples policy targets (one per policy period) to the PD tick rate.
+// All buffers are allocated once in the constructor, push()/evaluate() never allocate.
+class ActionInterpolator {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum Mode {
+        HOLD = 0,    // repeat the latest target (original behaviour)
+        LINEAR = 1,  // ramp from the previous target to the latest one over one policy period
+        CUBIC = 2,   // cubic Hermite between the previous and latest target, tangents from past targets
+    };
+
+    ActionInterpolator(size_t size, Mode mode, double policy_period);
+
+    static Mode parse_mode(const std::string& name);
+
+    void reset();
+    void push(const std::vector<float>& target, Clock::time_point stamp);
+    void evaluate(Clock::time_point now, std::vector<float>& out) const;
+
+    Mode get_mode() const { return mode_; }
+
+private:
+    size_t size_;
+    Mode mode_;
+    double policy_period_;
+    size_t count_ = 0;
+    Clock::time_point stamp_;
+    // targets k-2, k-1 and k
+    std::vector<float> prev2_, prev_, curr_;
+};
@@ -0,0 +1,230 @@
+#include "safety_supervisor.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+// The scans below OR the comparisons of all joints without branching so that the compiler
+// vectorizes them. Comparisons are written so that NaN counts as a fault.
+
+int first_outside(const float* x, const float* lo, const float* hi, size_t n) {
+    int any = 0;
+    for (size_t i = 0; i < n; i++) {
+        any |= !(x[i] >= lo[i]) | !(x[i] <= hi[i]);
+    }
+    if (!any) {
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!(x[i] >= lo[i]) || !(x[i] <= hi[i])) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int first_above_abs(const float* x, const float* bound, size_t n) {
+    int any = 0;
+    for (size_t i = 0; i < n; i++) {
+        any |= !(std::fabs(x[i]) <= bound[i]);
+    }
+    if (!any) {
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!(std::fabs(x[i]) <= bound[i])) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int first_above(const float* x, float bound, size_t n) {
+    int any = 0;
+    for (size_t i = 0; i < n; i++) {
+        any |= !(x[i] <= bound);
+    }
+    if (!any) {
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!(x[i] <= bound)) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int first_nonzero(const uint8_t* x, size_t n) {
+    int any = 0;
+    for (size_t i = 0; i < n; i++) {
+        any |= x[i];
+    }
+    if (!any) {
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (x[i] != 0) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+// Feedback received before older_than_ns, including none at all (rx time 0).
+int first_older(const uint64_t* rx_time_ns, uint64_t older_than_ns, size_t n) {
+    int any = 0;
+    for (size_t i = 0; i < n; i++) {
+        any |= rx_time_ns[i] < older_than_ns;
+    }
+    if (!any) {
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (rx_time_ns[i] < older_than_ns) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+}  // namespace
+
+void SafetySupervisor::configure(const SafetyCfg& cfg) {
+    auto check_size = [this](const std::vector<float>& values, const char* name) {
+        if (!values.empty() && values.size() != size_) {
+            throw std::runtime_error(std::string("Safety: ") + name + " must have " + std::to_string(size_) +
+                                     " values, got " + std::to_string(values.size()));
+        }
+    };
+    check_size(cfg.q_min, "q_min");
+    check_size(cfg.q_max, "q_max");
+    check_size(cfg.max_vel, "max_vel");
+    check_size(cfg.max_tau, "max_tau");
+    if (cfg.q_min.size() != cfg.q_max.size()) {
+        throw std::runtime_error("Safety: q_min and q_max must be set together");
+    }
+    cfg_ = cfg;
+}
+
+SafetyLevel SafetySupervisor::evaluate(const SafetyInput& in) {
+    if (!streaming_) {
+        streaming_ = true;
+        stream_start_ns_ = in.now_ns;
+    }
+    SafetyEvent worst;
+    auto raise = [&](SafetyCheck check, int index, float value) {
+        SafetyLevel level = cfg_.response[check];
+        if (level > worst.level) {
+            worst = {level, check, index, value, in.now_ns};
+        }
+    };
+
+    int i;
+    if (!cfg_.q_min.empty() && (i = first_outside(in.q, cfg_.q_min.data(), cfg_.q_max.data(), size_)) >= 0) {
+        raise(SAFETY_JOINT_LIMIT, i, in.q[i]);
+    }
+    if (!cfg_.max_vel.empty() && (i = first_above_abs(in.vel, cfg_.max_vel.data(), size_)) >= 0) {
+        raise(SAFETY_VELOCITY, i, in.vel[i]);
+    }
+    if (!cfg_.max_tau.empty() && (i = first_above_abs(in.tau, cfg_.max_tau.data(), size_)) >= 0) {
+        raise(SAFETY_TORQUE, i, in.tau[i]);
+    }
+    if (cfg_.max_temperature > 0.0f && (i = first_above(in.temperature, cfg_.max_temperature, size_)) >= 0) {
+        raise(SAFETY_TEMPERATURE, i, in.temperature[i]);
+    }
+    if ((i = first_nonzero(in.error_id, size_)) >= 0) {
+        raise(SAFETY_MOTOR_ERROR, i, static_cast<float>(in.error_id[i]));
+    }
+    if (cfg_.stale_ms > 0) {
+        uint64_t stale_ns = static_cast<uint64_t>(cfg_.stale_ms) * 1000000ull;
+        uint64_t older_than_ns = in.now_ns > stale_ns ? in.now_ns - stale_ns : 0;
+        if (older_than_ns > stream_start_ns_ && (i = first_older(in.rx_time_ns, older_than_ns, size_)) >= 0) {
+            raise(SAFETY_STALE, i, (in.now_ns - in.rx_time_ns[i]) * 1e-6f);
+        }
+        if (in.quat && in.imu_stamp_ns < older_than_ns) {
+            raise(SAFETY_STALE, -1, (in.now_ns - in.imu_stamp_ns) * 1e-6f);
+        }
+    }
+    if (cfg_.gravity_z_upper < 1.0f && in.quat) {
+        // z of the world gravity (0, 0, -1) rotated into the body frame
+        float gravity_z = 2.0f * (in.quat[1] * in.quat[1] + in.quat[2] * in.quat[2]) - 1.0f;
+        if (!(gravity_z <= cfg_.gravity_z_upper)) {
+            raise(SAFETY_FALL, -1, gravity_z);
+        }
+    }
+
+    status_.ticks += 1;
+    if (worst.level > status_.level) {
+        status_.level = worst.level;
+        status_.event = worst;
+        status_.trips += 1;
+    }
+    return status_.level;
+}
+
+void SafetySupervisor::reset() {
+    status_.level = SafetyLevel::OK;
+    status_.event = SafetyEvent();
+    streaming_ = false;
+}
+
+SafetyLevel SafetySupervisor::parse_level(const std::string& name) {
+    if (name == "off") return SafetyLevel::OK;
+    if (name == "damp") return SafetyLevel::DAMP;
+    if (name == "hold") return SafetyLevel::HOLD;
+    if (name == "power_down") return SafetyLevel::POWER_DOWN;
+    throw std::runtime_error("Unknown safety response: " + name);
+}
+
+SafetyCheck SafetySupervisor::parse_check(const std::string& name) {
+    if (name == "joint_limit") return SAFETY_JOINT_LIMIT;
+    if (name == "velocity") return SAFETY_VELOCITY;
+    if (name == "torque") return SAFETY_TORQUE;
+    if (name == "temperature") return SAFETY_TEMPERATURE;
+    if (name == "stale") return SAFETY_STALE;
+    if (name == "motor_error") return SAFETY_MOTOR_ERROR;
+    if (name == "fall") return SAFETY_FALL;
+    throw std::runtime_error("Unknown safety check: " + name);
+}
+
+const char* SafetySupervisor::level_name(SafetyLevel level) {
+    switch (level) {
+        case SafetyLevel::OK: return "ok";
+        case SafetyLevel::DAMP: return "damp";
+        case SafetyLevel::HOLD: return "hold";
+        case SafetyLevel::POWER_DOWN: return "power_down";
+    }
+    return "unknown";
+}
+
+const char* SafetySupervisor::check_name(SafetyCheck check) {
+    switch (check) {
+        case SAFETY_JOINT_LIMIT: return "joint limit";
+        case SAFETY_VELOCITY: return "velocity";
+        case SAFETY_TORQUE: return "torque";
+        case SAFETY_TEMPERATURE: return "temperature";
+        case SAFETY_STALE: return "stale";
+        case SAFETY_MOTOR_ERROR: return "motor error";
+        case SAFETY_FALL: return "fall";
+        default: return "none";
+    }
+}
+
+std::string SafetySupervisor::describe(const SafetyEvent& event) {
+    if (event.level == SafetyLevel::OK) {
+        return "";
+    }
+    std::string source;
+    if (event.index < 0) {
+        source = "imu";
+    } else if (event.check <= SAFETY_TORQUE) {
+        source = "joint " + std::to_string(event.index);
+    } else {
+        source = "motor " + std::to_string(event.index);
+    }
+    char value[32];
+    snprintf(value, sizeof(value), "%.3g", event.value);
+    return source + " " + check_name(event.check) + " (" + value + ") -> " + level_name(event.level);
+}
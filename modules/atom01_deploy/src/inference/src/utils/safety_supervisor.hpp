@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Responses in escalating order, a tripped supervisor only ever moves up until reset().
+enum class SafetyLevel : uint8_t {
+    OK = 0,
+    DAMP = 1,        // kp = 0, damping only
+    HOLD = 2,        // hold the motor positions of the tick the fault was found in
+    POWER_DOWN = 3,  // disable all motors
+};
+
+enum SafetyCheck : uint8_t {
+    SAFETY_JOINT_LIMIT = 0,
+    SAFETY_VELOCITY,
+    SAFETY_TORQUE,
+    SAFETY_TEMPERATURE,
+    SAFETY_STALE,        // motor feedback or IMU sample older than stale_ms (motors: and than the stream start)
+    SAFETY_MOTOR_ERROR,  // motor reports an error code
+    SAFETY_FALL,         // projected gravity z above gravity_z_upper
+    SAFETY_NUM_CHECKS
+};
+
+struct SafetyCfg {
+    std::vector<float> q_min, q_max;      // joint limits, empty disables the check
+    std::vector<float> max_vel, max_tau;  // bounds of |velocity| and |torque| per joint, empty disables
+    float max_temperature = 0.0f;         // motor temperature, 0 disables
+    uint32_t stale_ms = 50;               // 0 disables
+    float gravity_z_upper = 1.0f;         // 1 or more disables
+    SafetyLevel response[SAFETY_NUM_CHECKS] = {
+        SafetyLevel::HOLD, SafetyLevel::DAMP, SafetyLevel::DAMP, SafetyLevel::DAMP,
+        SafetyLevel::POWER_DOWN, SafetyLevel::POWER_DOWN, SafetyLevel::DAMP,
+    };
+};
+
+// One PD tick. Joint values are in joint space, the rest per motor, all arrays of the supervisor size.
+struct SafetyInput {
+    const float *q, *vel, *tau;
+    const float* temperature;
+    const uint8_t* error_id;
+    const uint64_t* rx_time_ns;
+    const float* quat;  // w, x, y, z of the newest IMU sample, nullptr before the first one
+    uint64_t imu_stamp_ns;
+    uint64_t now_ns;
+};
+
+struct SafetyEvent {
+    SafetyLevel level = SafetyLevel::OK;
+    SafetyCheck check = SAFETY_NUM_CHECKS;
+    int index = -1;  // joint or motor index, -1 for the IMU
+    float value = 0.0f;
+    uint64_t stamp_ns = 0;
+};
+
+struct SafetyStatus {
+    SafetyLevel level = SafetyLevel::OK;
+    SafetyEvent event;  // the fault that raised the supervisor to level
+    uint64_t ticks = 0, trips = 0;
+};
+
+/**
+ * Checks every PD tick that the robot stays within its limits.
+ *
+ * Each check is a branch-free scan over all joints (the loops vectorize), the offending joint is
+ * only searched for once a scan found something, so a tick without fault costs a few hundred
+ * nanoseconds. A fault raises the supervisor to the response configured for its check; the level
+ * stays latched until reset(). Motors only reply to commands, so motor feedback is not stale before
+ * stale_ms after the first evaluate() of a command stream, however old it is; a stream ends with
+ * reset() or end_stream(). Not thread safe, call from the PD thread.
+ */
+class SafetySupervisor {
+   public:
+    explicit SafetySupervisor(size_t size) : size_(size) {}
+
+    void configure(const SafetyCfg& cfg);
+    const SafetyCfg& get_cfg() const { return cfg_; }
+
+    // Returns the latched level, raised to the worst response of the faults found in this tick.
+    SafetyLevel evaluate(const SafetyInput& in);
+    void reset();
+    // The caller stopped sending commands, e.g. on pause. Does not clear the latched level.
+    void end_stream() { streaming_ = false; }
+    SafetyLevel level() const { return status_.level; }
+    const SafetyStatus& status() const { return status_; }
+
+    // robot.yaml names: off, damp, hold, power_down and joint_limit, velocity, ..., fall
+    static SafetyLevel parse_level(const std::string& name);
+    static SafetyCheck parse_check(const std::string& name);
+    static const char* level_name(SafetyLevel level);
+    static const char* check_name(SafetyCheck check);
+    // "joint 4 joint limit (1.73) -> hold"
+    static std::string describe(const SafetyEvent& event);
+
+   private:
+    size_t size_;
+    SafetyCfg cfg_;
+    SafetyStatus status_;
+    bool streaming_ = false;        // evaluate() ran since the last reset() / end_stream()
+    uint64_t stream_start_ns_ = 0;  // now_ns of the first of them
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+#include "rt_clock.hpp"
+
+// Time-indexed ring of the last N samples of one sensor.
+// Single producer (the RX thread of the sensor), any number of readers; neither side blocks.
+// Each slot is guarded by its own sequence counter and tagged with its write index, so a reader
+// detects both torn reads and slots that were overwritten while it was walking back in time.
+template <typename T, size_t N>
+class SampleHistory {
+    static_assert(std::is_trivially_copyable<T>::value, "SampleHistory requires a POD sample type");
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SampleHistory size must be a power of two");
+
+   public:
+    struct Entry {
+        uint64_t stamp_ns;
+        T value;
+    };
+
+    void push(uint64_t stamp_ns, const T& value) {
+        uint64_t index = head_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[index & (N - 1)];
+        uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+        slot.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.index = index;
+        slot.entry.stamp_ns = stamp_ns;
+        slot.entry.value = value;
+        slot.seq.store(seq + 2, std::memory_order_release);
+        head_.store(index + 1, std::memory_order_release);
+    }
+
+    // total number of samples pushed so far
+    uint64_t count() const { return head_.load(std::memory_order_acquire); }
+
+    bool latest(Entry& out) const {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        return head > 0 && read(head - 1, out);
+    }
+
+    // newest sample stamped at or before t_ns
+    bool latest_before(uint64_t t_ns, Entry& out) const {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        uint64_t tail = head > N ? head - N : 0;
+        for (uint64_t i = head; i > tail; i--) {
+            if (!read(i - 1, out)) {
+                return false;
+            }
+            if (out.stamp_ns <= t_ns) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Two consecutive samples a, b around t_ns (a.stamp <= t_ns < b.stamp) for interpolation.
+    // When t_ns is past the newest sample, a and b are the two newest samples (extrapolation),
+    // when it is older than the history, a and b are the two oldest. Returns the number of valid
+    // samples written (0, 1 when only one sample exists, or 2).
+    int bracket(uint64_t t_ns, Entry& a, Entry& b) const {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        if (head == 0 || !read(head - 1, b)) {
+            return 0;
+        }
+        uint64_t tail = head > N ? head - N : 0;
+        for (uint64_t i = head - 1; i > tail; i--) {
+            if (!read(i - 1, a)) {
+                return 1;
+            }
+            if (a.stamp_ns <= t_ns) {
+                return 2;
+            }
+            b = a;
+        }
+        if (head - 1 == tail) {
+            a = b;
+            return 1;
+        }
+        return read(tail, a) && read(tail + 1, b) ? 2 : 1;
+    }
+
+   private:
+    struct Slot {
+        std::atomic<uint32_t> seq{0};
+        uint64_t index = 0;
+        Entry entry{};
+    };
+
+    bool read(uint64_t index, Entry& out) const {
+        const Slot& slot = slots_[index & (N - 1)];
+        for (;;) {
+            uint32_t seq0 = slot.seq.load(std::memory_order_acquire);
+            if (seq0 & 1u) {
+                continue;
+            }
+            uint64_t slot_index = slot.index;
+            out = slot.entry;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == seq0) {
+                return slot_index == index;
+            }
+        }
+    }
+
+    std::array<Slot, N> slots_;
+    std::atomic<uint64_t> head_{0};
+};
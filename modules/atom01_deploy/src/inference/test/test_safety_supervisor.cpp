@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "safety_supervisor.hpp"
+
+namespace {
+
+constexpr uint64_t ms = 1000000ull;
+
+// Two joints at rest with fresh feedback, tests change what they check.
+struct Tick {
+    std::vector<float> q{0.0f, 0.0f}, vel{0.0f, 0.0f}, tau{0.0f, 0.0f}, temperature{30.0f, 30.0f};
+    std::vector<uint8_t> error_id{0, 0};
+    std::vector<uint64_t> rx_time_ns{0, 0};
+    float quat[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+    uint64_t imu_stamp_ns = 0, now_ns = 0;
+
+    SafetyInput input() const {
+        return {q.data(), vel.data(), tau.data(), temperature.data(), error_id.data(), rx_time_ns.data(),
+                quat, imu_stamp_ns, now_ns};
+    }
+    void at(uint64_t now, uint64_t rx) {
+        now_ns = now;
+        imu_stamp_ns = now;
+        rx_time_ns.assign(rx_time_ns.size(), rx);
+    }
+};
+
+}  // namespace
+
+TEST(SafetySupervisor, FreshFeedbackPasses) {
+    SafetySupervisor safety(2);
+    Tick tick;
+    tick.at(1000 * ms, 999 * ms);
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::OK);
+    EXPECT_EQ(safety.status().ticks, 1u);
+}
+
+// reset_joints holds the default pose without commands, so the motors stop replying; the first
+// tick after start must not see that gap as stale feedback.
+TEST(SafetySupervisor, StartAfterResetDoesNotTrip) {
+    SafetySupervisor safety(2);
+    Tick tick;
+    tick.at(1000 * ms, 999 * ms);
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::OK);
+    safety.reset();
+    tick.at(5000 * ms, 1000 * ms);  // B pressed 4 s after the last reply
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::OK);
+    tick.at(5040 * ms, 1000 * ms);
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::OK);
+    tick.at(5042 * ms, 5041 * ms);  // replies to the new commands
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::OK);
+}
+
+// Pausing sends no commands either, with the watchdog off (watchdog_timeout_ms: 0) nothing reaches
+// the motors; resuming must not see that gap as stale feedback.
+TEST(SafetySupervisor, ResumeAfterPauseDoesNotTrip) {
+    SafetySupervisor safety(2);
+    Tick tick;
+    tick.at(1000 * ms, 999 * ms);
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::OK);
+    safety.end_stream();
+    tick.at(5000 * ms, 1000 * ms);
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::OK);
+    tick.at(5040 * ms, 1000 * ms);
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::OK);
+    tick.at(5042 * ms, 5041 * ms);
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::OK);
+}
+
+TEST(SafetySupervisor, EndStreamKeepsTheLatchedLevel) {
+    SafetySupervisor safety(2);
+    Tick tick;
+    tick.at(1000 * ms, 999 * ms);
+    tick.error_id[0] = 1;
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::POWER_DOWN);
+    safety.end_stream();
+    tick.error_id[0] = 0;
+    tick.at(5000 * ms, 4999 * ms);
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::POWER_DOWN);
+}
+
+TEST(SafetySupervisor, NoRepliesAfterStartTrip) {
+    SafetySupervisor safety(2);
+    Tick tick;
+    tick.at(5000 * ms, 1000 * ms);
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::OK);
+    tick.at(5051 * ms, 1000 * ms);
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::POWER_DOWN);
+    EXPECT_EQ(safety.status().event.check, SAFETY_STALE);
+    EXPECT_EQ(safety.status().event.index, 0);
+}
+
+TEST(SafetySupervisor, RepliesStoppingWhileStreamingTrip) {
+    SafetySupervisor safety(2);
+    Tick tick;
+    tick.at(1000 * ms, 999 * ms);
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::OK);
+    tick.at(2000 * ms, 1999 * ms);
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::OK);
+    tick.at(2060 * ms, 1999 * ms);
+    tick.rx_time_ns[0] = 2059 * ms;
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::POWER_DOWN);
+    EXPECT_EQ(safety.status().event.index, 1);
+}
+
+TEST(SafetySupervisor, StaleImuIsNotExcusedByStreamStart) {
+    SafetySupervisor safety(2);
+    Tick tick;
+    tick.at(5000 * ms, 4999 * ms);
+    tick.imu_stamp_ns = 4000 * ms;
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::POWER_DOWN);
+    EXPECT_EQ(safety.status().event.index, -1);
+}
+
+TEST(SafetySupervisor, LevelLatchesUntilReset) {
+    SafetySupervisor safety(2);
+    SafetyCfg cfg;
+    cfg.q_min = {-1.0f, -1.0f};
+    cfg.q_max = {1.0f, 1.0f};
+    safety.configure(cfg);
+    Tick tick;
+    tick.at(1000 * ms, 1000 * ms);
+    tick.q[1] = NAN;
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::HOLD);
+    EXPECT_EQ(safety.status().event.check, SAFETY_JOINT_LIMIT);
+    tick.q[1] = 0.0f;
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::HOLD);
+    safety.reset();
+    EXPECT_EQ(safety.evaluate(tick.input()), SafetyLevel::OK);
+    EXPECT_EQ(safety.status().trips, 1u);
+}
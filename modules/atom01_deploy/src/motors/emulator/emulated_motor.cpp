@@ -0,0 +1,352 @@
+#include "emulated_motor.hpp"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr float STEP_S = 0.0002f;             // integration step of the joint
+constexpr float MAX_CATCH_UP_S = 0.1f;        // longer gaps are integrated as this long
+constexpr float THERMAL_TIME_CONST_S = 60.f;
+constexpr float FULL_TORQUE_HEATING_K = 100.f;  // steady state coil temperature rise at TauMax
+constexpr float SPEED_LOOP_BANDWIDTH = 50.f;    // rad/s, internal loop of the position / speed modes
+constexpr float POSITION_LOOP_GAIN = 20.f;      // 1/s
+
+uint32_t float_bits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float bits_float(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint32_t le32(const uint8_t* data) {
+    return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 | static_cast<uint32_t>(data[2]) << 16 |
+           static_cast<uint32_t>(data[3]) << 24;
+}
+
+void put_le32(uint8_t* data, uint32_t value) {
+    data[0] = value & 0xFF;
+    data[1] = (value >> 8) & 0xFF;
+    data[2] = (value >> 16) & 0xFF;
+    data[3] = (value >> 24) & 0xFF;
+}
+
+// same quantization as the drivers
+uint16_t to_uint(float value, float min, float max, int bits) {
+    return range_map(limit(value, min, max), min, max, uint16_t(0), bitmax<uint16_t>(bits));
+}
+
+float to_float(uint16_t value, float min, float max, int bits) {
+    return range_map(value, uint16_t(0), bitmax<uint16_t>(bits), min, max);
+}
+
+bool is_special(const can_frame& frame) {
+    for (int i = 0; i < 7; i++) {
+        if (frame.data[i] != 0xFF) return false;
+    }
+    return frame.can_dlc == 8;
+}
+
+}  // namespace
+
+EmulatedMotor::EmulatedMotor(uint16_t motor_id, const std::string& motor_type, int motor_model, uint16_t master_id_offset)
+    : motor_id_(motor_id), master_id_(motor_id + master_id_offset), model_(motor_model) {
+    if (motor_type == "DM") {
+        dm_ = true;
+        if (motor_model < 0 || motor_model >= Num_Of_Motor) {
+            throw std::runtime_error("Unknown DM motor model " + std::to_string(motor_model));
+        }
+        const DM_Limit_Param& p = limit_param[motor_model];
+        limits_ = {p.PosMax, p.SpdMax, p.TauMax, p.OKpMax, p.OKdMax};
+        registers_[OT_Value] = float_bits(120.f);
+        registers_[MST_ID] = master_id_;
+        registers_[ESC_ID] = motor_id_;
+        registers_[TIMEOUT] = 0;
+        registers_[CTRL_MODE] = MotorDriver::MIT;
+        registers_[PMAX] = float_bits(limits_.pos);
+        registers_[VMAX] = float_bits(limits_.spd);
+        registers_[TMAX] = float_bits(limits_.tau);
+        registers_[can_br] = 4;  // 1 Mbit/s
+    } else if (motor_type == "EVO") {
+        dm_ = false;
+        master_id_ = motor_id;
+        if (motor_model < 0 || motor_model >= EVO_Num_Of_Model) {
+            throw std::runtime_error("Unknown EVO motor model " + std::to_string(motor_model));
+        }
+        const EVO_Limit_Param& p = evo_limit_param[motor_model];
+        limits_ = {p.PosMax, p.SpdMax, p.TauMax, p.OKpMax, p.OKdMax};
+        // EVO_Flash_Param order, the inner loop gains and current limits are placeholders
+        const float flash[] = {limits_.pos, -limits_.pos, limits_.spd, -limits_.spd, limits_.tau, -limits_.tau,
+                               limits_.kp,  0.f,          limits_.kd,  0.f,          1.f,         0.f,
+                               1.f,         0.f,          limits_.tau, -limits_.tau};
+        for (uint32_t i = 0; i < sizeof(flash) / sizeof(flash[0]); i++) {
+            objects_[static_cast<uint32_t>(EVO_PARAM_INDEX + i) << 8] = float_bits(flash[i]);
+        }
+    } else {
+        throw std::runtime_error("Motor type not supported");
+    }
+    // rough reflected inertia and losses, larger for the high torque models
+    inertia_ = 0.002f * limits_.tau;
+    damping_ = 0.02f * limits_.tau;
+    friction_ = 0.01f * limits_.tau;
+    heat_gain_ = FULL_TORQUE_HEATING_K / (limits_.tau * limits_.tau * THERMAL_TIME_CONST_S);
+}
+
+std::vector<canid_t> EmulatedMotor::command_ids() const {
+    if (dm_) {
+        return {motor_id_, static_cast<canid_t>(0x100 + motor_id_), static_cast<canid_t>(0x200 + motor_id_), 0x7FF};
+    }
+    return {motor_id_, static_cast<canid_t>(0x600 + motor_id_)};
+}
+
+void EmulatedMotor::inject_fault(uint8_t code) {
+    error_ = code;
+    enabled_ = false;
+}
+
+void EmulatedMotor::handle(const can_frame& frame, uint64_t now_ns, std::vector<can_frame>& replies) {
+    step(now_ns);
+    if (dm_) {
+        handle_dm(frame, now_ns, replies);
+    } else {
+        handle_evo(frame, now_ns, replies);
+    }
+}
+
+// Every frame to the motor is answered with a feedback frame on the master ID, register
+// requests with the register value.
+void EmulatedMotor::handle_dm(const can_frame& frame, uint64_t now_ns, std::vector<can_frame>& replies) {
+    canid_t id = frame.can_id & CAN_SFF_MASK;
+    if (id == 0x7FF) {
+        handle_dm_register(frame, replies);
+        return;
+    }
+    last_cmd_ns_ = now_ns;
+    if (id == motor_id_) {
+        if (!handle_special(frame) && frame.can_dlc == 8) {
+            decode_mit(frame);
+        }
+    } else if (id == 0x100u + motor_id_ && frame.can_dlc == 8) {
+        cmd_p_ = bits_float(le32(frame.data));
+        cmd_v_ = std::fabs(bits_float(le32(frame.data + 4)));
+    } else if (id == 0x200u + motor_id_ && frame.can_dlc >= 4) {
+        cmd_v_ = bits_float(le32(frame.data));
+    }
+    replies.push_back(feedback());
+}
+
+void EmulatedMotor::handle_dm_register(const can_frame& frame, std::vector<can_frame>& replies) {
+    uint8_t cmd = frame.data[2];
+    uint8_t rid = frame.data[3];
+    if (rid >= registers_.size()) {
+        return;
+    }
+    can_frame reply{};
+    reply.can_id = master_id_;
+    reply.can_dlc = 8;
+    reply.data[0] = motor_id_ & 0xFF;
+    reply.data[1] = motor_id_ >> 8;
+    reply.data[2] = cmd;
+    reply.data[3] = rid;
+    switch (cmd) {
+        case 0x33:  // read
+            put_le32(reply.data + 4, registers_[rid]);
+            break;
+        case 0x55:  // write, echoes the stored value
+            registers_[rid] = le32(frame.data + 4);
+            if (rid == CTRL_MODE) mode_ = static_cast<uint8_t>(registers_[rid]);
+            if (rid == PMAX) limits_.pos = bits_float(registers_[rid]);
+            if (rid == VMAX) limits_.spd = bits_float(registers_[rid]);
+            if (rid == TMAX) limits_.tau = bits_float(registers_[rid]);
+            put_le32(reply.data + 4, registers_[rid]);
+            break;
+        case 0xAA:  // save to flash
+            put_le32(reply.data + 4, 1);
+            break;
+        case 0xCC:  // refresh: plain feedback frame
+            replies.push_back(feedback());
+            return;
+        default:
+            return;
+    }
+    replies.push_back(reply);
+}
+
+// MIT and special frames on the motor ID and SDO requests on 0x600 + ID. Feedback and SDO
+// responses share the motor ID / 0x580 + ID.
+void EmulatedMotor::handle_evo(const can_frame& frame, uint64_t now_ns, std::vector<can_frame>& replies) {
+    canid_t id = frame.can_id & CAN_SFF_MASK;
+    if (id == 0x600u + motor_id_) {
+        handle_evo_sdo(frame, replies);
+        return;
+    }
+    last_cmd_ns_ = now_ns;
+    if (!handle_special(frame) && frame.can_dlc == 8) {
+        decode_mit(frame);
+    }
+    replies.push_back(feedback());
+}
+
+void EmulatedMotor::handle_evo_sdo(const can_frame& frame, std::vector<can_frame>& replies) {
+    uint16_t index = frame.data[1] | frame.data[2] << 8;
+    uint8_t subindex = frame.data[3];
+    uint32_t key = static_cast<uint32_t>(index) << 8 | subindex;
+    can_frame reply{};
+    reply.can_id = 0x580 + motor_id_;
+    reply.can_dlc = 8;
+    reply.data[1] = frame.data[1];
+    reply.data[2] = frame.data[2];
+    reply.data[3] = subindex;
+    uint8_t ccs = frame.data[0] & 0xE0;
+    if (ccs == 0x40) {  // upload
+        auto it = objects_.find(key);
+        if (it == objects_.end()) {
+            reply.data[0] = 0x80;
+            put_le32(reply.data + 4, 0x06020000);  // object does not exist
+        } else {
+            reply.data[0] = 0x43;
+            put_le32(reply.data + 4, it->second);
+        }
+    } else if (ccs == 0x20) {  // expedited download
+        if (index != 0x1010) {  // 0x1010 "save" only acknowledges
+            objects_[key] = le32(frame.data + 4);
+        }
+        reply.data[0] = 0x60;
+    } else {
+        return;
+    }
+    replies.push_back(reply);
+}
+
+bool EmulatedMotor::handle_special(const can_frame& frame) {
+    if (!is_special(frame)) {
+        return false;
+    }
+    switch (frame.data[7]) {
+        case 0xFC:
+            if (error_ == 0) enabled_ = true;
+            break;
+        case 0xFD:
+            enabled_ = false;
+            if (!dm_) error_ = 0;  // EVO reset mode also clears errors
+            break;
+        case 0xFE:
+            zero_ = q_;
+            break;
+        case 0xFB:
+            if (dm_) error_ = 0;
+            break;
+        default:
+            return false;
+    }
+    cmd_p_ = cmd_v_ = cmd_kp_ = cmd_kd_ = cmd_t_ = 0.f;
+    return true;
+}
+
+void EmulatedMotor::decode_mit(const can_frame& frame) {
+    const uint8_t* d = frame.data;
+    uint16_t p, v, kp, kd, t;
+    int kd_bits = 12;
+    if (dm_ || model_ == EVO431040) {
+        p = d[0] << 8 | d[1];
+        v = d[2] << 4 | d[3] >> 4;
+        kp = (d[3] & 0x0F) << 8 | d[4];
+        kd = d[5] << 4 | d[6] >> 4;
+        t = (d[6] & 0x0F) << 8 | d[7];
+    } else {
+        kp = (d[0] & 0x1F) << 7 | d[1] >> 1;
+        kd = (d[1] & 0x01) << 8 | d[2];
+        kd_bits = 9;
+        p = d[3] << 8 | d[4];
+        v = d[5] << 4 | d[6] >> 4;
+        t = (d[6] & 0x0F) << 8 | d[7];
+    }
+    cmd_p_ = to_float(p, -limits_.pos, limits_.pos, 16);
+    cmd_v_ = to_float(v, -limits_.spd, limits_.spd, 12);
+    cmd_kp_ = to_float(kp, 0.f, limits_.kp, 12);
+    cmd_kd_ = to_float(kd, 0.f, limits_.kd, kd_bits);
+    cmd_t_ = to_float(t, -limits_.tau, limits_.tau, 12);
+}
+
+can_frame EmulatedMotor::feedback() const {
+    uint16_t p = to_uint(position(), -limits_.pos, limits_.pos, 16);
+    uint16_t v = to_uint(dq_, -limits_.spd, limits_.spd, 12);
+    uint16_t t = to_uint(tau_, -limits_.tau, limits_.tau, 12);
+    can_frame frame{};
+    frame.can_id = master_id_;
+    frame.can_dlc = 8;
+    frame.data[1] = p >> 8;
+    frame.data[2] = p & 0xFF;
+    frame.data[3] = v >> 4;
+    frame.data[4] = (v & 0x0F) << 4 | t >> 8;
+    frame.data[5] = t & 0xFF;
+    uint8_t mos = static_cast<uint8_t>(std::lround(limit(mos_temp_, 0.f, 255.f)));
+    uint8_t coil = static_cast<uint8_t>(std::lround(limit(coil_temp_, 0.f, 255.f)));
+    if (dm_) {
+        uint8_t state = error_ != 0 ? error_ : static_cast<uint8_t>(enabled_ ? DM_UP : DM_DOWN);
+        frame.data[0] = static_cast<uint8_t>(state << 4 | (motor_id_ & 0x0F));
+        frame.data[6] = mos;
+        frame.data[7] = coil;
+    } else {
+        frame.data[0] = motor_id_ & 0xFF;
+        frame.data[6] = error_;
+        frame.data[7] = mos;
+    }
+    return frame;
+}
+
+float EmulatedMotor::control_torque() const {
+    if (!enabled_ || error_ != 0) {
+        return 0.f;
+    }
+    float pos = position();
+    float speed_gain = SPEED_LOOP_BANDWIDTH * inertia_;
+    switch (mode_) {
+        case MotorDriver::MIT:
+            return cmd_kp_ * (cmd_p_ - pos) + cmd_kd_ * (cmd_v_ - dq_) + cmd_t_;
+        case MotorDriver::POS: {
+            float target_speed = limit(POSITION_LOOP_GAIN * (cmd_p_ - pos), -cmd_v_, cmd_v_);
+            return speed_gain * (target_speed - dq_);
+        }
+        case MotorDriver::SPD:
+            return speed_gain * (cmd_v_ - dq_);
+        default:
+            return 0.f;
+    }
+}
+
+void EmulatedMotor::step(uint64_t now_ns) {
+    if (last_step_ns_ == 0 || now_ns <= last_step_ns_) {
+        last_step_ns_ = std::max(last_step_ns_, now_ns);
+        return;
+    }
+    float elapsed = std::min(static_cast<float>(now_ns - last_step_ns_) * 1e-9f, MAX_CATCH_UP_S);
+    last_step_ns_ = now_ns;
+
+    // DM TIMEOUT register counts 50 us, the motor drops out of control without commands
+    uint32_t timeout = dm_ ? registers_[TIMEOUT] : 0;
+    if (enabled_ && timeout != 0 && now_ns - last_cmd_ns_ > static_cast<uint64_t>(timeout) * 50000ull) {
+        inject_fault(LOST_CONN);
+    }
+
+    while (elapsed > 0.f) {
+        float h = std::min(elapsed, STEP_S);
+        elapsed -= h;
+        tau_ = limit(control_torque(), -limits_.tau, limits_.tau);
+        float friction = friction_ * std::tanh(dq_ / 0.01f);
+        dq_ += (tau_ - damping_ * dq_ - friction) / inertia_ * h;
+        q_ += dq_ * h;
+        coil_temp_ += (heat_gain_ * tau_ * tau_ - (coil_temp_ - ambient_temp_) / THERMAL_TIME_CONST_S) * h;
+    }
+    mos_temp_ = ambient_temp_ + 0.5f * (coil_temp_ - ambient_temp_);
+
+    float coil_limit = dm_ ? bits_float(registers_[OT_Value]) : 120.f;
+    if (coil_temp_ > coil_limit && error_ == 0) {
+        inject_fault(dm_ ? static_cast<uint8_t>(COIL_OVER_TEMP) : static_cast<uint8_t>(EVO_COIL_OVER_TEMP));
+    }
+}
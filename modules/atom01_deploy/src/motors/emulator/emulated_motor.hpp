@@ -0,0 +1,68 @@
+#pragma once
+
+#include <linux/can.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "dm_motor_driver.hpp"
+#include "evo_motor_driver.hpp"
+
+// Firmware and joint of one DM or EVO motor as seen from the bus. No I/O: frames addressed to the
+// motor go in through handle(), the replies it would send come out, the bus decides when they go.
+class EmulatedMotor {
+   public:
+    EmulatedMotor(uint16_t motor_id, const std::string& motor_type, int motor_model, uint16_t master_id_offset);
+
+    // Standard IDs the motor accepts frames on. DM register frames on 0x7FF are shared by all DM
+    // motors of a bus and carry the motor ID in the payload.
+    std::vector<canid_t> command_ids() const;
+    uint16_t get_motor_id() const { return motor_id_; }
+    bool is_dm() const { return dm_; }
+
+    // Advances the joint to now_ns and appends the replies to frame to replies.
+    void handle(const can_frame& frame, uint64_t now_ns, std::vector<can_frame>& replies);
+    // Advances the joint to now_ns, checks the communication timeout and temperature limits.
+    void step(uint64_t now_ns);
+    // Latches a firmware error code (DMError / EVOError), the motor stops producing torque.
+    void inject_fault(uint8_t code);
+
+   private:
+    struct Limits {
+        float pos, spd, tau, kp, kd;
+    };
+
+    void handle_dm(const can_frame& frame, uint64_t now_ns, std::vector<can_frame>& replies);
+    void handle_dm_register(const can_frame& frame, std::vector<can_frame>& replies);
+    void handle_evo(const can_frame& frame, uint64_t now_ns, std::vector<can_frame>& replies);
+    void handle_evo_sdo(const can_frame& frame, std::vector<can_frame>& replies);
+    // 0xFC enable, 0xFD disable / reset, 0xFE zero, 0xFB clear error (DM)
+    bool handle_special(const can_frame& frame);
+    void decode_mit(const can_frame& frame);
+    can_frame feedback() const;
+    float control_torque() const;
+    float position() const { return q_ - zero_; }
+
+    uint16_t motor_id_, master_id_;
+    bool dm_;
+    int model_;
+    Limits limits_;
+
+    // firmware
+    bool enabled_ = false;
+    uint8_t mode_ = MotorDriver::MIT;
+    uint8_t error_ = 0;
+    float cmd_p_ = 0.f, cmd_v_ = 0.f, cmd_kp_ = 0.f, cmd_kd_ = 0.f, cmd_t_ = 0.f;
+    uint64_t last_cmd_ns_ = 0;
+    std::array<uint32_t, 128> registers_{};   // DM registers, raw 32 bit values
+    std::map<uint32_t, uint32_t> objects_;    // EVO SDO objects by index << 8 | subindex
+
+    // joint
+    float q_ = 0.f, dq_ = 0.f, zero_ = 0.f, tau_ = 0.f;
+    float inertia_, damping_, friction_;
+    float coil_temp_ = 30.f, mos_temp_ = 30.f, ambient_temp_ = 30.f, heat_gain_;
+    uint64_t last_step_ns_ = 0;
+};
@@ -0,0 +1,374 @@
+/**
+ * @file
+ * Emulates DM / EVO motors on (v)CAN interfaces, so the drivers, the CAN stack and the control
+ * loop can be run and benchmarked without hardware:
+ *
+ *   motor_emulator -t DM -m 1,1,1,1,0,0 can0:1-6 can1:7-12
+ *
+ * Each bus is served by one thread. vcan delivers frames instantly, so the emulator adds the
+ * serialization time of command and reply at the configured bitrate, the firmware reply delay
+ * and jitter, and keeps replies of one bus in order like a real bus would.
+ */
+
+#include <getopt.h>
+#include <net/if.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "can_stats.hpp"
+#include "emulated_motor.hpp"
+#include "utils.hpp"
+
+namespace {
+
+std::atomic<bool> running{true};
+
+struct EmulatorCfg {
+    std::string motor_type = "DM";
+    std::vector<int> motor_models;  // by position in the ID order of all buses, default model 0
+    uint16_t master_id_offset = 16;
+    uint32_t reply_delay_ns = 100000;
+    uint32_t jitter_ns = 20000;
+    uint32_t bitrate = CAN_DEFAULT_BITRATE;
+    double loss = 0.0;
+    double stats_period_s = 5.0;
+};
+
+struct FaultCfg {
+    uint16_t motor_id;
+    uint8_t code;
+    double at_s;
+};
+
+struct BusCfg {
+    std::string interface;
+    std::vector<uint16_t> motor_ids;
+};
+
+class EmulatedBus {
+   public:
+    EmulatedBus(const BusCfg& bus, const EmulatorCfg& cfg, const std::vector<int>& models,
+                std::vector<FaultCfg> faults, std::shared_ptr<spdlog::logger> logger)
+        : interface_(bus.interface), cfg_(cfg), faults_(std::move(faults)), logger_(logger),
+          rng_(std::hash<std::string>{}(bus.interface)) {
+        for (size_t i = 0; i < bus.motor_ids.size(); i++) {
+            motors_.emplace_back(bus.motor_ids[i], cfg.motor_type, models[i], cfg.master_id_offset);
+            for (canid_t id : motors_.back().command_ids()) {
+                if (id != 0x7FF) routes_[id] = i;
+            }
+            by_motor_id_[bus.motor_ids[i]] = i;
+        }
+        open_socket();
+    }
+
+    ~EmulatedBus() {
+        if (sockfd_ >= 0) ::close(sockfd_);
+    }
+
+    void run() {
+        std::vector<can_frame> replies;
+        uint64_t start_ns = monotonic_ns();
+        uint64_t next_stats_ns = start_ns + static_cast<uint64_t>(cfg_.stats_period_s * 1e9);
+        while (running.load(std::memory_order_relaxed)) {
+            uint64_t now = monotonic_ns();
+            // the joints keep moving between commands, 1 ms is enough for timeouts and faults
+            uint64_t wake_ns = now + 1000000;
+            if (!pending_.empty()) wake_ns = std::min(wake_ns, pending_.front().due_ns);
+            timespec timeout{0, static_cast<long>(wake_ns > now ? wake_ns - now : 0)};
+            pollfd pfd{sockfd_, POLLIN, 0};
+            int ret = ppoll(&pfd, 1, &timeout, nullptr);
+            if (ret < 0 && errno != EINTR) {
+                logger_->error("{}: poll failed: {}", interface_, strerror(errno));
+                break;
+            }
+
+            can_frame frame;
+            while (::recv(sockfd_, &frame, sizeof(frame), MSG_DONTWAIT) == sizeof(frame)) {
+                receive(frame, monotonic_ns(), replies);
+            }
+
+            now = monotonic_ns();
+            while (!pending_.empty() && pending_.front().due_ns <= now) {
+                if (::send(sockfd_, &pending_.front().frame, sizeof(can_frame), MSG_DONTWAIT) == sizeof(can_frame)) {
+                    tx_frames_++;
+                } else {
+                    tx_errors_++;
+                }
+                pending_.pop_front();
+            }
+
+            for (auto it = faults_.begin(); it != faults_.end();) {
+                if (now - start_ns >= static_cast<uint64_t>(it->at_s * 1e9)) {
+                    motors_[by_motor_id_.at(it->motor_id)].inject_fault(it->code);
+                    logger_->warn("{}: injected error 0x{:X} into motor {}", interface_, it->code, it->motor_id);
+                    it = faults_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            for (auto& motor : motors_) motor.step(now);
+
+            if (now >= next_stats_ns) {
+                double period = cfg_.stats_period_s;
+                logger_->info("{}: {} motors, rx {:.0f} fps, tx {:.0f} fps, load {:.1f}%, {} lost, {} tx errors",
+                              interface_, motors_.size(), (rx_frames_ - last_rx_) / period,
+                              (tx_frames_ - last_tx_) / period, 100.0 * bus_time_ns_ / (period * 1e9), lost_,
+                              tx_errors_);
+                last_rx_ = rx_frames_;
+                last_tx_ = tx_frames_;
+                bus_time_ns_ = 0;
+                next_stats_ns += static_cast<uint64_t>(period * 1e9);
+            }
+        }
+    }
+
+   private:
+    struct PendingFrame {
+        uint64_t due_ns;
+        can_frame frame;
+    };
+
+    void open_socket() {
+        sockfd_ = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+        if (sockfd_ < 0) {
+            throw std::runtime_error("Failed to create socket for " + interface_ + ": " + strerror(errno));
+        }
+        std::vector<can_filter> filters;
+        for (auto& route : routes_) filters.push_back({route.first, CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG});
+        if (motors_.front().is_dm()) filters.push_back({0x7FF, CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG});
+        if (setsockopt(sockfd_, SOL_CAN_RAW, CAN_RAW_FILTER, filters.data(), filters.size() * sizeof(can_filter)) < 0) {
+            throw std::runtime_error("Failed to set filters on " + interface_ + ": " + strerror(errno));
+        }
+        sockaddr_can addr{};
+        addr.can_family = AF_CAN;
+        addr.can_ifindex = if_nametoindex(interface_.c_str());
+        if (addr.can_ifindex == 0) {
+            throw std::runtime_error("No such interface " + interface_);
+        }
+        if (bind(sockfd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            throw std::runtime_error("Failed to bind to " + interface_ + ": " + strerror(errno));
+        }
+    }
+
+    uint64_t frame_ns(const can_frame& frame) const {
+        return static_cast<uint64_t>(can_frame_bits(frame)) * 1000000000ull / cfg_.bitrate;
+    }
+
+    void receive(const can_frame& frame, uint64_t now_ns, std::vector<can_frame>& replies) {
+        rx_frames_++;
+        canid_t id = frame.can_id & CAN_SFF_MASK;
+        size_t index;
+        if (id == 0x7FF) {
+            auto it = by_motor_id_.find(static_cast<uint16_t>(frame.data[0] | frame.data[1] << 8));
+            if (it == by_motor_id_.end()) return;
+            index = it->second;
+        } else {
+            auto it = routes_.find(id);
+            if (it == routes_.end()) return;
+            index = it->second;
+        }
+        uint64_t cmd_ns = frame_ns(frame);
+        bus_time_ns_ += cmd_ns;
+
+        replies.clear();
+        motors_[index].handle(frame, now_ns, replies);
+        for (const can_frame& reply : replies) {
+            if (cfg_.loss > 0.0 && uniform_(rng_) < cfg_.loss) {
+                lost_++;
+                continue;
+            }
+            // vcan delivers the command as soon as it is written, a real bus only after its
+            // serialization; the firmware answers after its processing delay, and a reply has to
+            // wait for the frames ahead of it
+            uint64_t jitter = cfg_.jitter_ns ? rng_() % (cfg_.jitter_ns + 1) : 0;
+            uint64_t start = std::max(now_ns + cmd_ns + cfg_.reply_delay_ns + jitter, bus_free_ns_);
+            uint64_t reply_ns = frame_ns(reply);
+            bus_free_ns_ = start + reply_ns;
+            bus_time_ns_ += reply_ns;
+            pending_.push_back({bus_free_ns_, reply});
+        }
+    }
+
+    std::string interface_;
+    const EmulatorCfg& cfg_;
+    std::vector<FaultCfg> faults_;
+    std::shared_ptr<spdlog::logger> logger_;
+    int sockfd_ = -1;
+    std::vector<EmulatedMotor> motors_;
+    std::unordered_map<canid_t, size_t> routes_;
+    std::unordered_map<uint16_t, size_t> by_motor_id_;
+    std::deque<PendingFrame> pending_;  // due times never decrease, bus_free_ns_ orders them
+    uint64_t bus_free_ns_ = 0;
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> uniform_{0.0, 1.0};
+    uint64_t rx_frames_ = 0, tx_frames_ = 0, tx_errors_ = 0, lost_ = 0, last_rx_ = 0, last_tx_ = 0, bus_time_ns_ = 0;
+};
+
+// "1-6", "1,2,5" or "1-3,7"
+std::vector<uint16_t> parse_ids(const std::string& text) {
+    std::vector<uint16_t> ids;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find(',', pos);
+        std::string item = text.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        size_t dash = item.find('-');
+        int first = std::stoi(item.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+        if (first < 1 || last > 0x7FF || first > last) {
+            throw std::runtime_error("Invalid motor ID range " + item);
+        }
+        for (int id = first; id <= last; id++) ids.push_back(static_cast<uint16_t>(id));
+        pos = end == std::string::npos ? text.size() : end + 1;
+    }
+    return ids;
+}
+
+std::vector<int> parse_models(const std::string& text) {
+    std::vector<int> models;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find(',', pos);
+        models.push_back(std::stoi(text.substr(pos, end == std::string::npos ? std::string::npos : end - pos)));
+        pos = end == std::string::npos ? text.size() : end + 1;
+    }
+    return models;
+}
+
+// "100us", "2ms", plain numbers are microseconds
+uint32_t parse_duration_ns(const std::string& text) {
+    size_t idx;
+    double value = std::stod(text, &idx);
+    std::string unit = text.substr(idx);
+    if (unit.empty() || unit == "us") return static_cast<uint32_t>(value * 1e3);
+    if (unit == "ns") return static_cast<uint32_t>(value);
+    if (unit == "ms") return static_cast<uint32_t>(value * 1e6);
+    throw std::runtime_error("Invalid duration " + text);
+}
+
+// ID:CODE[@SECONDS], CODE in hex
+FaultCfg parse_fault(const std::string& text) {
+    size_t colon = text.find(':');
+    if (colon == std::string::npos) {
+        throw std::runtime_error("Invalid fault " + text + ", expected ID:CODE[@SECONDS]");
+    }
+    size_t at = text.find('@', colon);
+    FaultCfg fault;
+    fault.motor_id = static_cast<uint16_t>(std::stoi(text.substr(0, colon)));
+    fault.code = static_cast<uint8_t>(std::stoi(text.substr(colon + 1, at - colon - 1), nullptr, 16));
+    fault.at_s = at == std::string::npos ? 0.0 : std::stod(text.substr(at + 1));
+    return fault;
+}
+
+void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [options] <interface>:<ids> ...\n"
+            "  -t, --type DM|EVO          motor family (default DM)\n"
+            "  -m, --models LIST          model per motor in ID order, as motor_model in robot.yaml (default 0)\n"
+            "  -o, --master-offset N      DM feedback ID offset (default 16)\n"
+            "  -d, --reply-delay T        firmware reply delay, ns/us/ms (default 100us)\n"
+            "  -j, --jitter T             uniform extra reply delay (default 20us)\n"
+            "  -b, --bitrate BPS          emulated bitrate (default 1000000)\n"
+            "  -l, --loss P               reply loss probability (default 0)\n"
+            "  -f, --fault ID:CODE[@S]    latch error CODE (hex) on motor ID after S seconds\n"
+            "  -s, --stats S              statistics period in seconds (default 5)\n"
+            "Example: %s -t DM -m 1,1,1,1,0,0 can0:1-6\n",
+            name, name);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    auto logger = setup_logger({}, "motor_emulator");
+    EmulatorCfg cfg;
+    std::vector<FaultCfg> faults;
+    const option options[] = {{"type", required_argument, nullptr, 't'},
+                              {"models", required_argument, nullptr, 'm'},
+                              {"master-offset", required_argument, nullptr, 'o'},
+                              {"reply-delay", required_argument, nullptr, 'd'},
+                              {"jitter", required_argument, nullptr, 'j'},
+                              {"bitrate", required_argument, nullptr, 'b'},
+                              {"loss", required_argument, nullptr, 'l'},
+                              {"fault", required_argument, nullptr, 'f'},
+                              {"stats", required_argument, nullptr, 's'},
+                              {"help", no_argument, nullptr, 'h'},
+                              {nullptr, 0, nullptr, 0}};
+    std::vector<BusCfg> buses;
+    try {
+        int opt;
+        while ((opt = getopt_long(argc, argv, "t:m:o:d:j:b:l:f:s:h", options, nullptr)) != -1) {
+            switch (opt) {
+                case 't': cfg.motor_type = optarg; break;
+                case 'm': cfg.motor_models = parse_models(optarg); break;
+                case 'o': cfg.master_id_offset = static_cast<uint16_t>(std::stoi(optarg)); break;
+                case 'd': cfg.reply_delay_ns = parse_duration_ns(optarg); break;
+                case 'j': cfg.jitter_ns = parse_duration_ns(optarg); break;
+                case 'b': cfg.bitrate = static_cast<uint32_t>(std::stoul(optarg)); break;
+                case 'l': cfg.loss = std::stod(optarg); break;
+                case 'f': faults.push_back(parse_fault(optarg)); break;
+                case 's': cfg.stats_period_s = std::stod(optarg); break;
+                default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+            }
+        }
+        for (int i = optind; i < argc; i++) {
+            std::string arg = argv[i];
+            size_t colon = arg.find(':');
+            if (colon == std::string::npos) {
+                throw std::runtime_error("Invalid bus " + arg + ", expected <interface>:<ids>");
+            }
+            buses.push_back({arg.substr(0, colon), parse_ids(arg.substr(colon + 1))});
+        }
+    } catch (const std::exception& e) {
+        logger->error("{}", e.what());
+        usage(argv[0]);
+        return 1;
+    }
+    if (buses.empty() || cfg.bitrate == 0 || cfg.stats_period_s <= 0.0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<EmulatedBus>> emulated;
+    size_t motor_index = 0;
+    try {
+        for (const BusCfg& bus : buses) {
+            std::vector<int> models;
+            std::vector<FaultCfg> bus_faults;
+            for (uint16_t id : bus.motor_ids) {
+                models.push_back(motor_index < cfg.motor_models.size() ? cfg.motor_models[motor_index] : 0);
+                motor_index++;
+                for (const FaultCfg& fault : faults) {
+                    if (fault.motor_id == id) bus_faults.push_back(fault);
+                }
+            }
+            emulated.push_back(std::make_unique<EmulatedBus>(bus, cfg, models, bus_faults, logger));
+            logger->info("Emulating {} {} motors on {}", bus.motor_ids.size(), cfg.motor_type, bus.interface);
+        }
+    } catch (const std::exception& e) {
+        logger->error("{}", e.what());
+        return 1;
+    }
+
+    struct sigaction action {};
+    action.sa_handler = [](int) { running.store(false); };
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::vector<std::thread> threads;
+    for (auto& bus : emulated) threads.emplace_back(&EmulatedBus::run, bus.get());
+    for (auto& thread : threads) thread.join();
+    logger->info("Motor emulator stopped");
+    return 0;
+}
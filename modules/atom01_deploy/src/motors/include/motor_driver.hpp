@@ -4,14 +4,31 @@
 #include <stdint.h>
 #include <string.h>
 #include <iostream>
+#include <atomic>
 #include <cmath>
 #include <functional>
+#include <future>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "mit_codec.hpp"
+#include "motor_register.hpp"
+#include "motor_sequence.hpp"
 #include "utils.hpp"
 
+struct MotorFeedback {
+    uint64_t rx_time_ns;  // CLOCK_MONOTONIC when the feedback frame was received
+    float pos;
+    float spd;
+    float current;
+    float temperature;
+    uint8_t error_id;
+};
+
+using MotorFeedbackCbk = std::function<void(const MotorFeedback&)>;
+
 class MotorDriver {
    public:
     enum MotorControlMode_e {
@@ -86,6 +103,64 @@ class MotorDriver {
      * @param param_cmd The command code specifying which parameter to retrieve.
      */
     virtual void get_motor_param(uint8_t param_cmd) = 0;
+
+    /**
+     * @brief Reads a register (DM: DM_REG, EVO: SDO index with subindex 0).
+     *
+     * The reply updates the register cache and is passed to cbk. The callback also runs, with
+     * ok = false, when the request is replaced by a newer one of the same register or expired.
+     *
+     * @param reg The register to read.
+     * @param cbk Called with the result, may be empty.
+     */
+    void read_register(uint16_t reg, RegisterCbk cbk) {
+        registers_.begin(reg, std::move(cbk), false, 0, monotonic_ns());
+        send_register_read(reg);
+    }
+
+    /**
+     * @brief Writes a register, the value is cached once the motor acknowledges it.
+     *
+     * @param reg The register to write.
+     * @param raw The 32 bit value, float registers as IEEE bits.
+     * @param cbk Called with the result, may be empty.
+     */
+    void write_register(uint16_t reg, uint32_t raw, RegisterCbk cbk) {
+        registers_.begin(reg, std::move(cbk), true, raw, monotonic_ns());
+        send_register_write(reg, raw);
+    }
+
+    // Future flavours of the above. Wait with a timeout: a request without reply stays open
+    // until it is replaced or expire_registers() fails it.
+    std::future<RegisterResult> read_register_async(uint16_t reg) {
+        auto promise = std::make_shared<std::promise<RegisterResult>>();
+        std::future<RegisterResult> future = promise->get_future();
+        read_register(reg, [promise](const RegisterResult& result) { promise->set_value(result); });
+        return future;
+    }
+
+    std::future<RegisterResult> write_register_async(uint16_t reg, uint32_t raw) {
+        auto promise = std::make_shared<std::promise<RegisterResult>>();
+        std::future<RegisterResult> future = promise->get_future();
+        write_register(reg, raw, [promise](const RegisterResult& result) { promise->set_value(result); });
+        return future;
+    }
+
+    // Fails the register requests that are open for longer than timeout_ms.
+    void expire_registers(uint32_t timeout_ms) {
+        registers_.expire(monotonic_ns() - static_cast<uint64_t>(timeout_ms) * 1000000ull);
+    }
+
+    /**
+     * @brief Retrieves the last value read from or acknowledged by the motor.
+     *
+     * @return false if the register was never read or written.
+     */
+    bool get_cached_register(uint16_t reg, uint32_t& raw) const { return registers_.cached(reg, raw); }
+    std::map<uint16_t, uint32_t> get_register_cache() const { return registers_.cache(); }
+
+    // Registers of the configuration, as read by read_all_registers().
+    virtual std::vector<uint16_t> register_ids() const = 0;
     // to enum and union
 
     /**
@@ -139,7 +214,7 @@ class MotorDriver {
      *
      * @return The count of responses received from the motor.
      */
-    virtual int get_response_count() const = 0;
+    virtual int get_response_count() const { return response_count_; }
     virtual void refresh_motor_status() = 0;
 
 
@@ -208,12 +283,97 @@ class MotorDriver {
      */
     virtual float get_motor_temperature() { return motor_temperature_; }
 
+    /**
+     * @brief Retrieves the receive time of the latest feedback frame.
+     *
+     * @return CLOCK_MONOTONIC in nanoseconds, 0 before the first feedback.
+     */
+    uint64_t get_feedback_time_ns() const { return rx_time_ns_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Retrieves the interface the motor is connected to.
+     *
+     * @return The interface name, e.g. can0.
+     */
+    const std::string& get_interface() const { return can_interface_; }
+
     virtual void clear_motor_error() = 0;
 
+    /**
+     * @brief Steps of the motor procedures, for running many motors at once with MotorSequencer.
+     *
+     * init: disable, select MIT mode, enable and check that the motor reports no error.
+     * zero: set the zero, check that the position reads zero, disable.
+     * clear_error: clear the error and check that the motor reports none.
+     * deinit: disable.
+     */
+    virtual std::vector<MotorStep> init_steps() = 0;
+    virtual std::vector<MotorStep> zero_steps() = 0;
+    virtual std::vector<MotorStep> clear_error_steps() = 0;
+    virtual std::vector<MotorStep> deinit_steps() = 0;
+
+    /**
+     * @brief Retrieves the number of frames received from the motor, of any kind.
+     *
+     * @return A counter that wraps around, compare for inequality.
+     */
+    uint32_t get_reply_seq() const { return reply_seq_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Registers a callback for decoded feedback frames.
+     *
+     * The callback runs on the CAN RX thread for every feedback frame, after the motor state
+     * has been updated, and receives the state stamped with the receive time. It must not block.
+     * Set it once, before the motor is commanded.
+     *
+     * @param cbk The callback to invoke.
+     */
+    void set_feedback_callback(MotorFeedbackCbk cbk) {
+        feedback_cbk_ = std::move(cbk);
+        has_feedback_cbk_.store(true, std::memory_order_release);
+    }
+
    protected:
+    friend class MotorGroup;
+
+    // Transmit a register request, the reply is passed to registers_.complete().
+    virtual void send_register_read(uint16_t reg) = 0;
+    virtual void send_register_write(uint16_t reg, uint32_t raw) = 0;
+
+    // Runs the steps of this motor alone and logs a failure.
+    MotorOpResult run_steps(std::vector<MotorStep> steps) {
+        MotorSequencer sequencer;
+        sequencer.add(*this, std::move(steps));
+        MotorOpResult result = sequencer.run().front();
+        if (!result.ok && logger_) {
+            logger_->error("{0} motor {1} ({2}): {3}", result.interface, result.motor_id, result.step, result.reason);
+        }
+        return result;
+    }
+
+    void count_reply() {
+        response_count_ = 0;
+        reply_seq_.fetch_add(1, std::memory_order_release);
+    }
+
+    void publish_feedback(uint64_t rx_time_ns) {
+        rx_time_ns_.store(rx_time_ns, std::memory_order_relaxed);
+        if (has_feedback_cbk_.load(std::memory_order_acquire)) {
+            MotorFeedback feedback{rx_time_ns, motor_pos_, motor_spd_, motor_current_, motor_temperature_, error_id_};
+            feedback_cbk_(feedback);
+        }
+    }
+
+
     std::shared_ptr<spdlog::logger> logger_;
     uint16_t motor_id_;
     uint16_t master_id_;
+    std::string can_interface_;
+    const MitCodecOps* mit_codec_ = nullptr;  // MIT frames are sent on motor_id_
+    std::atomic<int> response_count_{0};
+    std::atomic<uint64_t> rx_time_ns_{0};
+    std::atomic<uint32_t> reply_seq_{0};
+    RegisterTransactions registers_;
 
     uint8_t motor_control_mode_;  // 0:none 1:pos 2:spd 3:mit
 
@@ -223,6 +383,10 @@ class MotorDriver {
     std::atomic<float> motor_spd_{0.f};
     std::atomic<float> motor_current_{0.f};
     std::atomic<float> motor_temperature_{0.f};
+
+   private:
+    MotorFeedbackCbk feedback_cbk_;
+    std::atomic<bool> has_feedback_cbk_{false};
 };
 
 using union32_t = union Union32 {
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "motor_driver.hpp"
+#include "socket_can.hpp"
+
+// State of all motors of a group, structure of arrays indexed like the group.
+struct MotorGroupState {
+    std::vector<float> pos, spd, current, temperature;
+    std::vector<uint8_t> error_id;
+    std::vector<int> response_count;     // commands sent since the last feedback
+    std::vector<uint64_t> rx_time_ns;    // receive time of the latest feedback, 0 before the first
+
+    void resize(size_t n) {
+        pos.resize(n);
+        spd.resize(n);
+        current.resize(n);
+        temperature.resize(n);
+        error_id.resize(n);
+        response_count.resize(n);
+        rx_time_ns.resize(n);
+    }
+};
+
+/**
+ * @brief Motors of one bus, commanded and read together.
+ *
+ * mit_cmd_batch() encodes the MIT commands of all motors with their model codecs and hands the
+ * frames to SocketCAN as one burst, without a virtual call or a TX wakeup per motor. The
+ * MotorDriver objects stay the owners of the motors: they decode the feedback, and the
+ * configuration, mode switching and setup commands still go through them.
+ * Not thread safe, command a group from one thread.
+ */
+class MotorGroup {
+   public:
+    explicit MotorGroup(std::vector<std::shared_ptr<MotorDriver>> motors);
+
+    size_t size() const { return motors_.size(); }
+    const std::string& get_interface() const { return interface_; }
+    const std::vector<std::shared_ptr<MotorDriver>>& get_motors() const { return motors_; }
+
+    /**
+     * @brief Sends one MIT command to every motor of the group.
+     *
+     * Arrays hold one value per motor in group order. A motor that is not in MIT mode is
+     * switched by its driver instead and receives the next command.
+     */
+    void mit_cmd_batch(const float* q, const float* dq, const float* kp, const float* kd, const float* tau);
+
+    /**
+     * @brief Copies the latest feedback of all motors, out is resized to the group.
+     */
+    void read_states(MotorGroupState& out) const;
+
+    /**
+     * @brief Lets the CAN TX thread of the bus damp the motors when commands stop.
+     *
+     * Once no command was sent on the bus for timeout_ms, every motor receives an MIT command
+     * with kp = 0, kd[i] and no feed forward every period_ms, from the real-time TX thread and
+     * independent of the commanding thread, until commands resume.
+     */
+    void arm_watchdog(uint32_t timeout_ms, uint32_t period_ms, const float* kd);
+    void disarm_watchdog();
+
+   private:
+    // consecutive motors of one model share a codec call
+    struct CodecRun {
+        size_t begin, count;
+        const MitCodecOps* codec;
+    };
+
+    std::vector<std::shared_ptr<MotorDriver>> motors_;
+    std::vector<CodecRun> runs_;
+    std::vector<can_frame> frames_;  // encoded commands, CAN IDs preset
+    std::vector<can_frame> burst_;   // commands of the motors in MIT mode
+    std::string interface_;
+    std::shared_ptr<SocketCAN> can_;
+};
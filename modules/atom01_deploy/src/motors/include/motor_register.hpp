@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class MotorDriver;
+
+// Outcome of one register transaction. Registers hold 32 bits, float registers as IEEE bits.
+struct RegisterResult {
+    uint16_t reg;
+    bool ok;
+    uint32_t raw;  // the register value, or the abort code of a refused EVO SDO request
+
+    float as_float() const {
+        float value;
+        memcpy(&value, &raw, sizeof(value));
+        return value;
+    }
+    int32_t as_int() const { return static_cast<int32_t>(raw); }
+};
+
+// Runs on the CAN RX thread (or the thread that replaced / expired the request), must not block.
+using RegisterCbk = std::function<void(const RegisterResult&)>;
+
+/**
+ * Open register requests and the last known value of every register of one motor.
+ *
+ * A motor answers one request per register at a time, so transactions are keyed by register:
+ * a new request of a register completes the open one with ok = false. Requests without a reply
+ * stay open until expire() is called.
+ */
+class RegisterTransactions {
+   public:
+    void begin(uint16_t reg, RegisterCbk cbk, bool write, uint32_t raw, uint64_t now_ns);
+    // From the RX thread. A write acknowledgement without value passes the written value back
+    // with has_value = false. Returns false for replies nobody waits for, the cache is updated anyway.
+    bool complete(uint16_t reg, bool ok, uint32_t raw, bool has_value = true);
+    // Fails every request that was sent before older_than_ns.
+    void expire(uint64_t older_than_ns);
+
+    bool cached(uint16_t reg, uint32_t& raw) const;
+    std::map<uint16_t, uint32_t> cache() const;
+
+   private:
+    struct Pending {
+        RegisterCbk cbk;
+        bool write;
+        uint32_t raw;
+        uint64_t sent_ns;
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint16_t, Pending> pending_;
+    std::map<uint16_t, uint32_t> cache_;
+};
+
+struct MotorRegisterReport {
+    uint16_t motor_id;
+    std::string interface;
+    std::map<uint16_t, uint32_t> values;
+    std::vector<uint16_t> missing;  // registers that were not answered
+    double elapsed_ms;
+};
+
+/**
+ * Reads every register of every motor (MotorDriver::register_ids()) into the register caches.
+ *
+ * All motors are read at once with up to window requests open per motor, so the time is about
+ * registers / window round trips of the slowest motor. Requests go through the normal TX queue
+ * and wait behind control frames. A request without a reply within timeout_ms is sent again,
+ * up to attempts times, after that the register is reported missing.
+ */
+std::vector<MotorRegisterReport> read_all_registers(const std::vector<std::shared_ptr<MotorDriver>>& motors,
+                                                    size_t window = 2, uint32_t timeout_ms = 20, int attempts = 3);
+
+// "can0 motor 3: registers 13, 14 missing; can1 motor 9: register 7 missing", or an empty
+// string when all registers were read.
+std::string describe_missing(const std::vector<MotorRegisterReport>& reports);
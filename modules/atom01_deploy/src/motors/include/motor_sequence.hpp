@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class MotorDriver;
+
+enum class MotorStepStatus { WAIT, DONE, FAIL };
+
+/**
+ * One request of a motor procedure (bring-up, zeroing, error clearing).
+ *
+ * send() transmits the request. Every reply received afterwards is passed to check(), which
+ * completes the step, fails it, or waits for the next reply; without check() the first reply
+ * completes it. A step without a completing reply within timeout_ms is sent again, up to
+ * attempts times. check() may describe what it is waiting for in reason, the text is reported
+ * when the step runs out of attempts.
+ */
+struct MotorStep {
+    const char* name;
+    std::function<void()> send;
+    std::function<MotorStepStatus(std::string& reason)> check;
+    uint32_t timeout_ms = 20;
+    int attempts = 3;
+};
+
+struct MotorOpResult {
+    uint16_t motor_id;
+    std::string interface;
+    bool ok;
+    std::string step;    // step that failed
+    std::string reason;
+    double elapsed_ms;
+};
+
+/**
+ * Runs the step lists of many motors concurrently, each motor advances as soon as its replies
+ * arrive, so a procedure over all buses takes about as long as its slowest motor.
+ * Replies are noticed by polling the reply counters of the drivers every poll_us.
+ */
+class MotorSequencer {
+   public:
+    static constexpr uint32_t poll_us = 100;
+
+    void add(MotorDriver& motor, std::vector<MotorStep> steps);
+    // Blocks until every motor finished or failed, results in the order of add().
+    std::vector<MotorOpResult> run();
+
+   private:
+    struct Sequence {
+        MotorDriver* motor;
+        std::vector<MotorStep> steps;
+        size_t step = 0;
+        int attempt = 0;
+        uint32_t reply_seq = 0;
+        uint64_t start_ns = 0, deadline_ns = 0;
+        bool finished = false;
+        std::string reason;
+        MotorOpResult result;
+    };
+
+    void send_step(Sequence& seq, uint64_t now_ns);
+    void finish(Sequence& seq, uint64_t now_ns, bool ok, std::string reason);
+
+    std::vector<Sequence> sequences_;
+};
+
+// "2 of 23 motors failed: can1 motor 9 (enable): no reply; ..." or an empty string when all succeeded.
+std::string describe_failures(const std::vector<MotorOpResult>& results);
@@ -1,11 +1,6 @@
 // DmMotorDriver.cpp
 #include "dm_motor_driver.hpp"
 
-DM_Limit_Param limit_param[Num_Of_Motor] = {
-    {12.5, 20, 28, 500, 5},   // DM4340P_48V
-    {12.5, 25, 200, 500, 5},  // DM10010L_48V
-};
-
 DmMotorDriver::DmMotorDriver(uint16_t motor_id, const std::string& interface_type, const std::string& can_interface, uint16_t master_id_offset,
                              DM_Motor_Model motor_model)
     : MotorDriver(), can_(SocketCAN::get(can_interface)), motor_model_(motor_model) {
@@ -15,12 +10,22 @@ DmMotorDriver::DmMotorDriver(uint16_t motor_id, const std::string& interface_typ
     motor_id_ = motor_id;
     master_id_ = motor_id_ + master_id_offset;
     limit_param_ = limit_param[motor_model_];
+    mit_codec_ = &dm_mit_codecs[motor_model_];
     can_interface_ = can_interface;
     CanCbkFunc can_callback = std::bind(&DmMotorDriver::can_rx_cbk, this, std::placeholders::_1);
     can_->add_can_callback(can_callback, master_id_);
+    // MIT, position and speed commands are all answered with a feedback frame on master_id_
+    can_->add_rtt_tracking(motor_id_, master_id_);
+    can_->add_rtt_tracking(0x100 + motor_id_, master_id_);
+    can_->add_rtt_tracking(0x200 + motor_id_, master_id_);
 }
 
-DmMotorDriver::~DmMotorDriver() { can_->remove_can_callback(master_id_); }
+DmMotorDriver::~DmMotorDriver() {
+    can_->remove_rtt_tracking(motor_id_);
+    can_->remove_rtt_tracking(0x100 + motor_id_);
+    can_->remove_rtt_tracking(0x200 + motor_id_);
+    can_->remove_can_callback(master_id_);
+}
 
 void DmMotorDriver::lock_motor() {
     can_frame tx_frame;
@@ -61,103 +66,133 @@ void DmMotorDriver::unlock_motor() {
     }
 }
 
-uint8_t DmMotorDriver::init_motor() {
-    // send disable command to enter read mode
-    DmMotorDriver::unlock_motor();
-    Timer::sleep_for(normal_sleep_time);
-    set_motor_control_mode(MIT);
-    Timer::sleep_for(normal_sleep_time);
-    // send enable command to enter contorl mode
-    DmMotorDriver::lock_motor();
-    Timer::sleep_for(normal_sleep_time);
-    DmMotorDriver::refresh_motor_status();
-    Timer::sleep_for(normal_sleep_time);
-    switch (error_id_) {
-        case DMError::DM_DOWN:
-            return DMError::DM_DOWN;
-            break;
-        case DMError::DM_UP:
-            return DMError::DM_UP;
-            break;
-        case DMError::LOST_CONN:
-            return DMError::LOST_CONN;
-            break;
-        case DMError::OVER_CURRENT:
-            return DMError::OVER_CURRENT;
-            break;
-        case DMError::MOS_OVER_TEMP:
-            return DMError::MOS_OVER_TEMP;
-            break;
-        case DMError::COIL_OVER_TEMP:
-            return DMError::COIL_OVER_TEMP;
-            break;
-        case DMError::UNDER_VOLT:
-            return DMError::UNDER_VOLT;
-            break;
-        case DMError::OVER_VOLT:
-            return DMError::OVER_VOLT;
-            break;
-        case DMError::OVER_LOAD:
-            return DMError::OVER_LOAD;
-            break;
-        default:
-            return error_id_;
+const char* dm_error_name(uint8_t error_id) {
+    switch (error_id) {
+        case DMError::DM_DOWN: return "disabled";
+        case DMError::DM_UP: return "enabled";
+        case DMError::OVER_VOLT: return "over voltage";
+        case DMError::UNDER_VOLT: return "under voltage";
+        case DMError::OVER_CURRENT: return "over current";
+        case DMError::MOS_OVER_TEMP: return "MOS over temperature";
+        case DMError::COIL_OVER_TEMP: return "coil over temperature";
+        case DMError::LOST_CONN: return "communication lost";
+        case DMError::OVER_LOAD: return "overload";
+        default: return "unknown error";
     }
-    return error_id_;
 }
 
-void DmMotorDriver::deinit_motor() {
-    DmMotorDriver::unlock_motor();
-    Timer::sleep_for(normal_sleep_time);
+std::vector<MotorStep> DmMotorDriver::init_steps() {
+    return {
+        {"disable", [this]() { unlock_motor(); }, nullptr},
+        {"set MIT mode", [this]() { set_motor_control_mode(MIT); }, nullptr},
+        {"enable", [this]() { lock_motor(); },
+         [this](std::string& reason) {
+             uint8_t state = state_.load();
+             if (state >= DMError::OVER_VOLT) {
+                 reason = fmt::format("error 0x{:X} ({})", state, dm_error_name(state));
+                 return MotorStepStatus::FAIL;
+             }
+             reason = fmt::format("reports {}", dm_error_name(state));
+             return state == DMError::DM_UP ? MotorStepStatus::DONE : MotorStepStatus::WAIT;
+         }},
+    };
 }
 
-bool DmMotorDriver::write_motor_flash() { return true; }
+std::vector<MotorStep> DmMotorDriver::zero_steps() {
+    return {
+        {"set zero", [this]() { set_motor_zero_dm(); }, nullptr},
+        {"check zero", [this]() { refresh_motor_status(); },
+         [this](std::string& reason) {
+             float pos = get_motor_pos();
+             reason = fmt::format("position {:.4f} after zeroing", pos);
+             return std::fabs(pos) <= judgment_accuracy_threshold ? MotorStepStatus::DONE : MotorStepStatus::WAIT;
+         },
+         20, 5},
+        {"disable", [this]() { unlock_motor(); }, nullptr},
+    };
+}
 
-bool DmMotorDriver::set_motor_zero() {
-    // send set zero command
-    DmMotorDriver::set_motor_zero_dm();
-    Timer::sleep_for(setup_sleep_time);  // wait for motor to set zero
-    logger_->info("motor_id: {0}\tposition: {1}\t", motor_id_, get_motor_pos());
-    DmMotorDriver::unlock_motor();
-    if (get_motor_pos() > judgment_accuracy_threshold || get_motor_pos() < -judgment_accuracy_threshold) {
-        logger_->warn("set zero error");
-        return false;
-    } else {
-        logger_->info("set zero success");
-        return false;
-    }
-    // disable motor
+std::vector<MotorStep> DmMotorDriver::clear_error_steps() {
+    return {
+        {"clear error", [this]() { clear_motor_error_dm(); },
+         [this](std::string& reason) {
+             uint8_t state = state_.load();
+             reason = fmt::format("error 0x{:X} ({}) still set", state, dm_error_name(state));
+             return state < DMError::OVER_VOLT ? MotorStepStatus::DONE : MotorStepStatus::WAIT;
+         }},
+    };
+}
+
+std::vector<MotorStep> DmMotorDriver::deinit_steps() {
+    return {{"disable", [this]() { unlock_motor(); }, nullptr}};
+}
+
+uint8_t DmMotorDriver::init_motor() {
+    run_steps(init_steps());
+    return error_id_;
 }
 
+void DmMotorDriver::deinit_motor() { run_steps(deinit_steps()); }
+
+bool DmMotorDriver::write_motor_flash() { return true; }
+
+bool DmMotorDriver::set_motor_zero() { return run_steps(zero_steps()).ok; }
+
 void DmMotorDriver::can_rx_cbk(const can_frame& rx_frame) {
-    {
-        response_count_ = 0;
+    uint64_t rx_time_ns = monotonic_ns();
+    count_reply();
+    if (is_register_reply(rx_frame)) {
+        // read and write replies carry the register value, save replies are not tracked
+        if (rx_frame.data[2] != 0xAA) {
+            uint32_t raw = rx_frame.data[4] | rx_frame.data[5] << 8 | rx_frame.data[6] << 16 |
+                           static_cast<uint32_t>(rx_frame.data[7]) << 24;
+            registers_.complete(rx_frame.data[3], true, raw);
+        }
+        return;
     }
-    uint16_t master_id_t = 0;
-    uint16_t pos_int = 0;
-    uint16_t spd_int = 0;
-    uint16_t t_int = 0;
-    pos_int = rx_frame.data[1] << 8 | rx_frame.data[2];
-    spd_int = rx_frame.data[3] << 4 | (rx_frame.data[4] & 0xF0) >> 4;
-    t_int = (rx_frame.data[4] & 0x0F) << 8 | rx_frame.data[5];
-    master_id_t = rx_frame.can_id;
-    if ((rx_frame.data[0] & 0xF0) >> 4 > 7) {  // error code range from 8 to 15
-        error_id_ = (rx_frame.data[0] & 0xF0) >> 4;
-        if (logger_) {
-            logger_->error("can_interface: {0}\tmotor_id: {1}\terror_id: 0x{2:x}", can_interface_, motor_id_, (uint32_t)error_id_);
+    uint8_t state = (rx_frame.data[0] & 0xF0) >> 4;
+    state_ = state;
+    if (state > 7) {  // error code range from 8 to 15
+        if (error_id_ != state && logger_) {
+            logger_->error("can_interface: {0}\tmotor_id: {1}\terror_id: 0x{2:x}", can_interface_, motor_id_, (uint32_t)state);
         }
+        error_id_ = state;
+    } else {
+        error_id_ = 0;
     }
-    motor_pos_ =
-        range_map(pos_int, uint16_t(0), bitmax<uint16_t>(16), -limit_param_.PosMax, limit_param_.PosMax);
-    motor_spd_ =
-        range_map(spd_int, uint16_t(0), bitmax<uint16_t>(12), -limit_param_.SpdMax, limit_param_.SpdMax);
-    motor_current_ =
-        range_map(t_int, uint16_t(0), bitmax<uint16_t>(12), -limit_param_.TauMax, limit_param_.TauMax);
+    float pos, spd, tau;
+    mit_codec_->decode(rx_frame.data, pos, spd, tau);
+    motor_pos_ = pos;
+    motor_spd_ = spd;
+    motor_current_ = tau;
     mos_temperature_ = rx_frame.data[6];
     motor_temperature_ = rx_frame.data[7];
+    publish_feedback(rx_time_ns);
 }
 
-void DmMotorDriver::get_motor_param(uint8_t param_cmd) {
+// Register replies echo the motor ID and the command, feedback frames start with state | ID.
+bool DmMotorDriver::is_register_reply(const can_frame& frame) const {
+    uint8_t cmd = frame.data[2];
+    return frame.data[0] == (motor_id_ & 0xFF) && frame.data[1] == (motor_id_ >> 8) &&
+           (cmd == 0x33 || cmd == 0x55 || cmd == 0xAA);
+}
+
+void DmMotorDriver::get_motor_param(uint8_t param_cmd) { read_register(param_cmd, nullptr); }
+
+std::vector<uint16_t> DmMotorDriver::register_ids() const {
+    std::vector<uint16_t> ids;
+    for (uint16_t rid = UV_Value; rid <= sub_ver; rid++) {
+        ids.push_back(rid);
+    }
+    for (uint16_t rid = u_off; rid <= dir; rid++) {
+        ids.push_back(rid);
+    }
+    ids.push_back(p_m);
+    ids.push_back(xout);
+    return ids;
+}
+
+void DmMotorDriver::send_register_read(uint16_t reg) {
     can_frame tx_frame;
     tx_frame.can_id = 0x7FF;
     tx_frame.can_dlc = 0x08;
@@ -165,7 +200,7 @@ void DmMotorDriver::get_motor_param(uint8_t param_cmd) {
     tx_frame.data[0] = motor_id_ & 0xFF;
     tx_frame.data[1] = motor_id_ >> 8;
     tx_frame.data[2] = 0x33;
-    tx_frame.data[3] = param_cmd;
+    tx_frame.data[3] = reg;
 
     tx_frame.data[4] = 0xFF;
     tx_frame.data[5] = 0xFF;
@@ -177,6 +212,26 @@ void DmMotorDriver::get_motor_param(uint8_t param_cmd) {
     }
 }
 
+void DmMotorDriver::send_register_write(uint16_t reg, uint32_t raw) {
+    can_frame tx_frame;
+    tx_frame.can_id = 0x7FF;
+    tx_frame.can_dlc = 0x08;
+
+    tx_frame.data[0] = motor_id_ & 0xFF;
+    tx_frame.data[1] = motor_id_ >> 8;
+    tx_frame.data[2] = 0x55;
+    tx_frame.data[3] = reg;
+
+    tx_frame.data[4] = raw & 0xFF;
+    tx_frame.data[5] = (raw >> 8) & 0xFF;
+    tx_frame.data[6] = (raw >> 16) & 0xFF;
+    tx_frame.data[7] = (raw >> 24) & 0xFF;
+    can_->transmit(tx_frame);
+    {
+        response_count_++;
+    }
+}
+
 void DmMotorDriver::motor_pos_cmd(float pos, float spd, bool ignore_limit) {
     if (motor_control_mode_ != POS) {
         set_motor_control_mode(POS);
@@ -202,7 +257,7 @@ void DmMotorDriver::motor_pos_cmd(float pos, float spd, bool ignore_limit) {
     tx_frame.data[6] = *(vbuf + 2);
     tx_frame.data[7] = *(vbuf + 3);
 
-    can_->transmit(tx_frame);
+    can_->transmit_control(tx_frame);
     {
         response_count_++;
     }
@@ -225,7 +280,7 @@ void DmMotorDriver::motor_spd_cmd(float spd) {
     tx_frame.data[2] = rv_type_convert.buf[2];
     tx_frame.data[3] = rv_type_convert.buf[3];
 
-    can_->transmit(tx_frame);
+    can_->transmit_control(tx_frame);
     {
         response_count_++;
     }
@@ -237,34 +292,12 @@ void DmMotorDriver::motor_mit_cmd(float f_p, float f_v, float f_kp, float f_kd,
         set_motor_control_mode(MIT);
         return;
     }
-    uint16_t p, v, kp, kd, t;
     can_frame tx_frame;
-
-    f_p = limit(f_p, -limit_param_.PosMax, limit_param_.PosMax);
-    f_v = limit(f_v, -limit_param_.SpdMax, limit_param_.SpdMax);
-    f_kp = limit(f_kp, 0.0f, limit_param_.OKpMax);
-    f_kd = limit(f_kd, 0.0f, limit_param_.OKdMax);
-    f_t = limit(f_t, -limit_param_.TauMax, limit_param_.TauMax);
-
-    p = range_map(f_p, -limit_param_.PosMax, limit_param_.PosMax, uint16_t(0), bitmax<uint16_t>(16));
-    v = range_map(f_v, -limit_param_.SpdMax, limit_param_.SpdMax, uint16_t(0), bitmax<uint16_t>(12));
-    kp = range_map(f_kp, 0.0f, limit_param_.OKpMax, uint16_t(0), bitmax<uint16_t>(12));
-    kd = range_map(f_kd, 0.0f, limit_param_.OKdMax, uint16_t(0), bitmax<uint16_t>(12));
-    t = range_map(f_t, -limit_param_.TauMax, limit_param_.TauMax, uint16_t(0), bitmax<uint16_t>(12));
-
     tx_frame.can_id = motor_id_;
     tx_frame.can_dlc = 0x08;
+    mit_codec_->encode(f_p, f_v, f_kp, f_kd, f_t, tx_frame.data);
 
-    tx_frame.data[0] = p >> 8;
-    tx_frame.data[1] = p & 0xFF;
-    tx_frame.data[2] = v >> 4;
-    tx_frame.data[3] = (v & 0x0F) << 4 | kp >> 8;
-    tx_frame.data[4] = kp & 0xFF;
-    tx_frame.data[5] = kd >> 4;
-    tx_frame.data[6] = (kd & 0x0F) << 4 | t >> 8;
-    tx_frame.data[7] = t & 0xFF;
-
-    can_->transmit(tx_frame);
+    can_->transmit_control(tx_frame);
     {
         response_count_++;
     }
@@ -314,52 +347,12 @@ void DmMotorDriver::clear_motor_error_dm() {
 }
 
 void DmMotorDriver::write_register_dm(uint8_t rid, float value) {
-    param_cmd_flag_[rid] = false;
-    can_frame tx_frame;
-    tx_frame.can_id = 0x7FF;
-    tx_frame.can_dlc = 0x08;
-
-    uint8_t* vbuf;
-    vbuf = (uint8_t*)&value;
-
-    tx_frame.data[0] = motor_id_ & 0xFF;
-    tx_frame.data[1] = motor_id_ >> 8;
-    tx_frame.data[2] = 0x55;
-    tx_frame.data[3] = rid;
-
-    tx_frame.data[4] = *vbuf;
-    tx_frame.data[5] = *(vbuf + 1);
-    tx_frame.data[6] = *(vbuf + 2);
-    tx_frame.data[7] = *(vbuf + 3);
-    can_->transmit(tx_frame);
-    {
-        response_count_++;
-    }
+    uint32_t raw;
+    memcpy(&raw, &value, sizeof(raw));
+    write_register(rid, raw, nullptr);
 }
 
-void DmMotorDriver::write_register_dm(uint8_t rid, int32_t value) {
-    param_cmd_flag_[rid] = false;
-    can_frame tx_frame;
-    tx_frame.can_id = 0x7FF;
-    tx_frame.can_dlc = 0x08;
-
-    uint8_t* vbuf;
-    vbuf = (uint8_t*)&value;
-
-    tx_frame.data[0] = motor_id_ & 0xFF;
-    tx_frame.data[1] = motor_id_ >> 8;
-    tx_frame.data[2] = 0x55;
-    tx_frame.data[3] = rid;
-
-    tx_frame.data[4] = *vbuf;
-    tx_frame.data[5] = *(vbuf + 1);
-    tx_frame.data[6] = *(vbuf + 2);
-    tx_frame.data[7] = *(vbuf + 3);
-    can_->transmit(tx_frame);
-    {
-        response_count_++;
-    }
-}
+void DmMotorDriver::write_register_dm(uint8_t rid, int32_t value) { write_register(rid, static_cast<uint32_t>(value), nullptr); }
 
 void DmMotorDriver::save_register_dm(uint8_t rid) {
     can_frame tx_frame;
@@ -401,6 +394,4 @@ void DmMotorDriver::refresh_motor_status() {
     }
 }
 
-void DmMotorDriver::clear_motor_error() {
-    clear_motor_error_dm();
-}
\ No newline at end of file
+void DmMotorDriver::clear_motor_error() { run_steps(clear_error_steps()); }
\ No newline at end of file
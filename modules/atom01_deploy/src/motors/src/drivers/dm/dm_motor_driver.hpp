@@ -3,8 +3,9 @@
 #include <atomic>
 #include <string>
 
+#include "mit_codec.hpp"
 #include "motor_driver.hpp"
-#include "protocol/can/socket_can.hpp"
+#include "socket_can.hpp"
 enum DMError {
     DM_DOWN = 0x00,
     DM_UP = 0x01,
@@ -79,6 +80,23 @@ typedef struct {
     float OKdMax;       ///< Maximum outer-loop derivative gain
 } DM_Limit_Param;
 
+inline constexpr DM_Limit_Param limit_param[Num_Of_Motor] = {
+    {12.5, 20, 28, 500, 5},   // DM4340P_48V
+    {12.5, 25, 200, 500, 5},  // DM10010L_48V
+};
+
+template <DM_Motor_Model M>
+struct DmMitModel {
+    static constexpr MitLimits limits = {limit_param[M].PosMax, limit_param[M].SpdMax, limit_param[M].TauMax,
+                                         limit_param[M].OKpMax, limit_param[M].OKdMax};
+    static constexpr MitLayout layout = MitLayout::DM;
+};
+
+inline constexpr MitCodecOps dm_mit_codecs[Num_Of_Motor] = {
+    make_mit_codec_ops<DmMitModel<DM4340P_48V>>(),
+    make_mit_codec_ops<DmMitModel<DM10010L_48V>>(),
+};
+
 class DmMotorDriver : public MotorDriver {
    public:
     DmMotorDriver(uint16_t motor_id, const std::string& interface_type, const std::string& can_interface, uint16_t master_id_offset,
@@ -93,29 +111,36 @@ class DmMotorDriver : public MotorDriver {
     virtual bool write_motor_flash() override;
 
     virtual void get_motor_param(uint8_t param_cmd) override;
+    virtual std::vector<uint16_t> register_ids() const override;
     virtual void motor_pos_cmd(float pos, float spd, bool ignore_limit) override;
     virtual void motor_spd_cmd(float spd) override;
     virtual void motor_mit_cmd(float f_p, float f_v, float f_kp, float f_kd, float f_t) override;
     virtual void reset_motor_id() override {};
     virtual void set_motor_control_mode(uint8_t motor_control_mode) override;
-    virtual int get_response_count() const {
-        return response_count_;
-    }
     virtual void refresh_motor_status() override;
     virtual void clear_motor_error() override;
+    virtual std::vector<MotorStep> init_steps() override;
+    virtual std::vector<MotorStep> zero_steps() override;
+    virtual std::vector<MotorStep> clear_error_steps() override;
+    virtual std::vector<MotorStep> deinit_steps() override;
+
+   protected:
+    virtual void send_register_read(uint16_t reg) override;
+    virtual void send_register_write(uint16_t reg, uint32_t raw) override;
 
    private:
-    std::atomic<int> response_count_{0};
-    bool param_cmd_flag_[30] = {false};
     DM_Motor_Model motor_model_;
     DM_Limit_Param limit_param_;
     std::atomic<uint8_t> mos_temperature_{0};
-    std::string can_interface_;
+    std::atomic<uint8_t> state_{DMError::DM_DOWN};  // DMError of the latest feedback
     void set_motor_zero_dm();
     void clear_motor_error_dm();
     void write_register_dm(uint8_t rid, float value);
     void write_register_dm(uint8_t rid, int32_t value);
     void save_register_dm(uint8_t rid);
+    bool is_register_reply(const can_frame& frame) const;
     virtual void can_rx_cbk(const can_frame& rx_frame);
     std::shared_ptr<SocketCAN> can_;
 };
+
+const char* dm_error_name(uint8_t error_id);
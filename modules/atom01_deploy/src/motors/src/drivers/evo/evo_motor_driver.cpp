@@ -1,11 +1,5 @@
 #include "evo_motor_driver.hpp"
 
-EVO_Limit_Param evo_limit_param[EVO_Num_Of_Model] = {
-    {12.5, 20.0, 18.0, 250.0, 50.0},   // EVO431040
-    {12.5, 10.0, 50.0, 250.0, 5.0},    // EVO811825
-    {12.5, 10.0, 50.0, 250.0, 5.0},    // EVO811832
-};
-
 EvoMotorDriver::EvoMotorDriver(uint16_t motor_id, const std::string& interface_type, const std::string& can_interface,
                                EVO_Motor_Model motor_model)
     : MotorDriver(), can_(SocketCAN::get(can_interface)), motor_model_(motor_model) {
@@ -13,12 +7,20 @@ EvoMotorDriver::EvoMotorDriver(uint16_t motor_id, const std::string& interface_t
         throw std::runtime_error("EVO driver only support CAN interface");
     }
     motor_id_ = motor_id;
+    can_interface_ = can_interface;
     limit_param_ = evo_limit_param[motor_model_];
+    mit_codec_ = &evo_mit_codecs[motor_model_];
     CanCbkFunc can_callback = std::bind(&EvoMotorDriver::can_rx_cbk, this, std::placeholders::_1);
     can_->add_can_callback(can_callback, motor_id_);
+    can_->add_can_callback(std::bind(&EvoMotorDriver::sdo_rx_cbk, this, std::placeholders::_1), 0x580 + motor_id_);
+    can_->add_rtt_tracking(motor_id_, motor_id_);
 }
 
-EvoMotorDriver::~EvoMotorDriver() { can_->remove_can_callback(motor_id_); }
+EvoMotorDriver::~EvoMotorDriver() {
+    can_->remove_rtt_tracking(motor_id_);
+    can_->remove_can_callback(0x580 + motor_id_);
+    can_->remove_can_callback(motor_id_);
+}
 
 void EvoMotorDriver::lock_motor() {
     can_frame tx_frame;
@@ -59,114 +61,129 @@ void EvoMotorDriver::unlock_motor() {
     }
 }
 
-uint8_t EvoMotorDriver::init_motor() {
-    // send disable command to enter read mode
-    EvoMotorDriver::unlock_motor();
-    Timer::sleep_for(normal_sleep_time);
-    set_motor_control_mode(MIT);
-    Timer::sleep_for(normal_sleep_time);
-    // send enable command to enter contorl mode
-    EvoMotorDriver::lock_motor();
-    Timer::sleep_for(normal_sleep_time);
-    EvoMotorDriver::refresh_motor_status();
-    Timer::sleep_for(normal_sleep_time);
-    switch (error_id_) {
-        case EVOError::EVO_OVER_VOLTAGE:
-            return EVOError::EVO_OVER_VOLTAGE;
-            break;
-        case EVOError::EVO_UNDER_VOLTAGE:
-            return EVOError::EVO_UNDER_VOLTAGE;
-            break;
-        case EVOError::EVO_OVER_CURRENT:
-            return EVOError::EVO_OVER_CURRENT;
-            break;
-        case EVOError::EVO_MOS_OVER_TEMP:
-            return EVOError::EVO_MOS_OVER_TEMP;
-            break;
-        case EVOError::EVO_COIL_OVER_TEMP:
-            return EVOError::EVO_COIL_OVER_TEMP;
-            break;
-        case EVOError::EVO_COMM_LOST:
-            return EVOError::EVO_COMM_LOST;
-            break;
-        case EVOError::EVO_OVERLOAD:
-            return EVOError::EVO_OVERLOAD;
-            break;
-        case EVOError::EVO_ENCODER_ERROR:
-            return EVOError::EVO_ENCODER_ERROR;
-            break;
-        default:
-            return error_id_;
+const char* evo_error_name(uint8_t error_id) {
+    switch (error_id) {
+        case EVOError::EVO_NO_ERROR: return "no error";
+        case EVOError::EVO_OVER_VOLTAGE: return "over voltage";
+        case EVOError::EVO_UNDER_VOLTAGE: return "under voltage";
+        case EVOError::EVO_OVER_CURRENT: return "over current";
+        case EVOError::EVO_MOS_OVER_TEMP: return "MOS over temperature";
+        case EVOError::EVO_COIL_OVER_TEMP: return "coil over temperature";
+        case EVOError::EVO_COMM_LOST: return "communication lost";
+        case EVOError::EVO_OVERLOAD: return "overload";
+        case EVOError::EVO_ENCODER_ERROR: return "encoder error";
+        default: return "unknown error";
     }
-    return error_id_;
 }
 
-void EvoMotorDriver::deinit_motor() {
-    EvoMotorDriver::unlock_motor();
-    Timer::sleep_for(normal_sleep_time);
+// Completes once the motor reports no error, the error code of the last reply is the reason otherwise.
+MotorStepStatus EvoMotorDriver::check_no_error(std::string& reason) const {
+    uint8_t error_id = error_id_;
+    if (error_id == EVOError::EVO_NO_ERROR) {
+        return MotorStepStatus::DONE;
+    }
+    reason = fmt::format("error 0x{:X} ({})", error_id, evo_error_name(error_id));
+    return MotorStepStatus::WAIT;
 }
 
-bool EvoMotorDriver::write_motor_flash() { return true; }
+std::vector<MotorStep> EvoMotorDriver::init_steps() {
+    return {
+        // reset mode also clears latched errors
+        {"reset", [this]() { unlock_motor(); }, nullptr},
+        {"enable",
+         [this]() {
+             set_motor_control_mode(MIT);
+             lock_motor();
+         },
+         [this](std::string& reason) { return check_no_error(reason); }},
+    };
+}
 
-bool EvoMotorDriver::set_motor_zero() {
-    // send set zero command
-    EvoMotorDriver::set_motor_zero_evo();
-    Timer::sleep_for(setup_sleep_time);  // wait for motor to set zero
-    logger_->info("motor_id: {0}\tposition: {1}\t", motor_id_, get_motor_pos());
-    EvoMotorDriver::unlock_motor();
-    if (get_motor_pos() > judgment_accuracy_threshold || get_motor_pos() < -judgment_accuracy_threshold) {
-        logger_->warn("set zero error");
-        return false;
-    } else {
-        logger_->info("set zero success");
-        return true;
-    }
-    // disable motor
+std::vector<MotorStep> EvoMotorDriver::zero_steps() {
+    return {
+        {"set zero", [this]() { set_motor_zero_evo(); }, nullptr},
+        {"check zero", [this]() { refresh_motor_status(); },
+         [this](std::string& reason) {
+             float pos = get_motor_pos();
+             reason = fmt::format("position {:.4f} after zeroing", pos);
+             return std::fabs(pos) <= judgment_accuracy_threshold ? MotorStepStatus::DONE : MotorStepStatus::WAIT;
+         },
+         20, 5},
+        {"reset", [this]() { unlock_motor(); }, nullptr},
+    };
 }
 
+std::vector<MotorStep> EvoMotorDriver::clear_error_steps() {
+    return {
+        {"clear error", [this]() { clear_motor_error_evo(); },
+         [this](std::string& reason) { return check_no_error(reason); }},
+    };
+}
+
+std::vector<MotorStep> EvoMotorDriver::deinit_steps() {
+    return {{"reset", [this]() { unlock_motor(); }, nullptr}};
+}
+
+uint8_t EvoMotorDriver::init_motor() {
+    run_steps(init_steps());
+    return error_id_;
+}
+
+void EvoMotorDriver::deinit_motor() { run_steps(deinit_steps()); }
+
+bool EvoMotorDriver::write_motor_flash() { return true; }
+
+bool EvoMotorDriver::set_motor_zero() { return run_steps(zero_steps()).ok; }
+
 void EvoMotorDriver::can_rx_cbk(const can_frame& rx_frame) {
-    {
-        response_count_ = 0;
-    }
-    uint16_t pos_int = 0;
-    uint16_t spd_int = 0;
-    uint16_t t_int = 0;
-    
-    pos_int = rx_frame.data[1] << 8 | rx_frame.data[2];
-    spd_int = rx_frame.data[3] << 4 | (rx_frame.data[4] & 0xF0) >> 4;
-    t_int = (rx_frame.data[4] & 0x0F) << 8 | rx_frame.data[5];
+    uint64_t rx_time_ns = monotonic_ns();
+    count_reply();
     error_id_ = rx_frame.data[6];
     mos_temperature_ = rx_frame.data[7];
-    
-    motor_pos_ = range_map(pos_int, uint16_t(0), bitmax<uint16_t>(16), 
-                          -limit_param_.PosMax, limit_param_.PosMax);
-    motor_spd_ = range_map(spd_int, uint16_t(0), bitmax<uint16_t>(12), 
-                          -limit_param_.SpdMax, limit_param_.SpdMax);
-    
-    motor_current_ = range_map(t_int, uint16_t(0), bitmax<uint16_t>(12), 
-                                -limit_param_.TauMax, limit_param_.TauMax);
+
+    float pos, spd, tau;
+    mit_codec_->decode(rx_frame.data, pos, spd, tau);
+    motor_pos_ = pos;
+    motor_spd_ = spd;
+    motor_current_ = tau;
+    publish_feedback(rx_time_ns);
 }
 
-void EvoMotorDriver::get_motor_param(uint8_t param_cmd) {
-    can_frame tx_frame;
-    tx_frame.can_id = 0x600 + motor_id_;
-    tx_frame.can_dlc = 0x08;
-    
-    uint16_t index = 0x7000 + param_cmd;
-    uint8_t subindex = 0x00;
-    
-    tx_frame.data[0] = 0x40;
-    tx_frame.data[1] = index & 0xFF;
-    tx_frame.data[2] = (index >> 8) & 0xFF;
-    tx_frame.data[3] = subindex;
-    tx_frame.data[4] = 0x00;
-    tx_frame.data[5] = 0x00;
-    tx_frame.data[6] = 0x00;
-    tx_frame.data[7] = 0x00;
-    
-    can_->transmit(tx_frame);
-    {
-        response_count_++;
+void EvoMotorDriver::get_motor_param(uint8_t param_cmd) { read_register(EVO_PARAM_INDEX + param_cmd, nullptr); }
+
+std::vector<uint16_t> EvoMotorDriver::register_ids() const {
+    std::vector<uint16_t> ids;
+    for (uint16_t param = EVO_PARAM_Q_MAX; param <= EVO_PARAM_CUR_MIN; param++) {
+        ids.push_back(EVO_PARAM_INDEX + param);
+    }
+    return ids;
+}
+
+void EvoMotorDriver::send_register_read(uint16_t reg) { read_register_evo(reg, 0x00); }
+
+void EvoMotorDriver::send_register_write(uint16_t reg, uint32_t raw) {
+    write_register_evo(reg, 0x00, static_cast<int32_t>(raw));
+}
+
+// SDO responses: 0x43..0x4F upload with the value, 0x60 download acknowledged, 0x80 abort with its code.
+void EvoMotorDriver::sdo_rx_cbk(const can_frame& rx_frame) {
+    count_reply();
+    uint16_t index = rx_frame.data[1] | rx_frame.data[2] << 8;
+    uint32_t raw = rx_frame.data[4] | rx_frame.data[5] << 8 | rx_frame.data[6] << 16 |
+                   static_cast<uint32_t>(rx_frame.data[7]) << 24;
+    if (rx_frame.data[3] != 0x00) {
+        return;
+    }
+    uint8_t scs = rx_frame.data[0] & 0xE0;
+    if (scs == 0x40) {
+        registers_.complete(index, true, raw);
+    } else if (scs == 0x60) {
+        registers_.complete(index, true, 0, false);
+    } else if (rx_frame.data[0] == 0x80) {
+        registers_.complete(index, false, raw);
+        if (logger_) {
+            logger_->warn("can_interface: {0}\tmotor_id: {1}\tSDO 0x{2:X} aborted: 0x{3:08X}", can_interface_, motor_id_, index, raw);
+        }
     }
 }
 
@@ -176,46 +193,12 @@ void EvoMotorDriver::motor_mit_cmd(float f_p, float f_v, float f_kp, float f_kd,
         set_motor_control_mode(MIT);
         return;
     }
-    uint16_t p, v, kp, kd, t;
     can_frame tx_frame;
-
-    f_p = limit(f_p, -limit_param_.PosMax, limit_param_.PosMax);
-    f_v = limit(f_v, -limit_param_.SpdMax, limit_param_.SpdMax);
-    f_kp = limit(f_kp, 0.0f, limit_param_.OKpMax);
-    f_kd = limit(f_kd, 0.0f, limit_param_.OKdMax);
-    f_t = limit(f_t, -limit_param_.TauMax, limit_param_.TauMax);
-    
-    p = range_map(f_p, -limit_param_.PosMax, limit_param_.PosMax, uint16_t(0), bitmax<uint16_t>(16));
-    v = range_map(f_v, -limit_param_.SpdMax, limit_param_.SpdMax, uint16_t(0), bitmax<uint16_t>(12));
-    kp = range_map(f_kp, 0.0f, limit_param_.OKpMax, uint16_t(0), bitmax<uint16_t>(12));
-    kd = range_map(f_kd, 0.0f, limit_param_.OKdMax, uint16_t(0), bitmax<uint16_t>(12));
-    t = range_map(f_t, -limit_param_.TauMax, limit_param_.TauMax, uint16_t(0), bitmax<uint16_t>(12));
-
     tx_frame.can_id = motor_id_;
     tx_frame.can_dlc = 0x08;
+    mit_codec_->encode(f_p, f_v, f_kp, f_kd, f_t, tx_frame.data);
 
-    if (motor_model_ == EVO431040) {
-        tx_frame.data[0] = p >> 8;
-        tx_frame.data[1] = p & 0xFF;
-        tx_frame.data[2] = v >> 4;
-        tx_frame.data[3] = (v & 0x0F) << 4 | kp >> 8;
-        tx_frame.data[4] = kp & 0xFF;
-        tx_frame.data[5] = kd >> 4;
-        tx_frame.data[6] = (kd & 0x0F) << 4 | t >> 8;
-        tx_frame.data[7] = t & 0xFF;
-    } else {
-        uint8_t switch_user_mode = 0;
-        tx_frame.data[0] = ((switch_user_mode & 0x07) << 5) | ((kp >> 7) & 0x1F);
-        tx_frame.data[1] = ((kp & 0x7F) << 1) | ((kd >> 8) & 0x01);
-        tx_frame.data[2] = kd & 0xFF;
-        tx_frame.data[3] = (p >> 8) & 0xFF;
-        tx_frame.data[4] = p & 0xFF;
-        tx_frame.data[5] = (v >> 4) & 0xFF;
-        tx_frame.data[6] = ((v & 0x0F) << 4) | ((t >> 8) & 0x0F);
-        tx_frame.data[7] = t & 0xFF;
-    }
-
-    can_->transmit(tx_frame);
+    can_->transmit_control(tx_frame);
     {
         response_count_++;
     }
@@ -344,6 +327,4 @@ void EvoMotorDriver::refresh_motor_status() {
     }
 }
 
-void EvoMotorDriver::clear_motor_error() {
-    clear_motor_error_evo();
-}
\ No newline at end of file
+void EvoMotorDriver::clear_motor_error() { run_steps(clear_error_steps()); }
\ No newline at end of file
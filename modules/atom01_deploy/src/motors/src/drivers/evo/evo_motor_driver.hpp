@@ -3,8 +3,9 @@
 #include <atomic>
 #include <string>
 
+#include "mit_codec.hpp"
 #include "motor_driver.hpp"
-#include "protocol/can/socket_can.hpp"
+#include "socket_can.hpp"
 enum EVOError {
     EVO_NO_ERROR = 0x00,
     EVO_OVER_VOLTAGE = 0x01,
@@ -34,6 +35,9 @@ enum EVO_REG {
     EVO_CMD_REBOOT = 0xFE           ///< Reboot motor (make flash parameters effective)
 };
 
+// Flash parameters are the SDO objects EVO_PARAM_INDEX + EVO_Flash_Param, subindex 0.
+inline constexpr uint16_t EVO_PARAM_INDEX = 0x7000;
+
 enum EVO_Flash_Param {
     EVO_PARAM_Q_MAX = 0x00,         ///< Maximum position limit
     EVO_PARAM_Q_MIN = 0x01,         ///< Minimum position limit
@@ -61,6 +65,26 @@ typedef struct {
     float OKdMax;       ///< Maximum outer-loop derivative gain
 } EVO_Limit_Param;
 
+inline constexpr EVO_Limit_Param evo_limit_param[EVO_Num_Of_Model] = {
+    {12.5, 20.0, 18.0, 250.0, 50.0},   // EVO431040
+    {12.5, 10.0, 50.0, 250.0, 5.0},    // EVO811825
+    {12.5, 10.0, 50.0, 250.0, 5.0},    // EVO811832
+};
+
+template <EVO_Motor_Model M>
+struct EvoMitModel {
+    static constexpr MitLimits limits = {evo_limit_param[M].PosMax, evo_limit_param[M].SpdMax,
+                                         evo_limit_param[M].TauMax, evo_limit_param[M].OKpMax,
+                                         evo_limit_param[M].OKdMax};
+    static constexpr MitLayout layout = M == EVO431040 ? MitLayout::DM : MitLayout::EVO8118;
+};
+
+inline constexpr MitCodecOps evo_mit_codecs[EVO_Num_Of_Model] = {
+    make_mit_codec_ops<EvoMitModel<EVO431040>>(),
+    make_mit_codec_ops<EvoMitModel<EVO811825>>(),
+    make_mit_codec_ops<EvoMitModel<EVO811832>>(),
+};
+
 class EvoMotorDriver : public MotorDriver {
    public:
     EvoMotorDriver(uint16_t motor_id, const std::string& interface_type, const std::string& can_interface,
@@ -75,26 +99,36 @@ class EvoMotorDriver : public MotorDriver {
     virtual bool write_motor_flash() override;
 
     virtual void get_motor_param(uint8_t param_cmd) override;
+    virtual std::vector<uint16_t> register_ids() const override;
     virtual void motor_pos_cmd(float pos, float spd, bool ignore_limit) override {};
     virtual void motor_spd_cmd(float spd) override {};
     virtual void motor_mit_cmd(float f_p, float f_v, float f_kp, float f_kd, float f_t) override;
     virtual void reset_motor_id() override {};
     virtual void set_motor_control_mode(uint8_t motor_control_mode) override;
-    virtual int get_response_count() const { 
-        return response_count_; 
-    }
     virtual void refresh_motor_status() override;
     virtual void clear_motor_error() override;
+    virtual std::vector<MotorStep> init_steps() override;
+    virtual std::vector<MotorStep> zero_steps() override;
+    virtual std::vector<MotorStep> clear_error_steps() override;
+    virtual std::vector<MotorStep> deinit_steps() override;
+
+   protected:
+    virtual void send_register_read(uint16_t reg) override;
+    virtual void send_register_write(uint16_t reg, uint32_t raw) override;
+
    private:
-    std::atomic<int> response_count_{0};
     EVO_Motor_Model motor_model_;
     EVO_Limit_Param limit_param_;
     std::atomic<uint8_t> mos_temperature_{0};
+    MotorStepStatus check_no_error(std::string& reason) const;
     void set_motor_zero_evo();
     void clear_motor_error_evo();
     void write_register_evo(uint16_t index, uint8_t subindex, int32_t value);
     void read_register_evo(uint16_t index, uint8_t subindex);
     void save_register_evo(uint8_t rid);
     virtual void can_rx_cbk(const can_frame& rx_frame);
+    void sdo_rx_cbk(const can_frame& rx_frame);
     std::shared_ptr<SocketCAN> can_;
-};
\ No newline at end of file
+};
+
+const char* evo_error_name(uint8_t error_id);
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <linux/can.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Ranges of the MIT command / feedback fields of one motor model. Positions, speeds and torques
+// span [-max, max], the gains [0, max].
+struct MitLimits {
+    float pos, spd, tau, kp, kd;
+};
+
+// DM: p16 v12 kp12 kd12 t12, used by all DM motors and the EVO431040.
+// EVO8118: mode3 kp12 kd9 p16 v12 t12, used by the EVO811825 / EVO811832.
+// The feedback layout (data[1..5]: p16 v12 t12) is the same for both.
+enum class MitLayout : uint8_t { DM, EVO8118 };
+
+// Rounded up by one float epsilon, so the upper limit still maps to the largest code after the
+// float multiply; in range values land within one LSB of the exact (double) mapping.
+constexpr float encode_scale(float max_code, float range) { return max_code / range * (1.0f + 1.2e-7f); }
+
+// MIT frame codec of one motor model. Model provides `static constexpr MitLimits limits` and
+// `static constexpr MitLayout layout`, so every scale factor is a compile time constant and a
+// field costs one clamp, one multiply and one conversion. Out of range values are clamped,
+// NaN is sent as 0.
+template <typename Model>
+struct MitCodec {
+    static constexpr MitLimits limits = Model::limits;
+    static constexpr MitLayout layout = Model::layout;
+    static constexpr int KD_BITS = layout == MitLayout::EVO8118 ? 9 : 12;
+
+    static constexpr float P_ENC = encode_scale(65535.0f, 2.0f * limits.pos);
+    static constexpr float V_ENC = encode_scale(4095.0f, 2.0f * limits.spd);
+    static constexpr float T_ENC = encode_scale(4095.0f, 2.0f * limits.tau);
+    static constexpr float KP_ENC = encode_scale(4095.0f, limits.kp);
+    static constexpr float KD_ENC = encode_scale(static_cast<float>((1 << KD_BITS) - 1), limits.kd);
+    static constexpr float P_DEC = 2.0f * limits.pos / 65535.0f;
+    static constexpr float V_DEC = 2.0f * limits.spd / 4095.0f;
+    static constexpr float T_DEC = 2.0f * limits.tau / 4095.0f;
+
+    static inline void encode(float p, float v, float kp, float kd, float t, uint8_t* data) {
+        pack(quantize(p, limits.pos, P_ENC), quantize(v, limits.spd, V_ENC),
+             quantize_gain(kp, limits.kp, KP_ENC), quantize_gain(kd, limits.kd, KD_ENC),
+             quantize(t, limits.tau, T_ENC), data);
+    }
+
+    static inline void decode(const uint8_t* data, float& pos, float& spd, float& tau) {
+        uint32_t p = static_cast<uint32_t>(data[1]) << 8 | data[2];
+        uint32_t v = static_cast<uint32_t>(data[3]) << 4 | data[4] >> 4;
+        uint32_t t = static_cast<uint32_t>(data[4] & 0x0F) << 8 | data[5];
+        pos = static_cast<float>(p) * P_DEC - limits.pos;
+        spd = static_cast<float>(v) * V_DEC - limits.spd;
+        tau = static_cast<float>(t) * T_DEC - limits.tau;
+    }
+
+    // All commands of n motors of this model in one pass, only the payloads are written.
+    static void encode_batch(size_t n, const float* p, const float* v, const float* kp, const float* kd,
+                             const float* t, can_frame* frames) {
+        for (size_t i = 0; i < n; i++) {
+            encode(p[i], v[i], kp[i], kd[i], t[i], frames[i].data);
+        }
+    }
+
+    static void decode_batch(size_t n, const can_frame* frames, float* pos, float* spd, float* tau) {
+        for (size_t i = 0; i < n; i++) {
+            decode(frames[i].data, pos[i], spd[i], tau[i]);
+        }
+    }
+
+   private:
+    static inline uint32_t quantize(float x, float max, float scale) {
+        x = std::isnan(x) ? 0.0f : x;
+        x = std::min(std::max(x, -max), max);
+        return static_cast<uint32_t>((x + max) * scale);
+    }
+
+    static inline uint32_t quantize_gain(float x, float max, float scale) {
+        x = std::isnan(x) ? 0.0f : x;
+        x = std::min(std::max(x, 0.0f), max);
+        return static_cast<uint32_t>(x * scale);
+    }
+
+    static inline void pack(uint32_t p, uint32_t v, uint32_t kp, uint32_t kd, uint32_t t, uint8_t* data) {
+        if constexpr (layout == MitLayout::DM) {
+            data[0] = static_cast<uint8_t>(p >> 8);
+            data[1] = static_cast<uint8_t>(p);
+            data[2] = static_cast<uint8_t>(v >> 4);
+            data[3] = static_cast<uint8_t>((v & 0x0F) << 4 | kp >> 8);
+            data[4] = static_cast<uint8_t>(kp);
+            data[5] = static_cast<uint8_t>(kd >> 4);
+            data[6] = static_cast<uint8_t>((kd & 0x0F) << 4 | t >> 8);
+            data[7] = static_cast<uint8_t>(t);
+        } else {
+            data[0] = static_cast<uint8_t>(kp >> 7);  // mode 0 in the upper 3 bits
+            data[1] = static_cast<uint8_t>((kp & 0x7F) << 1 | kd >> 8);
+            data[2] = static_cast<uint8_t>(kd);
+            data[3] = static_cast<uint8_t>(p >> 8);
+            data[4] = static_cast<uint8_t>(p);
+            data[5] = static_cast<uint8_t>(v >> 4);
+            data[6] = static_cast<uint8_t>((v & 0x0F) << 4 | t >> 8);
+            data[7] = static_cast<uint8_t>(t);
+        }
+    }
+};
+
+// Codec of a model chosen at runtime (robot.yaml), one table entry per model.
+struct MitCodecOps {
+    MitLimits limits;
+    void (*encode)(float p, float v, float kp, float kd, float t, uint8_t* data);
+    void (*decode)(const uint8_t* data, float& pos, float& spd, float& tau);
+    void (*encode_batch)(size_t n, const float* p, const float* v, const float* kp, const float* kd, const float* t,
+                         can_frame* frames);
+    void (*decode_batch)(size_t n, const can_frame* frames, float* pos, float* spd, float* tau);
+};
+
+template <typename Model>
+constexpr MitCodecOps make_mit_codec_ops() {
+    return {Model::limits, &MitCodec<Model>::encode, &MitCodec<Model>::decode, &MitCodec<Model>::encode_batch,
+            &MitCodec<Model>::decode_batch};
+}
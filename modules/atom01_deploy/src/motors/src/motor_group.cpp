@@ -0,0 +1,70 @@
+#include "motor_group.hpp"
+
+MotorGroup::MotorGroup(std::vector<std::shared_ptr<MotorDriver>> motors) : motors_(std::move(motors)) {
+    if (motors_.empty()) {
+        throw std::runtime_error("Motor group is empty");
+    }
+    interface_ = motors_.front()->get_interface();
+    for (size_t i = 0; i < motors_.size(); ++i) {
+        const auto& motor = motors_[i];
+        if (motor->get_interface() != interface_) {
+            throw std::runtime_error("Motor group mixes interfaces " + interface_ + " and " + motor->get_interface());
+        }
+        if (!motor->mit_codec_) {
+            throw std::runtime_error("Motor " + std::to_string(motor->motor_id_) + " has no MIT codec");
+        }
+        if (runs_.empty() || runs_.back().codec != motor->mit_codec_) {
+            runs_.push_back({i, 0, motor->mit_codec_});
+        }
+        runs_.back().count += 1;
+    }
+    can_ = SocketCAN::get(interface_);
+    frames_.resize(motors_.size());
+    burst_.resize(motors_.size());
+    for (size_t i = 0; i < motors_.size(); ++i) {
+        frames_[i].can_id = motors_[i]->motor_id_;
+        frames_[i].can_dlc = 0x08;
+    }
+}
+
+void MotorGroup::mit_cmd_batch(const float* q, const float* dq, const float* kp, const float* kd, const float* tau) {
+    for (const CodecRun& run : runs_) {
+        run.codec->encode_batch(run.count, q + run.begin, dq + run.begin, kp + run.begin, kd + run.begin,
+                                tau + run.begin, frames_.data() + run.begin);
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < motors_.size(); ++i) {
+        MotorDriver* motor = motors_[i].get();
+        if (motor->motor_control_mode_ != MotorDriver::MIT) {
+            motor->motor_mit_cmd(q[i], dq[i], kp[i], kd[i], tau[i]);
+            continue;
+        }
+        burst_[count++] = frames_[i];
+        motor->response_count_++;
+    }
+    can_->transmit_control(burst_.data(), count);
+}
+
+void MotorGroup::arm_watchdog(uint32_t timeout_ms, uint32_t period_ms, const float* kd) {
+    std::vector<can_frame> damping(frames_);
+    for (size_t i = 0; i < motors_.size(); ++i) {
+        motors_[i]->mit_codec_->encode(0.0f, 0.0f, 0.0f, kd[i], 0.0f, damping[i].data);
+    }
+    can_->arm_control_watchdog(damping, timeout_ms * 1000, period_ms * 1000);
+}
+
+void MotorGroup::disarm_watchdog() { can_->disarm_control_watchdog(); }
+
+void MotorGroup::read_states(MotorGroupState& out) const {
+    out.resize(motors_.size());
+    for (size_t i = 0; i < motors_.size(); ++i) {
+        const MotorDriver* motor = motors_[i].get();
+        out.pos[i] = motor->motor_pos_.load(std::memory_order_relaxed);
+        out.spd[i] = motor->motor_spd_.load(std::memory_order_relaxed);
+        out.current[i] = motor->motor_current_.load(std::memory_order_relaxed);
+        out.temperature[i] = motor->motor_temperature_.load(std::memory_order_relaxed);
+        out.error_id[i] = motor->error_id_.load(std::memory_order_relaxed);
+        out.response_count[i] = motor->response_count_.load(std::memory_order_relaxed);
+        out.rx_time_ns[i] = motor->rx_time_ns_.load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,191 @@
+#include "motor_register.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+#include "motor_driver.hpp"
+
+void RegisterTransactions::begin(uint16_t reg, RegisterCbk cbk, bool write, uint32_t raw, uint64_t now_ns) {
+    RegisterCbk replaced;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Pending& pending = pending_[reg];
+        replaced = std::move(pending.cbk);
+        pending = {std::move(cbk), write, raw, now_ns};
+    }
+    if (replaced) {
+        replaced({reg, false, 0});
+    }
+}
+
+bool RegisterTransactions::complete(uint16_t reg, bool ok, uint32_t raw, bool has_value) {
+    RegisterCbk cbk;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = pending_.find(reg);
+        if (it != pending_.end()) {
+            found = true;
+            if (!has_value && it->second.write) {
+                raw = it->second.raw;
+                has_value = true;
+            }
+            cbk = std::move(it->second.cbk);
+            pending_.erase(it);
+        }
+        if (ok && has_value) {
+            cache_[reg] = raw;
+        }
+    }
+    if (cbk) {
+        cbk({reg, ok, raw});
+    }
+    return found;
+}
+
+void RegisterTransactions::expire(uint64_t older_than_ns) {
+    std::vector<std::pair<uint16_t, RegisterCbk>> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = pending_.begin(); it != pending_.end();) {
+            if (it->second.sent_ns < older_than_ns) {
+                expired.emplace_back(it->first, std::move(it->second.cbk));
+                it = pending_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (auto& [reg, cbk] : expired) {
+        if (cbk) {
+            cbk({reg, false, 0});
+        }
+    }
+}
+
+bool RegisterTransactions::cached(uint16_t reg, uint32_t& raw) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = cache_.find(reg);
+    if (it == cache_.end()) {
+        return false;
+    }
+    raw = it->second;
+    return true;
+}
+
+std::map<uint16_t, uint32_t> RegisterTransactions::cache() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cache_;
+}
+
+namespace {
+
+// Shared with the callback, which may still run after its request was given up.
+struct ReadRequest {
+    enum State { OPEN, OK, REFUSED };
+    std::atomic<int> state{OPEN};
+    uint32_t raw = 0;
+};
+
+struct OpenRead {
+    uint16_t reg;
+    int attempt;
+    uint64_t deadline_ns;
+    std::shared_ptr<ReadRequest> request;
+};
+
+struct MotorRead {
+    MotorDriver* motor;
+    std::vector<uint16_t> regs;
+    size_t next = 0;
+    std::vector<OpenRead> open;
+    MotorRegisterReport report;
+};
+
+}  // namespace
+
+std::vector<MotorRegisterReport> read_all_registers(const std::vector<std::shared_ptr<MotorDriver>>& motors,
+                                                    size_t window, uint32_t timeout_ms, int attempts) {
+    const uint64_t timeout_ns = static_cast<uint64_t>(timeout_ms) * 1000000ull;
+    window = std::max<size_t>(window, 1);
+
+    auto send = [timeout_ns](MotorRead& read, uint16_t reg, int attempt, uint64_t now_ns) {
+        auto request = std::make_shared<ReadRequest>();
+        read.open.push_back({reg, attempt, now_ns + timeout_ns, request});
+        read.motor->read_register(reg, [request](const RegisterResult& result) {
+            request->raw = result.raw;
+            request->state.store(result.ok ? ReadRequest::OK : ReadRequest::REFUSED, std::memory_order_release);
+        });
+    };
+
+    std::vector<MotorRead> reads(motors.size());
+    size_t running = 0;
+    uint64_t start = monotonic_ns();
+    for (size_t i = 0; i < motors.size(); i++) {
+        MotorRead& read = reads[i];
+        read.motor = motors[i].get();
+        read.regs = read.motor->register_ids();
+        read.report = {static_cast<uint16_t>(read.motor->get_motor_id()), read.motor->get_interface(), {}, {}, 0.0};
+        while (read.open.size() < window && read.next < read.regs.size()) {
+            send(read, read.regs[read.next++], 0, start);
+        }
+        running += read.open.empty() ? 0 : 1;
+    }
+
+    while (running > 0) {
+        Timer::sleep_for_us(MotorSequencer::poll_us);
+        uint64_t now = monotonic_ns();
+        for (MotorRead& read : reads) {
+            if (read.open.empty()) {
+                continue;
+            }
+            std::vector<OpenRead> open;
+            open.swap(read.open);
+            for (OpenRead& entry : open) {
+                int state = entry.request->state.load(std::memory_order_acquire);
+                if (state == ReadRequest::OK) {
+                    read.report.values[entry.reg] = entry.request->raw;
+                } else if (state == ReadRequest::REFUSED) {
+                    read.report.missing.push_back(entry.reg);
+                } else if (now < entry.deadline_ns) {
+                    read.open.push_back(std::move(entry));
+                } else if (entry.attempt + 1 < attempts) {
+                    send(read, entry.reg, entry.attempt + 1, now);
+                } else {
+                    read.report.missing.push_back(entry.reg);
+                }
+            }
+            while (read.open.size() < window && read.next < read.regs.size()) {
+                send(read, read.regs[read.next++], 0, now);
+            }
+            if (read.open.empty()) {
+                read.report.elapsed_ms = (now - start) * 1e-6;
+                running -= 1;
+            }
+        }
+    }
+
+    std::vector<MotorRegisterReport> reports;
+    reports.reserve(reads.size());
+    for (MotorRead& read : reads) {
+        std::sort(read.report.missing.begin(), read.report.missing.end());
+        reports.push_back(std::move(read.report));
+    }
+    return reports;
+}
+
+std::string describe_missing(const std::vector<MotorRegisterReport>& reports) {
+    std::string text;
+    for (const MotorRegisterReport& report : reports) {
+        if (report.missing.empty()) {
+            continue;
+        }
+        text += (text.empty() ? "" : "; ") + report.interface + " motor " + std::to_string(report.motor_id) +
+                (report.missing.size() == 1 ? ": register" : ": registers");
+        for (size_t i = 0; i < report.missing.size(); i++) {
+            text += (i == 0 ? " " : ", ") + std::to_string(report.missing[i]);
+        }
+        text += " missing";
+    }
+    return text;
+}
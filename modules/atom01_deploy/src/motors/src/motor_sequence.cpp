@@ -0,0 +1,114 @@
+#include "motor_sequence.hpp"
+
+#include "motor_driver.hpp"
+
+void MotorSequencer::add(MotorDriver& motor, std::vector<MotorStep> steps) {
+    Sequence seq;
+    seq.motor = &motor;
+    seq.steps = std::move(steps);
+    seq.result = {static_cast<uint16_t>(motor.get_motor_id()), motor.get_interface(), false, "", "", 0.0};
+    sequences_.push_back(std::move(seq));
+}
+
+void MotorSequencer::send_step(Sequence& seq, uint64_t now_ns) {
+    const MotorStep& step = seq.steps[seq.step];
+    // replies counted from here on belong to this request
+    seq.reply_seq = seq.motor->get_reply_seq();
+    seq.deadline_ns = now_ns + static_cast<uint64_t>(step.timeout_ms) * 1000000ull;
+    step.send();
+}
+
+void MotorSequencer::finish(Sequence& seq, uint64_t now_ns, bool ok, std::string reason) {
+    seq.finished = true;
+    seq.result.ok = ok;
+    if (!ok) {
+        seq.result.step = seq.steps[seq.step].name;
+        seq.result.reason = std::move(reason);
+    }
+    seq.result.elapsed_ms = (now_ns - seq.start_ns) * 1e-6;
+}
+
+std::vector<MotorOpResult> MotorSequencer::run() {
+    size_t running = 0;
+    uint64_t now = monotonic_ns();
+    for (Sequence& seq : sequences_) {
+        seq.start_ns = now;
+        if (seq.steps.empty()) {
+            seq.finished = true;
+            seq.result.ok = true;
+            continue;
+        }
+        send_step(seq, now);
+        running += 1;
+    }
+
+    while (running > 0) {
+        Timer::sleep_for_us(poll_us);
+        now = monotonic_ns();
+        for (Sequence& seq : sequences_) {
+            if (seq.finished) {
+                continue;
+            }
+            const MotorStep& step = seq.steps[seq.step];
+            uint32_t reply_seq = seq.motor->get_reply_seq();
+            if (reply_seq != seq.reply_seq) {
+                seq.reply_seq = reply_seq;
+                MotorStepStatus status = step.check ? step.check(seq.reason) : MotorStepStatus::DONE;
+                if (status == MotorStepStatus::FAIL) {
+                    finish(seq, now, false, seq.reason);
+                    running -= 1;
+                    continue;
+                }
+                if (status == MotorStepStatus::DONE) {
+                    seq.step += 1;
+                    seq.attempt = 0;
+                    seq.reason.clear();
+                    if (seq.step == seq.steps.size()) {
+                        seq.step -= 1;
+                        finish(seq, now, true, "");
+                        running -= 1;
+                    } else {
+                        send_step(seq, now);
+                    }
+                    continue;
+                }
+            }
+            if (now >= seq.deadline_ns) {
+                seq.attempt += 1;
+                if (seq.attempt >= step.attempts) {
+                    finish(seq, now, false,
+                           seq.reason.empty() ? "no reply after " + std::to_string(step.attempts) + " attempts"
+                                              : seq.reason);
+                    running -= 1;
+                } else {
+                    send_step(seq, now);
+                }
+            }
+        }
+    }
+
+    std::vector<MotorOpResult> results;
+    results.reserve(sequences_.size());
+    for (Sequence& seq : sequences_) {
+        results.push_back(std::move(seq.result));
+    }
+    sequences_.clear();
+    return results;
+}
+
+std::string describe_failures(const std::vector<MotorOpResult>& results) {
+    std::string text;
+    size_t failed = 0;
+    for (const MotorOpResult& result : results) {
+        if (result.ok) {
+            continue;
+        }
+        text += (failed == 0 ? "" : "; ") + result.interface + " motor " + std::to_string(result.motor_id) + " (" +
+                result.step + "): " + result.reason;
+        failed += 1;
+    }
+    if (failed == 0) {
+        return "";
+    }
+    return std::to_string(failed) + " of " + std::to_string(results.size()) + " motors failed: " + text;
+}
@@ -1,202 +0,0 @@
-/**
- * @file
- * This file implements functions to receive
- * and transmit CAN frames via SocketCAN.
- */
-
-#include "socket_can.hpp"
-
-std::shared_ptr<spdlog::logger> SocketCAN::logger_ = nullptr;
-std::unordered_map<std::string, std::shared_ptr<SocketCAN>> SocketCAN::instances_;
-
-SocketCAN::SocketCAN(std::string interface)
-    : interface_(interface), sockfd_(INIT_FD), receiving_(false), tx_queue_(TX_QUEUE_SIZE) {
-    open(interface);
-}
-
-SocketCAN::~SocketCAN() { this->close(); }
-
-void SocketCAN::open(std::string interface) {
-    sockfd_ = socket(PF_CAN, SOCK_RAW, CAN_RAW);
-    if (sockfd_ == INIT_FD) {
-        logger_->error("Failed to create CAN socket");
-        throw std::runtime_error("Failed to create CAN socket");
-    }
-
-    int bufsize = 1024 * 1024;  // 1MB
-    setsockopt(sockfd_, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
-
-    strncpy(if_request_.ifr_name, interface.c_str(), IFNAMSIZ);
-    if (ioctl(sockfd_, SIOCGIFINDEX, &if_request_) == -1) {
-        logger_->error("Unable to detect CAN interface {}", interface);
-
-        this->close();
-        throw std::runtime_error("Unable to detect CAN interface " + interface);
-    }
-
-    // Bind the socket to the network interface
-    addr_.can_family = AF_CAN;
-    addr_.can_ifindex = if_request_.ifr_ifindex;
-    int rc = ::bind(sockfd_, reinterpret_cast<struct sockaddr *>(&addr_), sizeof(addr_));
-    if (rc == -1) {
-        logger_->error("Failed to bind socket to network interface {}", interface);
-        this->close();
-        throw std::runtime_error("Failed to bind socket to network interface " + interface);
-    }
-
-    int flags = fcntl(sockfd_, F_GETFL, 0);
-    if (flags == -1) {
-        logger_->error("Failed to get socket flags");
-        this->close();
-        throw std::runtime_error("Failed to get socket flags");
-    }
-    if (fcntl(sockfd_, F_SETFL, flags | O_NONBLOCK) == -1) {
-        logger_->error("Failed to set socket to non-blocking");
-        this->close();
-        throw std::runtime_error("Failed to set socket to non-blocking");
-    }
-
-    receiving_ = true;
-    receiver_thread_ = std::thread([this]() {
-        pthread_setname_np(pthread_self(), "can_rx");
-        struct sched_param sp{}; sp.sched_priority = 80;
-        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) != 0) {
-            throw std::runtime_error("Failed to set realtime priority for CAN RX thread");
-        }
-
-        int cpu_id = 4; 
-        char last_char = interface_.back();
-        if (isdigit(last_char)) {
-            int port_num = last_char - '0';
-            cpu_id += (port_num % 2); 
-        }
-        cpu_set_t cpuset;
-        CPU_ZERO(&cpuset);
-        CPU_SET(cpu_id, &cpuset);
-        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0) {
-            throw std::runtime_error("Failed to bind CAN RX thread to Core " + std::to_string(cpu_id));
-        }
-
-        fd_set descriptors;
-        int maxfd = sockfd_;
-        struct timeval timeout;
-        can_frame rx_frame;
-
-        while (receiving_) {
-            FD_ZERO(&descriptors);
-            FD_SET(sockfd_, &descriptors);
-
-            timeout.tv_sec = TIMEOUT_SEC;
-            timeout.tv_usec = TIMEOUT_USEC;
-
-            if (::select(maxfd + 1, &descriptors, NULL, NULL, &timeout) == 1) {
-                while (true){
-                    int len = ::read(sockfd_, &rx_frame, CAN_MTU);
-                    if (len < 0) {
-                        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                            break; 
-                        }
-                        logger_->warn("CAN read error: {}", strerror(errno));
-                        break;
-                    }
-                    if (len == 0){
-                        break;
-                    }
-                    CanCbkFunc callback_to_run;
-                    {
-                        std::lock_guard<std::mutex> lock(can_callback_mutex_);
-                        CanCbkId key = key_extractor_(rx_frame);
-                        auto it = can_callback_list_.find(key);
-                        if (it != can_callback_list_.end()) {
-                            callback_to_run = it->second;
-                        }
-                    }
-                    if (callback_to_run) {
-                        callback_to_run(rx_frame);
-                    }
-                }
-            }
-        }
-    });
-
-    sender_thread_ = std::thread([this]() {
-        pthread_setname_np(pthread_self(), "can_tx");
-        struct sched_param sp{}; sp.sched_priority = 80;
-        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) != 0) {
-            throw std::runtime_error("Failed to set realtime priority for CAN TX thread");
-        }
-
-        int cpu_id = 4; 
-        char last_char = interface_.back();
-        if (isdigit(last_char)) {
-            int port_num = last_char - '0';
-            cpu_id += (port_num % 2); 
-        }
-        cpu_set_t cpuset;
-        CPU_ZERO(&cpuset);
-        CPU_SET(cpu_id, &cpuset);
-        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0) {
-            throw std::runtime_error("Failed to bind CAN TX thread to Core " + std::to_string(cpu_id));
-        }
-
-        can_frame tx_frame;
-        int count = 0;
-        while (receiving_) {
-            {
-                std::unique_lock<std::mutex> lock(tx_mutex_);
-                tx_cv_.wait(lock, [this]() { return !tx_queue_.empty() || !receiving_; });
-                if (!receiving_) break;
-                if (!tx_queue_.pop(tx_frame)) continue;
-            }
-            while (::write(sockfd_, &tx_frame, sizeof(can_frame)) < 0 && count < MAX_RETRY_COUNT) {
-                count += 1;
-                std::this_thread::sleep_for(std::chrono::microseconds(1000));  // 避免忙等待
-            }
-            if (count >= MAX_RETRY_COUNT) {
-                logger_->error("Failed to transmit CAN frame");
-            } else if (send_sleep_us_ > 0) {
-                std::this_thread::sleep_for(std::chrono::microseconds(send_sleep_us_));
-            }
-            count = 0;
-        }
-    });
-}
-
-void SocketCAN::close() {
-    receiving_ = false;
-    tx_cv_.notify_one();
-    if (receiver_thread_.joinable()) receiver_thread_.join();
-    if (sender_thread_.joinable()) sender_thread_.join();
-
-    if (sockfd_ != INIT_FD) ::close(sockfd_);
-    sockfd_ = INIT_FD;
-}
-
-void SocketCAN::transmit(const can_frame &frame) {
-    if (sockfd_ == INIT_FD) {
-        logger_->error("Unable to transmit: Socket not open");
-        return;
-    }
-    tx_queue_.bounded_push(frame);
-    tx_cv_.notify_one();
-}
-
-void SocketCAN::add_can_callback(const CanCbkFunc callback, const CanCbkId id) {
-    std::lock_guard<std::mutex> lock(can_callback_mutex_);
-    can_callback_list_[id] = callback;
-}
-
-void SocketCAN::remove_can_callback(CanCbkId id) {
-    std::lock_guard<std::mutex> lock(can_callback_mutex_);
-    can_callback_list_.erase(id);
-}
-
-void SocketCAN::clear_can_callbacks() {
-    std::lock_guard<std::mutex> lock(can_callback_mutex_);
-    can_callback_list_.clear();
-}
-
-void SocketCAN::set_key_extractor(CanCbkKeyExtractor extractor) {
-    std::lock_guard<std::mutex> lock(can_callback_mutex_);
-    key_extractor_ = std::move(extractor);
-}
@@ -1,5 +1,6 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include "can_bus_pybind.hpp"
 #include "motor_driver.hpp"
 
 namespace py = pybind11;
@@ -7,6 +8,8 @@ namespace py = pybind11;
 PYBIND11_MODULE(motors_py, m) {
     m.doc() = "Motor Driver Python SDK"; 
 
+    bind_can_bus(m);
+
     py::enum_<MotorDriver::MotorControlMode_e>(m, "MotorControlMode")
         .value("NONE", MotorDriver::MotorControlMode_e::NONE)
         .value("MIT", MotorDriver::MotorControlMode_e::MIT)
@@ -29,6 +32,8 @@ PYBIND11_MODULE(motors_py, m) {
         .def("set_motor_zero", &MotorDriver::set_motor_zero)
         .def("write_motor_flash", &MotorDriver::write_motor_flash)
         .def("get_motor_param", &MotorDriver::get_motor_param)
+        .def("get_register_cache", &MotorDriver::get_register_cache)
+        .def("register_ids", &MotorDriver::register_ids)
         .def("motor_pos_cmd", &MotorDriver::motor_pos_cmd,
              py::arg("pos"), py::arg("spd"), py::arg("ignore_limit") = false)
         .def("motor_spd_cmd", &MotorDriver::motor_spd_cmd)
@@ -14,6 +14,8 @@
 #include <sstream>
 #include <vector>
 
+#include "rt_clock.hpp"
+
 inline std::string get_timestring() {
     auto now = std::chrono::system_clock::now();
     auto now_c = std::chrono::system_clock::to_time_t(now);
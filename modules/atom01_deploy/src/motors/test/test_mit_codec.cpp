@@ -0,0 +1,216 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "dm_motor_driver.hpp"
+#include "evo_motor_driver.hpp"
+#include "mit_codec.hpp"
+#include "utils.hpp"
+
+// The MIT packing of the drivers before MitCodec, kept as the reference: clamp, range_map to the
+// field width in double, DM layout or EVO8118 layout with the 12 bit kd truncated to 9 bits.
+namespace legacy {
+
+struct Fields {
+    uint32_t p, v, kp, kd, t;
+};
+
+void encode(const MitLimits& l, MitLayout layout, float f_p, float f_v, float f_kp, float f_kd, float f_t,
+            uint8_t* data) {
+    f_p = limit(f_p, -l.pos, l.pos);
+    f_v = limit(f_v, -l.spd, l.spd);
+    f_kp = limit(f_kp, 0.0f, l.kp);
+    f_kd = limit(f_kd, 0.0f, l.kd);
+    f_t = limit(f_t, -l.tau, l.tau);
+    uint16_t p = range_map(f_p, -l.pos, l.pos, uint16_t(0), bitmax<uint16_t>(16));
+    uint16_t v = range_map(f_v, -l.spd, l.spd, uint16_t(0), bitmax<uint16_t>(12));
+    uint16_t kp = range_map(f_kp, 0.0f, l.kp, uint16_t(0), bitmax<uint16_t>(12));
+    uint16_t kd = range_map(f_kd, 0.0f, l.kd, uint16_t(0), bitmax<uint16_t>(12));
+    uint16_t t = range_map(f_t, -l.tau, l.tau, uint16_t(0), bitmax<uint16_t>(12));
+    if (layout == MitLayout::DM) {
+        data[0] = p >> 8;
+        data[1] = p & 0xFF;
+        data[2] = v >> 4;
+        data[3] = (v & 0x0F) << 4 | kp >> 8;
+        data[4] = kp & 0xFF;
+        data[5] = kd >> 4;
+        data[6] = (kd & 0x0F) << 4 | t >> 8;
+        data[7] = t & 0xFF;
+    } else {
+        data[0] = (kp >> 7) & 0x1F;
+        data[1] = ((kp & 0x7F) << 1) | ((kd >> 8) & 0x01);
+        data[2] = kd & 0xFF;
+        data[3] = (p >> 8) & 0xFF;
+        data[4] = p & 0xFF;
+        data[5] = (v >> 4) & 0xFF;
+        data[6] = ((v & 0x0F) << 4) | ((t >> 8) & 0x0F);
+        data[7] = t & 0xFF;
+    }
+}
+
+void decode(const MitLimits& l, const uint8_t* data, float& pos, float& spd, float& tau) {
+    uint16_t p = data[1] << 8 | data[2];
+    uint16_t v = data[3] << 4 | (data[4] & 0xF0) >> 4;
+    uint16_t t = (data[4] & 0x0F) << 8 | data[5];
+    pos = range_map(p, uint16_t(0), bitmax<uint16_t>(16), -l.pos, l.pos);
+    spd = range_map(v, uint16_t(0), bitmax<uint16_t>(12), -l.spd, l.spd);
+    tau = range_map(t, uint16_t(0), bitmax<uint16_t>(12), -l.tau, l.tau);
+}
+
+Fields unpack(MitLayout layout, const uint8_t* d) {
+    if (layout == MitLayout::DM) {
+        return {uint32_t(d[0]) << 8 | d[1], uint32_t(d[2]) << 4 | d[3] >> 4, uint32_t(d[3] & 0x0F) << 8 | d[4],
+                uint32_t(d[5]) << 4 | d[6] >> 4, uint32_t(d[6] & 0x0F) << 8 | d[7]};
+    }
+    return {uint32_t(d[3]) << 8 | d[4], uint32_t(d[5]) << 4 | d[6] >> 4, uint32_t(d[0] & 0x1F) << 7 | d[1] >> 1,
+            uint32_t(d[1] & 0x01) << 8 | d[2], uint32_t(d[6] & 0x0F) << 8 | d[7]};
+}
+
+}  // namespace legacy
+
+namespace {
+
+struct Model {
+    const char* name;
+    MitCodecOps codec;
+    MitLayout layout;
+};
+
+const Model models[] = {
+    {"DM4340P_48V", dm_mit_codecs[DM4340P_48V], MitLayout::DM},
+    {"DM10010L_48V", dm_mit_codecs[DM10010L_48V], MitLayout::DM},
+    {"EVO431040", evo_mit_codecs[EVO431040], MitLayout::DM},
+    {"EVO811825", evo_mit_codecs[EVO811825], MitLayout::EVO8118},
+    {"EVO811832", evo_mit_codecs[EVO811832], MitLayout::EVO8118},
+};
+
+uint32_t diff(uint32_t a, uint32_t b) { return a > b ? a - b : b - a; }
+
+// EVO8118 kd is a 9 bit field: the codec maps it to 9 bits, the legacy code mapped to 12 bits and
+// sent the low 9. That field is compared against the correct 9 bit mapping instead.
+void expect_same_codes(const Model& m, float p, float v, float kp, float kd, float t, uint32_t tolerance) {
+    uint8_t ours[8], theirs[8];
+    m.codec.encode(p, v, kp, kd, t, ours);
+    legacy::encode(m.codec.limits, m.layout, p, v, kp, kd, t, theirs);
+    legacy::Fields a = legacy::unpack(m.layout, ours), b = legacy::unpack(m.layout, theirs);
+    SCOPED_TRACE(testing::Message() << m.name << " p " << p << " v " << v << " kp " << kp << " kd " << kd << " t " << t);
+    EXPECT_LE(diff(a.p, b.p), tolerance);
+    EXPECT_LE(diff(a.v, b.v), tolerance);
+    EXPECT_LE(diff(a.kp, b.kp), tolerance);
+    EXPECT_LE(diff(a.t, b.t), tolerance);
+    if (m.layout == MitLayout::EVO8118) {
+        float kd_clamped = limit(kd, 0.0f, m.codec.limits.kd);
+        uint32_t kd9 = range_map(kd_clamped, 0.0f, m.codec.limits.kd, uint16_t(0), bitmax<uint16_t>(9));
+        EXPECT_LE(diff(a.kd, kd9), tolerance);
+    } else {
+        EXPECT_LE(diff(a.kd, b.kd), tolerance);
+    }
+}
+
+}  // namespace
+
+TEST(MitCodec, RandomValuesMatchLegacyWithinOneLsb) {
+    std::mt19937 rng(42);
+    for (const Model& m : models) {
+        const MitLimits& l = m.codec.limits;
+        std::uniform_real_distribution<float> p(-l.pos, l.pos), v(-l.spd, l.spd), kp(0.0f, l.kp), kd(0.0f, l.kd),
+            t(-l.tau, l.tau);
+        for (int i = 0; i < 100000; i++) {
+            expect_same_codes(m, p(rng), v(rng), kp(rng), kd(rng), t(rng), 1);
+        }
+    }
+}
+
+TEST(MitCodec, LimitsMatchLegacyExactly) {
+    for (const Model& m : models) {
+        const MitLimits& l = m.codec.limits;
+        expect_same_codes(m, -l.pos, -l.spd, 0.0f, 0.0f, -l.tau, 0);
+        expect_same_codes(m, l.pos, l.spd, l.kp, l.kd, l.tau, 0);
+        expect_same_codes(m, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1);
+
+        uint8_t data[8];
+        m.codec.encode(l.pos, l.spd, l.kp, l.kd, l.tau, data);
+        legacy::Fields f = legacy::unpack(m.layout, data);
+        EXPECT_EQ(f.p, 65535u) << m.name;
+        EXPECT_EQ(f.v, 4095u) << m.name;
+        EXPECT_EQ(f.kp, 4095u) << m.name;
+        EXPECT_EQ(f.kd, m.layout == MitLayout::EVO8118 ? 511u : 4095u) << m.name;
+        EXPECT_EQ(f.t, 4095u) << m.name;
+    }
+}
+
+TEST(MitCodec, OutOfRangeIsClamped) {
+    for (const Model& m : models) {
+        const MitLimits& l = m.codec.limits;
+        expect_same_codes(m, 10.0f * l.pos, 10.0f * l.spd, 10.0f * l.kp, 10.0f * l.kd, 10.0f * l.tau, 0);
+        expect_same_codes(m, -10.0f * l.pos, -10.0f * l.spd, -1.0f, -1.0f, -10.0f * l.tau, 0);
+        expect_same_codes(m, INFINITY, -INFINITY, INFINITY, INFINITY, -INFINITY, 0);
+    }
+}
+
+TEST(MitCodec, NanIsSentAsZero) {
+    for (const Model& m : models) {
+        uint8_t nan_frame[8], zero_frame[8];
+        m.codec.encode(NAN, NAN, NAN, NAN, NAN, nan_frame);
+        m.codec.encode(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, zero_frame);
+        EXPECT_EQ(0, memcmp(nan_frame, zero_frame, sizeof(nan_frame))) << m.name;
+    }
+}
+
+TEST(MitCodec, Evo8118KdUsesNineBits) {
+    for (const Model& m : models) {
+        if (m.layout != MitLayout::EVO8118) continue;
+        uint8_t ours[8], theirs[8];
+        float kd = 0.5f * m.codec.limits.kd;
+        m.codec.encode(0.0f, 0.0f, 0.0f, kd, 0.0f, ours);
+        legacy::encode(m.codec.limits, m.layout, 0.0f, 0.0f, 0.0f, kd, 0.0f, theirs);
+        // half of the range is code 255 of 511; the legacy code sent the low 9 bits of 2047
+        EXPECT_EQ(legacy::unpack(m.layout, ours).kd, 255u) << m.name;
+        EXPECT_EQ(legacy::unpack(m.layout, theirs).kd, 511u) << m.name;
+        // the mode bits stay 0
+        EXPECT_EQ(ours[0] & 0xE0, 0) << m.name;
+    }
+}
+
+TEST(MitCodec, DecodeMatchesLegacy) {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (const Model& m : models) {
+        const MitLimits& l = m.codec.limits;
+        for (int i = 0; i < 100000; i++) {
+            can_frame frame{};
+            for (auto& b : frame.data) b = static_cast<uint8_t>(byte(rng));
+            float pos, spd, tau, ref_pos, ref_spd, ref_tau;
+            m.codec.decode(frame.data, pos, spd, tau);
+            legacy::decode(l, frame.data, ref_pos, ref_spd, ref_tau);
+            EXPECT_NEAR(pos, ref_pos, 4e-6f * l.pos) << m.name;
+            EXPECT_NEAR(spd, ref_spd, 4e-6f * l.spd) << m.name;
+            EXPECT_NEAR(tau, ref_tau, 4e-6f * l.tau) << m.name;
+        }
+    }
+}
+
+TEST(MitCodec, BatchMatchesSingle) {
+    for (const Model& m : models) {
+        const MitLimits& l = m.codec.limits;
+        float p[3] = {-l.pos, 0.1f, l.pos}, v[3] = {0.0f, -1.0f, l.spd}, kp[3] = {0.0f, 10.0f, l.kp},
+              kd[3] = {0.0f, 0.3f, l.kd}, t[3] = {-l.tau, 0.5f, 2.0f * l.tau};
+        can_frame frames[3];
+        m.codec.encode_batch(3, p, v, kp, kd, t, frames);
+        float pos[3], spd[3], tau[3];
+        m.codec.decode_batch(3, frames, pos, spd, tau);
+        for (int i = 0; i < 3; i++) {
+            uint8_t single[8];
+            m.codec.encode(p[i], v[i], kp[i], kd[i], t[i], single);
+            EXPECT_EQ(0, memcmp(single, frames[i].data, sizeof(single))) << m.name;
+            float sp, ss, st;
+            m.codec.decode(frames[i].data, sp, ss, st);
+            EXPECT_EQ(sp, pos[i]);
+            EXPECT_EQ(ss, spd[i]);
+            EXPECT_EQ(st, tau[i]);
+        }
+    }
+}
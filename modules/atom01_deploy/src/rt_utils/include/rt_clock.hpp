@@ -0,0 +1,16 @@
+/**
+ * @file
+ * The time base of the process: CLOCK_MONOTONIC in nanoseconds. CAN and serial RX stamps, sensor
+ * histories, watchdogs and the inference loop all use it, so their times compare directly.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+inline uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
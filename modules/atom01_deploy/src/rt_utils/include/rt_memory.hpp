@@ -0,0 +1,42 @@
+/**
+ * @file
+ * Memory setup of the real-time process: locked pages, a malloc that keeps what it got from the
+ * kernel, a pre-touched heap and prefaulted thread stacks, so that the control threads do not take
+ * page faults once they run. Part of the shared rt_utils library; ThreadTopology prefaults the
+ * stack of every real-time thread it applies.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+struct RtMemoryCfg {
+    bool lock = true;                // mlockall(MCL_CURRENT | MCL_FUTURE)
+    bool tune_malloc = true;         // no heap trimming, no mmap'ed allocations
+    size_t heap_reserve_mb = 64;     // touched once and handed back to malloc, 0 disables
+    size_t stack_prefault_kb = 256;  // per real-time thread, at most half of its stack, 0 disables
+};
+
+struct RtMemoryStatus {
+    bool initialized = false;
+    bool locked = false;
+    size_t locked_kb = 0;    // VmLck
+    size_t resident_kb = 0;  // VmRSS
+    size_t heap_reserve_mb = 0;
+    size_t stack_prefault_kb = 0;
+};
+
+struct PageFaults {
+    uint64_t minor = 0, major = 0;
+};
+
+// Call once before the real-time threads start. Throws if the pages cannot be locked, which needs
+// memlock unlimited in /etc/security/limits.conf.
+void init_rt_memory(const RtMemoryCfg& cfg);
+// Touches stack_prefault_kb of the calling thread's stack.
+void prefault_stack();
+RtMemoryStatus rt_memory_status();
+// Page faults of a thread of this process, false if the thread does not exist (anymore).
+bool read_page_faults(pid_t tid, PageFaults& faults);
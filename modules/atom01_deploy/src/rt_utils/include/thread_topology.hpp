@@ -0,0 +1,99 @@
+/**
+ * @file
+ * Scheduling policy, priority and CPU affinity of every named thread of the process.
+ * Part of the shared rt_utils library, so that the CAN, IMU and inference threads of one process
+ * see the same configuration.
+ */
+
+#pragma once
+
+#include <sched.h>
+#include <spdlog/spdlog.h>
+#include <sys/types.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rt_memory.hpp"
+
+// Scheduling of one named thread. Empty cpus leaves the inherited affinity.
+struct ThreadSpec {
+    std::vector<int> cpus;
+    int policy = SCHED_OTHER;  // SCHED_OTHER, SCHED_FIFO or SCHED_RR
+    int priority = 0;          // 1..99 for SCHED_FIFO and SCHED_RR
+    // one cpu per instance: the instance with trailing number k (can3) gets cpus[k % cpus.size()]
+    bool spread = false;
+};
+
+struct CpuTopology {
+    std::vector<int> online;
+    std::vector<int> big, little;  // by cpu_capacity or maximum frequency, little is empty on symmetric CPUs
+    std::vector<int> isolated;     // isolcpus=
+    std::vector<int> nohz_full;    // nohz_full=
+};
+
+// Scheduling of a registered thread as the kernel reports it.
+struct ThreadLayout {
+    std::string name;  // "can_rx.can0"
+    pid_t tid;
+    bool alive;
+    int policy, priority;
+    std::vector<int> cpus;
+    PageFaults faults;
+};
+
+/**
+ * Thread names and their defaults:
+ *   can_rx, can_tx   SCHED_FIFO 80, spread over cpus 4 and 5 by interface number
+ *   can_err          SCHED_OTHER
+ *   serial_rx        SCHED_FIFO 80
+ *   threadpool       SCHED_FIFO 70
+ *   inference        SCHED_FIFO 70
+ *   ort              SCHED_FIFO 70, the ONNX Runtime intra-op workers
+ *   executor         SCHED_FIFO 70, the ROS executor threads (PD timer), inherited from the main thread
+ * A spec for "name.instance" (can_rx.can2) takes precedence over the one for "name".
+ */
+class ThreadTopology {
+   public:
+    static ThreadTopology& instance();
+
+    // Replaces the specs of the given names. Throws on offline cpus or an invalid priority and
+    // returns warnings about the placement (see validate()), which are logged as well.
+    std::vector<std::string> configure(const std::map<std::string, ThreadSpec>& specs);
+    // Checks every spec against the CPU topology: real-time threads outside isolcpus, normal
+    // threads on isolated cpus, nohz_full cpus shared by several real-time threads and real-time
+    // threads confined to little cores.
+    std::vector<std::string> validate() const;
+    ThreadSpec spec(const std::string& name, const std::string& instance = "") const;
+    // Names the calling thread and applies the spec of name.instance, throws if the kernel refuses.
+    // Real-time threads prefault their stack (see init_rt_memory()).
+    void apply(const std::string& name, const std::string& instance = "");
+    std::vector<ThreadLayout> layout() const;
+    const CpuTopology& cpu_topology() const { return cpus_; }
+
+    // "can_rx.can0 tid 1234: SCHED_FIFO 80, cpus 4 (big), page faults 12 minor / 0 major"
+    std::string describe(const ThreadLayout& thread) const;
+    // "0-3,6", or "big", "little", "all" (every online cpu)
+    std::vector<int> parse_cpus(const std::string& text) const;
+    static std::vector<int> parse_cpu_list(const std::string& list);
+    static int parse_policy(const std::string& name);  // "other", "fifo", "rr"
+    static const char* policy_name(int policy);
+    static CpuTopology read_cpu_topology();
+
+   private:
+    ThreadTopology();
+
+    struct Registered {
+        std::string name;
+        pid_t tid;
+    };
+
+    mutable std::mutex mutex_;
+    std::map<std::string, ThreadSpec> specs_;
+    std::vector<Registered> threads_;
+    CpuTopology cpus_;
+    std::shared_ptr<spdlog::logger> logger_;
+};
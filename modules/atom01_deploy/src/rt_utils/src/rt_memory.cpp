@@ -0,0 +1,154 @@
+#include "rt_memory.hpp"
+
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+std::mutex status_mutex;
+RtMemoryStatus status;
+std::atomic<size_t> stack_prefault_bytes{0};
+
+std::shared_ptr<spdlog::logger> get_logger() {
+    auto logger = spdlog::get("RtMemory");
+    if (logger.get() == nullptr) logger = spdlog::stdout_color_mt("RtMemory");
+    return logger;
+}
+
+// "VmLck:       1234 kB" of /proc/self/status
+size_t read_status_kb(const std::string& key) {
+    std::ifstream file("/proc/self/status");
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.compare(0, key.size(), key) == 0 && line.size() > key.size() && line[key.size()] == ':') {
+            return strtoull(line.c_str() + key.size() + 1, nullptr, 10);
+        }
+    }
+    return 0;
+}
+
+}  // namespace
+
+void init_rt_memory(const RtMemoryCfg& cfg) {
+    auto logger = get_logger();
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    if (cfg.tune_malloc) {
+        // Freed memory stays in the heap instead of going back to the kernel, and large blocks come
+        // from the heap instead of their own mmap, so memory once touched is never faulted in again.
+        // Arenas of other threads grow by mprotect, which mlockall populates right away.
+        if (mallopt(M_TRIM_THRESHOLD, -1) != 1 || mallopt(M_MMAP_MAX, 0) != 1) {
+            throw std::runtime_error("Failed to tune malloc for real-time use");
+        }
+    }
+
+    bool locked = false;
+    if (cfg.lock) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+            throw std::runtime_error(std::string("Failed to lock memory: ") + strerror(errno) +
+                                     ", set memlock unlimited in /etc/security/limits.conf");
+        }
+        locked = true;
+    }
+
+    if (cfg.heap_reserve_mb > 0) {
+        size_t bytes = cfg.heap_reserve_mb << 20;
+        auto* heap = static_cast<volatile unsigned char*>(malloc(bytes));
+        if (heap == nullptr) {
+            throw std::runtime_error("Failed to reserve " + std::to_string(cfg.heap_reserve_mb) + " MB of heap");
+        }
+        for (size_t i = 0; i < bytes; i += page) {
+            heap[i] = 0;
+        }
+        free(const_cast<unsigned char*>(heap));
+    }
+
+    stack_prefault_bytes.store(cfg.stack_prefault_kb << 10);
+    prefault_stack();
+
+    std::lock_guard<std::mutex> lock(status_mutex);
+    status.initialized = true;
+    status.locked = locked;
+    status.heap_reserve_mb = cfg.heap_reserve_mb;
+    status.stack_prefault_kb = cfg.stack_prefault_kb;
+    logger->info("memory {}, malloc {}, heap reserve {} MB, stack prefault {} kB per real-time thread",
+                 locked ? "locked" : "not locked", cfg.tune_malloc ? "tuned" : "default", cfg.heap_reserve_mb,
+                 cfg.stack_prefault_kb);
+}
+
+// not inlined, so that the alloca frame is popped again on return
+__attribute__((noinline)) void prefault_stack() {
+    size_t bytes = stack_prefault_bytes.load();
+    if (bytes == 0) {
+        return;
+    }
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        size_t stack_size = 0;
+        pthread_attr_getstacksize(&attr, &stack_size);
+        pthread_attr_destroy(&attr);
+        if (stack_size > 0) {
+            bytes = std::min(bytes, stack_size / 2);
+        }
+    }
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto* stack = static_cast<volatile unsigned char*>(alloca(bytes));
+    for (size_t i = 0; i < bytes; i += page) {
+        stack[i] = 0;
+    }
+}
+
+RtMemoryStatus rt_memory_status() {
+    RtMemoryStatus current;
+    {
+        std::lock_guard<std::mutex> lock(status_mutex);
+        current = status;
+    }
+    current.locked_kb = read_status_kb("VmLck");
+    current.resident_kb = read_status_kb("VmRSS");
+    return current;
+}
+
+bool read_page_faults(pid_t tid, PageFaults& faults) {
+    std::ifstream file("/proc/self/task/" + std::to_string(tid) + "/stat");
+    std::string line;
+    if (!std::getline(file, line)) {
+        return false;
+    }
+    // the thread name in parentheses may contain spaces, the fields after it start with the state
+    size_t end = line.rfind(')');
+    if (end == std::string::npos) {
+        return false;
+    }
+    std::istringstream fields(line.substr(end + 1));
+    std::string state, skip;
+    uint64_t minor = 0, child_minor = 0, major = 0;
+    fields >> state;
+    for (int i = 0; i < 5; i++) {
+        fields >> skip;  // ppid, pgrp, session, tty_nr, tpgid
+    }
+    fields >> skip >> minor >> child_minor >> major;  // flags, minflt, cminflt, majflt
+    if (!fields) {
+        return false;
+    }
+    faults.minor = minor;
+    faults.major = major;
+    return true;
+}
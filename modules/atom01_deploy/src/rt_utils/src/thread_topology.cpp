@@ -0,0 +1,341 @@
+#include "thread_topology.hpp"
+
+#include <pthread.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+std::string read_line(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+// sysfs cpu lists, "(null)" or an empty file when the feature is off
+std::vector<int> read_cpu_file(const std::string& path) {
+    std::string line = read_line(path);
+    if (line.empty() || !isdigit(static_cast<unsigned char>(line[0]))) {
+        return {};
+    }
+    return ThreadTopology::parse_cpu_list(line);
+}
+
+std::string format_cpu_list(const std::vector<int>& cpus) {
+    std::string text;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            j++;
+        }
+        text += (text.empty() ? "" : ",") + std::to_string(cpus[i]);
+        if (j > i) {
+            text += "-" + std::to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return text.empty() ? "all" : text;
+}
+
+bool contains(const std::vector<int>& cpus, int cpu) {
+    return std::find(cpus.begin(), cpus.end(), cpu) != cpus.end();
+}
+
+// trailing number of an instance name, can3 -> 3
+int instance_number(const std::string& instance) {
+    size_t pos = instance.size();
+    while (pos > 0 && isdigit(static_cast<unsigned char>(instance[pos - 1]))) {
+        pos--;
+    }
+    return pos < instance.size() ? std::stoi(instance.substr(pos)) : 0;
+}
+
+}  // namespace
+
+ThreadTopology& ThreadTopology::instance() {
+    static ThreadTopology topology;
+    return topology;
+}
+
+ThreadTopology::ThreadTopology() {
+    logger_ = spdlog::get("ThreadTopology");
+    if (logger_.get() == nullptr) logger_ = spdlog::stdout_color_mt("ThreadTopology");
+    cpus_ = read_cpu_topology();
+    specs_["can_rx"] = {{4, 5}, SCHED_FIFO, 80, true};
+    specs_["can_tx"] = {{4, 5}, SCHED_FIFO, 80, true};
+    specs_["can_err"] = {{}, SCHED_OTHER, 0, false};
+    specs_["serial_rx"] = {{}, SCHED_FIFO, 80, false};
+    specs_["threadpool"] = {{}, SCHED_FIFO, 70, false};
+    specs_["inference"] = {{}, SCHED_FIFO, 70, false};
+    specs_["ort"] = {{}, SCHED_FIFO, 70, false};
+    specs_["executor"] = {{}, SCHED_FIFO, 70, false};
+}
+
+CpuTopology ThreadTopology::read_cpu_topology() {
+    const std::string root = "/sys/devices/system/cpu/";
+    CpuTopology topology;
+    topology.online = read_cpu_file(root + "online");
+    if (topology.online.empty()) {
+        for (unsigned i = 0; i < std::thread::hardware_concurrency(); i++) {
+            topology.online.push_back(static_cast<int>(i));
+        }
+    }
+    topology.isolated = read_cpu_file(root + "isolated");
+    topology.nohz_full = read_cpu_file(root + "nohz_full");
+
+    // big.LITTLE (RK3588: cpu 0-3 A55, 4-7 A76): the cpus with the highest capacity are big
+    std::map<int, long> capacity;
+    for (int cpu : topology.online) {
+        std::string cpu_dir = root + "cpu" + std::to_string(cpu) + "/";
+        std::string value = read_line(cpu_dir + "cpu_capacity");
+        if (value.empty()) {
+            value = read_line(cpu_dir + "cpufreq/cpuinfo_max_freq");
+        }
+        capacity[cpu] = strtol(value.c_str(), nullptr, 10);
+    }
+    long max_capacity = 0;
+    for (const auto& entry : capacity) {
+        max_capacity = std::max(max_capacity, entry.second);
+    }
+    for (int cpu : topology.online) {
+        (capacity[cpu] == max_capacity ? topology.big : topology.little).push_back(cpu);
+    }
+    return topology;
+}
+
+std::vector<int> ThreadTopology::parse_cpu_list(const std::string& list) {
+    std::set<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        std::string part = list.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        part.erase(std::remove_if(part.begin(), part.end(), [](unsigned char c) { return isspace(c); }), part.end());
+        if (!part.empty()) {
+            size_t dash = part.find('-');
+            try {
+                int first = std::stoi(part.substr(0, dash));
+                int last = dash == std::string::npos ? first : std::stoi(part.substr(dash + 1));
+                for (int cpu = first; cpu <= last; cpu++) {
+                    cpus.insert(cpu);
+                }
+            } catch (const std::logic_error&) {
+                throw std::runtime_error("Invalid cpu list: " + list);
+            }
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+        pos = end + 1;
+    }
+    return std::vector<int>(cpus.begin(), cpus.end());
+}
+
+std::vector<int> ThreadTopology::parse_cpus(const std::string& text) const {
+    if (text == "big") return cpus_.big;
+    if (text == "little") return cpus_.little;
+    if (text == "all") return cpus_.online;
+    return parse_cpu_list(text);
+}
+
+int ThreadTopology::parse_policy(const std::string& name) {
+    if (name == "other") return SCHED_OTHER;
+    if (name == "fifo") return SCHED_FIFO;
+    if (name == "rr") return SCHED_RR;
+    throw std::runtime_error("Unknown scheduling policy: " + name);
+}
+
+const char* ThreadTopology::policy_name(int policy) {
+    switch (policy) {
+        case SCHED_OTHER: return "SCHED_OTHER";
+        case SCHED_FIFO: return "SCHED_FIFO";
+        case SCHED_RR: return "SCHED_RR";
+        case SCHED_BATCH: return "SCHED_BATCH";
+        case SCHED_IDLE: return "SCHED_IDLE";
+        default: return "unknown";
+    }
+}
+
+std::vector<std::string> ThreadTopology::configure(const std::map<std::string, ThreadSpec>& specs) {
+    for (const auto& [name, spec] : specs) {
+        bool valid = spec.policy == SCHED_OTHER ? spec.priority == 0
+                                                : spec.priority >= sched_get_priority_min(spec.policy) &&
+                                                      spec.priority <= sched_get_priority_max(spec.policy);
+        if (!valid) {
+            throw std::runtime_error("Thread " + name + ": invalid priority " + std::to_string(spec.priority) +
+                                     " for " + policy_name(spec.policy));
+        }
+        for (int cpu : spec.cpus) {
+            if (!contains(cpus_.online, cpu)) {
+                throw std::runtime_error("Thread " + name + ": cpu " + std::to_string(cpu) + " is not online (online " +
+                                         format_cpu_list(cpus_.online) + ")");
+            }
+        }
+        if (spec.spread && spec.cpus.empty()) {
+            throw std::runtime_error("Thread " + name + ": spread needs cpus");
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [name, spec] : specs) {
+            specs_[name] = spec;
+        }
+    }
+    std::vector<std::string> warnings = validate();
+    for (const auto& warning : warnings) {
+        logger_->warn("{}", warning);
+    }
+    return warnings;
+}
+
+std::vector<std::string> ThreadTopology::validate() const {
+    std::map<std::string, ThreadSpec> specs;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        specs = specs_;
+    }
+    std::vector<std::string> warnings;
+    std::map<int, std::vector<std::string>> rt_on_nohz;
+    for (const auto& [name, spec] : specs) {
+        bool rt = spec.policy != SCHED_OTHER;
+        for (int cpu : spec.cpus) {
+            if (!contains(cpus_.online, cpu)) {
+                warnings.push_back(name + ": cpu " + std::to_string(cpu) + " is not online");
+            }
+        }
+        if (!cpus_.isolated.empty()) {
+            // unpinned threads run on the housekeeping cpus
+            std::vector<int> inside, outside;
+            for (int cpu : spec.cpus.empty() ? cpus_.online : spec.cpus) {
+                bool isolated = contains(cpus_.isolated, cpu);
+                if (isolated && !spec.cpus.empty()) inside.push_back(cpu);
+                if (!isolated) outside.push_back(cpu);
+            }
+            if (rt && !outside.empty()) {
+                warnings.push_back(name + ": real-time thread on non-isolated cpus " + format_cpu_list(outside) +
+                                   " (isolcpus " + format_cpu_list(cpus_.isolated) + ")");
+            }
+            if (!rt && !inside.empty()) {
+                warnings.push_back(name + ": normal thread on isolated cpus " + format_cpu_list(inside) + ", which are not load balanced");
+            }
+        }
+        if (rt) {
+            for (int cpu : spec.cpus) {
+                if (contains(cpus_.nohz_full, cpu)) rt_on_nohz[cpu].push_back(name);
+            }
+        }
+        if (rt && !cpus_.little.empty() && !spec.cpus.empty() &&
+            std::all_of(spec.cpus.begin(), spec.cpus.end(), [this](int cpu) { return contains(cpus_.little, cpu); })) {
+            warnings.push_back(name + ": real-time thread only on little cpus " + format_cpu_list(spec.cpus) + " (big " +
+                               format_cpu_list(cpus_.big) + ")");
+        }
+    }
+    for (const auto& [cpu, names] : rt_on_nohz) {
+        if (names.size() > 1) {
+            std::string list;
+            for (const auto& name : names) list += (list.empty() ? "" : ", ") + name;
+            warnings.push_back("cpu " + std::to_string(cpu) + " is nohz_full but shared by real-time threads " + list +
+                               ", its tick keeps running");
+        }
+    }
+    return warnings;
+}
+
+ThreadSpec ThreadTopology::spec(const std::string& name, const std::string& instance) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = instance.empty() ? specs_.end() : specs_.find(name + "." + instance);
+    if (it == specs_.end()) {
+        it = specs_.find(name);
+    }
+    return it == specs_.end() ? ThreadSpec() : it->second;
+}
+
+void ThreadTopology::apply(const std::string& name, const std::string& instance) {
+    std::string full_name = instance.empty() ? name : name + "." + instance;
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+    ThreadSpec thread_spec = spec(name, instance);
+
+    struct sched_param sp{};
+    sp.sched_priority = thread_spec.priority;
+    if (pthread_setschedparam(pthread_self(), thread_spec.policy, &sp) != 0) {
+        throw std::runtime_error("Failed to set " + std::string(policy_name(thread_spec.policy)) + " " +
+                                 std::to_string(thread_spec.priority) + " for thread " + full_name);
+    }
+
+    std::vector<int> cpus = thread_spec.cpus;
+    if (thread_spec.spread && !cpus.empty()) {
+        cpus = {cpus[instance_number(instance) % cpus.size()]};
+    }
+    if (!cpus.empty()) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        for (int cpu : cpus) {
+            CPU_SET(cpu, &cpuset);
+        }
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0) {
+            throw std::runtime_error("Failed to bind thread " + full_name + " to cpus " + format_cpu_list(cpus));
+        }
+    }
+
+    if (thread_spec.policy != SCHED_OTHER) {
+        prefault_stack();
+    }
+
+    pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    std::lock_guard<std::mutex> lock(mutex_);
+    threads_.push_back({full_name, tid});
+}
+
+std::vector<ThreadLayout> ThreadTopology::layout() const {
+    std::vector<Registered> threads;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threads = threads_;
+    }
+    std::vector<ThreadLayout> layout;
+    layout.reserve(threads.size());
+    for (const auto& thread : threads) {
+        ThreadLayout entry{thread.name, thread.tid, false, SCHED_OTHER, 0, {}, {}};
+        int policy = sched_getscheduler(thread.tid);
+        struct sched_param sp{};
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        if (policy >= 0 && sched_getparam(thread.tid, &sp) == 0 &&
+            sched_getaffinity(thread.tid, sizeof(cpu_set_t), &cpuset) == 0 && read_page_faults(thread.tid, entry.faults)) {
+            entry.alive = true;
+            entry.policy = policy & ~SCHED_RESET_ON_FORK;
+            entry.priority = sp.sched_priority;
+            for (int cpu : cpus_.online) {
+                if (CPU_ISSET(cpu, &cpuset)) entry.cpus.push_back(cpu);
+            }
+        }
+        layout.push_back(std::move(entry));
+    }
+    return layout;
+}
+
+std::string ThreadTopology::describe(const ThreadLayout& thread) const {
+    std::string text = thread.name + " tid " + std::to_string(thread.tid) + ": ";
+    if (!thread.alive) {
+        return text + "exited";
+    }
+    text += std::string(policy_name(thread.policy)) + " " + std::to_string(thread.priority) + ", cpus " +
+            (thread.cpus == cpus_.online ? "all" : format_cpu_list(thread.cpus));
+    if (!cpus_.little.empty() && thread.cpus != cpus_.online) {
+        bool big = std::all_of(thread.cpus.begin(), thread.cpus.end(), [this](int cpu) { return contains(cpus_.big, cpu); });
+        bool little = std::all_of(thread.cpus.begin(), thread.cpus.end(), [this](int cpu) { return contains(cpus_.little, cpu); });
+        text += big ? " (big)" : little ? " (little)" : " (big + little)";
+    }
+    text += ", page faults " + std::to_string(thread.faults.minor) + " minor / " + std::to_string(thread.faults.major) + " major";
+    return text;
+}